@@ -0,0 +1,245 @@
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "flv-cache.h"
+#include "flv-catalog.h"
+
+void usage(char *program_name) {
+    printf("Usage: %s index [-c cache_dir] <catalog> [input.flv ...]\n", program_name);
+    printf("       %s query <catalog> [condition ...]\n", program_name);
+    printf("  index reads the file list from stdin, one per line, when none is given;\n");
+    printf("  with -c, unchanged files are summarized from the parse-result cache in cache_dir\n");
+    printf("  conditions:\n");
+    printf("    video=ID | audio=ID      codec id (7 = AVC, 10 = AAC, 2 = MP3), none = no track\n");
+    printf("    min-duration=SEC         max-duration=SEC\n");
+    printf("    min-bitrate=KBPS         max-bitrate=KBPS\n");
+    printf("    max-gop=MS               longest keyframe interval\n");
+    printf("    meta-mismatch=PERCENT    onMetaData duration differs from the timestamps\n");
+    printf("    errors                   only files that did not parse cleanly\n");
+    exit(-1);
+}
+
+typedef struct query {
+    int video_codec;          // -1 = any
+    int audio_codec;
+    double min_duration;      // Milliseconds, < 0 = unset
+    double max_duration;
+    double min_bitrate;
+    double max_bitrate;
+    double max_gop;
+    double meta_mismatch;     // Fraction
+    int errors;
+} query_t;
+
+/*
+ * @brief summarize one file with pread(), so that a file shrinking under
+ * us cannot take the whole run down. Every file gets a record, failures
+ * included.
+ */
+static int index_file(flv_catalog_writer_t *writer, const char *path, const char *cache_dir) {
+    flv_summary_t summary;
+    struct stat st;
+    int fd = -1;
+    int ret = 0;
+
+    // What is recorded for a file that cannot be summarized at all
+    memset(&summary, 0, sizeof(summary));
+    summary.video_codec = FLV_SUMMARY_NO_CODEC;
+    summary.audio_codec = FLV_SUMMARY_NO_CODEC;
+    fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0)
+            close(fd);
+        fprintf(stderr, "%s: %s\n", path, flv_strerror(FLV_ERR_IO));
+        return flv_catalog_writer_add(writer, path, FLV_ERR_IO, 0, 0, &summary);
+    }
+
+    if (cache_dir) {
+        flv_cache_result_t result;
+
+        ret = flv_cache_get(cache_dir, fd, &result);
+        if (ret == FLV_OK) {
+            if (result.store_status != FLV_OK)
+                fprintf(stderr, "%s: cache entry not stored: %s\n", path, flv_strerror(result.store_status));
+            summary = result.header->summary;
+            ret = result.header->status;
+            flv_cache_release(&result);
+        }
+    } else if (st.st_size == 0) {
+        ret = FLV_ERR_TRUNCATED;
+    } else {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        ret = flv_summarize_fd(fd, (uint64_t) st.st_size, &summary);
+    }
+    close(fd);
+
+    if (ret != FLV_OK)
+        fprintf(stderr, "%s: %s\n", path, flv_strerror(ret));
+    return flv_catalog_writer_add(writer, path, ret, (uint64_t) st.st_size, (int64_t) st.st_mtime, &summary);
+}
+
+static int run_index(const char *catalog_path, const char *cache_dir, int count, char **paths) {
+    flv_catalog_writer_t writer;
+    char line[4096];
+    int ret = 0;
+
+    ret = flv_catalog_writer_open(&writer, catalog_path);
+    if (ret != FLV_OK)
+        return ret;
+
+    if (count > 0) {
+        for (int i = 0; i < count && ret == FLV_OK; ++i)
+            ret = index_file(&writer, paths[i], cache_dir);
+    } else {
+        while (ret == FLV_OK && fgets(line, sizeof(line), stdin)) {
+            line[strcspn(line, "\r\n")] = '\0';
+            if (line[0] != '\0')
+                ret = index_file(&writer, line, cache_dir);
+        }
+    }
+
+    if (ret != FLV_OK) {
+        flv_catalog_writer_abort(&writer);
+        return ret;
+    }
+    return flv_catalog_writer_close(&writer);
+}
+
+static int parse_codec(const char *value) {
+    if (strcmp(value, "none") == 0)
+        return FLV_SUMMARY_NO_CODEC;
+    return atoi(value);
+}
+
+static int parse_condition(query_t *query, const char *arg) {
+    const char *value = strchr(arg, '=');
+    size_t name_len = value ? (size_t) (value - arg) : strlen(arg);
+
+    if (value)
+        value++;
+#define CONDITION(name) (strlen(name) == name_len && strncmp(arg, name, name_len) == 0)
+    if (!value && CONDITION("errors"))
+        query->errors = 1;
+    else if (!value)
+        return -1;
+    else if (CONDITION("video"))
+        query->video_codec = parse_codec(value);
+    else if (CONDITION("audio"))
+        query->audio_codec = parse_codec(value);
+    else if (CONDITION("min-duration"))
+        query->min_duration = atof(value) * 1000;
+    else if (CONDITION("max-duration"))
+        query->max_duration = atof(value) * 1000;
+    else if (CONDITION("min-bitrate"))
+        query->min_bitrate = atof(value);
+    else if (CONDITION("max-bitrate"))
+        query->max_bitrate = atof(value);
+    else if (CONDITION("max-gop"))
+        query->max_gop = atof(value);
+    else if (CONDITION("meta-mismatch"))
+        query->meta_mismatch = atof(value) / 100;
+    else
+        return -1;
+#undef CONDITION
+    return 0;
+}
+
+static int match_record(const query_t *query, const flv_catalog_record_t *record) {
+    const flv_summary_t *s = &record->summary;
+
+    if (query->errors && record->status == FLV_OK)
+        return 0;
+    if (query->video_codec >= 0 && s->video_codec != query->video_codec)
+        return 0;
+    if (query->audio_codec >= 0 && s->audio_codec != query->audio_codec)
+        return 0;
+    if ((query->min_duration >= 0 && s->duration < query->min_duration) ||
+        (query->max_duration >= 0 && s->duration > query->max_duration))
+        return 0;
+    if ((query->min_bitrate >= 0 && s->bitrate < query->min_bitrate) ||
+        (query->max_bitrate >= 0 && s->bitrate > query->max_bitrate))
+        return 0;
+    if (query->max_gop >= 0 && s->max_keyframe_interval > query->max_gop)
+        return 0;
+    if (query->meta_mismatch >= 0) {
+        double meta = s->meta_duration * 1000;
+
+        // A missing duration counts as a mismatch
+        if ((s->meta_flags & FLV_META_DURATION) &&
+            fabs(meta - s->duration) <= query->meta_mismatch * (s->duration > meta ? s->duration : meta))
+            return 0;
+    }
+    return 1;
+}
+
+static int run_query(const char *catalog_path, int count, char **conditions) {
+    flv_catalog_t catalog;
+    query_t query = {-1, -1, -1, -1, -1, -1, -1, -1, 0};
+    uint64_t matches = 0;
+    int ret = 0;
+
+    for (int i = 0; i < count; ++i) {
+        if (parse_condition(&query, conditions[i]) != 0)
+            return FLV_ERR_INVALID_ARG;
+    }
+
+    ret = flv_catalog_open(&catalog, catalog_path);
+    if (ret != FLV_OK)
+        return ret;
+
+    for (uint64_t i = 0; i < catalog.record_count; ++i) {
+        const flv_catalog_record_t *record = &catalog.records[i];
+        const flv_summary_t *s = &record->summary;
+        const char *path = NULL;
+        size_t len = 0;
+
+        if (!match_record(&query, record))
+            continue;
+        path = flv_catalog_record_path(&catalog, record, &len);
+        printf("%.*s\tduration=%.3f\tbitrate=%u\tvideo=%d\taudio=%d\tkeyframes=%u\tmax-gop=%u",
+               (int) len, path, s->duration / 1000.0, s->bitrate,
+               s->video_codec == FLV_SUMMARY_NO_CODEC ? -1 : s->video_codec,
+               s->audio_codec == FLV_SUMMARY_NO_CODEC ? -1 : s->audio_codec,
+               s->keyframes, s->max_keyframe_interval);
+        if (s->meta_flags & FLV_META_DURATION)
+            printf("\tmeta-duration=%.3f", s->meta_duration);
+        if (record->status != FLV_OK)
+            printf("\terror=%s", flv_strerror(record->status));
+        printf("\n");
+        matches++;
+    }
+    fprintf(stderr, "%llu of %llu files matched\n", (unsigned long long) matches,
+            (unsigned long long) catalog.record_count);
+
+    flv_catalog_close(&catalog);
+    return FLV_OK;
+}
+
+int main(int argc, char **argv) {
+    int ret = 0;
+
+    if (argc < 3)
+        usage(argv[0]);
+
+    // "index -c dir" without a catalog falls through to the usage
+    if (strcmp(argv[1], "index") == 0 && strcmp(argv[2], "-c") == 0 && argc >= 5)
+        ret = run_index(argv[4], argv[3], argc - 5, argv + 5);
+    else if (strcmp(argv[1], "index") == 0 && strcmp(argv[2], "-c") != 0)
+        ret = run_index(argv[2], NULL, argc - 3, argv + 3);
+    else if (strcmp(argv[1], "query") == 0)
+        ret = run_query(argv[2], argc - 3, argv + 3);
+    else
+        usage(argv[0]);
+
+    if (ret == FLV_ERR_INVALID_ARG)
+        usage(argv[0]);
+    if (ret != FLV_OK) {
+        fprintf(stderr, "Error: %s\n", flv_strerror(ret));
+        return 1;
+    }
+    return 0;
+}
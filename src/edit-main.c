@@ -0,0 +1,185 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "flv-edit.h"
+
+void usage(char *program_name) {
+    printf("Usage: %s concat [-f] [-k] <output.flv> <input.flv> ...\n", program_name);
+    printf("  concat joins the inputs, each continuing where the previous one ends\n");
+    printf("  -f   join inputs even if their codecs or codec configuration differ\n");
+    printf("  -k   keep the onMetaData duration and filesize of the first input\n");
+    printf("\n");
+    printf("Usage: %s filter (-a | -v | -K [-n N]) [-m] <output.flv> <input.flv>\n", program_name);
+    printf("  filter keeps one track, or the video keyframes, with the timestamps unchanged\n");
+    printf("  -a   audio only        -v   video only        -K   video keyframes only\n");
+    printf("  -n   every Nth keyframe (with -K)\n");
+    printf("  -m   drop the script tags too\n");
+    exit(-1);
+}
+
+/*
+ * @brief open the inputs, refusing the output path among them
+ */
+static int open_inputs(const char *output, int count, char **paths, int *fds) {
+    struct stat out_st;
+    int have_output = stat(output, &out_st) == 0;
+
+    for (int i = 0; i < count; ++i) {
+        struct stat st;
+
+        fds[i] = open(paths[i], O_RDONLY);
+        if (fds[i] < 0 || fstat(fds[i], &st) != 0) {
+            fprintf(stderr, "%s: %s\n", paths[i], flv_strerror(FLV_ERR_IO));
+            return FLV_ERR_IO;
+        }
+        if (have_output && st.st_dev == out_st.st_dev && st.st_ino == out_st.st_ino) {
+            fprintf(stderr, "%s: output is also an input\n", paths[i]);
+            return FLV_ERR_INVALID_ARG;
+        }
+    }
+    return FLV_OK;
+}
+
+static void print_stats(const char *output, const flv_edit_stats_t *stats) {
+    printf("%s: %llu of %llu tags, %llu bytes (%llu moved in kernel), %llu fields patched, "
+           "duration %.3f s\n", output, (unsigned long long) stats->tags_out,
+           (unsigned long long) stats->tags_in, (unsigned long long) stats->bytes_out,
+           (unsigned long long) stats->bytes_copied, (unsigned long long) stats->patches,
+           stats->duration / 1000.0);
+    if (stats->truncated_inputs > 0)
+        fprintf(stderr, "%u input(s) ended inside a tag; the incomplete tag was left out\n",
+                stats->truncated_inputs);
+}
+
+static int run_concat(int argc, char **argv) {
+    flv_concat_config_t config;
+    flv_edit_stats_t stats;
+    const char *output = NULL;
+    int *fds = NULL;
+    int count = 0;
+    int out_fd = -1;
+    int i = 0;
+    int ret = 0;
+
+    memset(&config, 0, sizeof(config));
+    for (; i < argc && argv[i][0] == '-'; ++i) {
+        if (strcmp(argv[i], "-f") == 0)
+            config.force = 1;
+        else if (strcmp(argv[i], "-k") == 0)
+            config.keep_metadata = 1;
+        else
+            return FLV_ERR_INVALID_ARG;
+    }
+    if (argc - i < 2)
+        return FLV_ERR_INVALID_ARG;
+    output = argv[i++];
+    count = argc - i;
+
+    fds = malloc((size_t) count * sizeof(int));
+    if (!fds)
+        return FLV_ERR_NOMEM;
+    for (int k = 0; k < count; ++k)
+        fds[k] = -1;
+    ret = open_inputs(output, count, argv + i, fds);
+    if (ret == FLV_OK) {
+        out_fd = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (out_fd < 0) {
+            fprintf(stderr, "%s: %s\n", output, flv_strerror(FLV_ERR_IO));
+            ret = FLV_ERR_IO;
+        }
+    }
+    if (ret == FLV_OK) {
+        ret = flv_concat(out_fd, fds, (size_t) count, &config, &stats);
+        close(out_fd);
+        if (ret != FLV_OK) {
+            if (stats.failed_input >= 0)
+                fprintf(stderr, "%s: %s\n", argv[i + stats.failed_input], flv_strerror(ret));
+            unlink(output);
+        } else {
+            print_stats(output, &stats);
+        }
+    }
+
+    for (int k = 0; k < count; ++k) {
+        if (fds[k] >= 0)
+            close(fds[k]);
+    }
+    free(fds);
+    return ret;
+}
+
+static int run_filter(int argc, char **argv) {
+    flv_filter_config_t config;
+    flv_edit_stats_t stats;
+    const char *output = NULL;
+    int in_fd = -1;
+    int out_fd = -1;
+    int i = 0;
+    int ret = 0;
+
+    memset(&config, 0, sizeof(config));
+    for (; i < argc && argv[i][0] == '-'; ++i) {
+        if (strcmp(argv[i], "-a") == 0)
+            config.mode = FLV_FILTER_AUDIO;
+        else if (strcmp(argv[i], "-v") == 0)
+            config.mode = FLV_FILTER_VIDEO;
+        else if (strcmp(argv[i], "-K") == 0)
+            config.mode = FLV_FILTER_KEYFRAMES;
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            config.keyframe_step = (uint32_t) strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-m") == 0)
+            config.drop_metadata = 1;
+        else
+            return FLV_ERR_INVALID_ARG;
+    }
+    if (argc - i != 2 || config.mode == 0 || (config.keyframe_step && config.mode != FLV_FILTER_KEYFRAMES))
+        return FLV_ERR_INVALID_ARG;
+    output = argv[i];
+
+    ret = open_inputs(output, 1, argv + i + 1, &in_fd);
+    if (ret == FLV_OK) {
+        out_fd = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (out_fd < 0) {
+            fprintf(stderr, "%s: %s\n", output, flv_strerror(FLV_ERR_IO));
+            ret = FLV_ERR_IO;
+        }
+    }
+    if (ret == FLV_OK) {
+        ret = flv_filter(out_fd, in_fd, &config, &stats);
+        close(out_fd);
+        if (ret != FLV_OK) {
+            fprintf(stderr, "%s: %s\n", argv[i + 1], flv_strerror(ret));
+            unlink(output);
+        } else {
+            print_stats(output, &stats);
+        }
+    }
+    if (in_fd >= 0)
+        close(in_fd);
+    return ret;
+}
+
+int main(int argc, char **argv) {
+    int ret = 0;
+
+    if (argc < 2)
+        usage(argv[0]);
+
+    if (strcmp(argv[1], "concat") == 0)
+        ret = run_concat(argc - 2, argv + 2);
+    else if (strcmp(argv[1], "filter") == 0)
+        ret = run_filter(argc - 2, argv + 2);
+    else
+        usage(argv[0]);
+
+    if (ret == FLV_ERR_INVALID_ARG)
+        usage(argv[0]);
+    if (ret != FLV_OK) {
+        fprintf(stderr, "Error: %s\n", flv_strerror(ret));
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,322 @@
+#include <math.h>
+#include <string.h>
+#include "flv-audio.h"
+
+#define FLV_SOUND_FORMAT_PCM          (0)
+#define FLV_SOUND_FORMAT_PCM_LE       (3)
+#define FLV_SOUND_FORMAT_NELLY_16K    (4)
+#define FLV_SOUND_FORMAT_NELLY_8K     (5)
+#define FLV_SOUND_FORMAT_NELLY        (6)
+#define FLV_SOUND_FORMAT_G711_ALAW    (7)
+#define FLV_SOUND_FORMAT_G711_MULAW   (8)
+
+// Nellymoser packs 256 samples into every 64-byte block
+#define NELLY_BLOCK_SIZE    (64)
+#define NELLY_BLOCK_SAMPLES (256)
+
+// MPEG-4 samplingFrequencyIndex
+static const uint32_t aac_sample_rates[] = {
+        96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000, 7350
+};
+
+// FLV SoundRate
+static const uint32_t flv_sound_rates[] = {5512, 11025, 22050, 44100};
+
+// Kilobits per second by [MPEG-1 ? 0 : 1][layer - 1][bitrate_index]
+static const uint16_t mp3_bitrates[2][3][15] = {
+        {
+                {0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448},
+                {0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384},
+                {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320}
+        },
+        {
+                {0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256},
+                {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},
+                {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160}
+        }
+};
+
+// Hz by [version - 1][sampling_rate_index]
+static const uint32_t mp3_sample_rates[3][3] = {
+        {44100, 48000, 32000},
+        {22050, 24000, 16000},
+        {11025, 12000, 8000}
+};
+
+/*
+ * @brief MSB-first bit reader over the AudioSpecificConfig
+ */
+typedef struct bit_reader {
+    const uint8_t *data;
+    size_t size;
+    size_t pos;                // In bits
+} bit_reader_t;
+
+static int read_bits(bit_reader_t *br, unsigned int count, uint32_t *value) {
+    uint32_t v = 0;
+
+    if (br->pos + count > br->size * 8)
+        return FLV_ERR_TRUNCATED;
+    for (unsigned int i = 0; i < count; ++i, ++br->pos)
+        v = (v << 1) | ((br->data[br->pos >> 3] >> (7 - (br->pos & 7))) & 1);
+    *value = v;
+    return FLV_OK;
+}
+
+static int read_object_type(bit_reader_t *br, uint32_t *type) {
+    int ret = read_bits(br, 5, type);
+
+    // 31 escapes to 32 + 6 more bits
+    if (ret == FLV_OK && *type == 31) {
+        ret = read_bits(br, 6, type);
+        *type += 32;
+    }
+    return ret;
+}
+
+static int read_sample_rate(bit_reader_t *br, uint32_t *rate) {
+    uint32_t index = 0;
+    int ret = read_bits(br, 4, &index);
+
+    if (ret != FLV_OK)
+        return ret;
+    if (index == 15)
+        return read_bits(br, 24, rate);
+    if (index >= sizeof(aac_sample_rates) / sizeof(aac_sample_rates[0]))
+        return FLV_ERR_MALFORMED;
+    *rate = aac_sample_rates[index];
+    return FLV_OK;
+}
+
+// AudioSpecificConfig, ISO/IEC 14496-3 1.6.2.1
+int flv_aac_parse_config(const uint8_t *data, size_t size, flv_aac_config_t *config) {
+    bit_reader_t br = {data, size, 0};
+    uint32_t object_type = 0;
+    uint32_t channels = 0;
+    uint32_t flag = 0;
+    int ret = 0;
+
+    if (!data || !config)
+        return FLV_ERR_INVALID_ARG;
+    memset(config, 0, sizeof(*config));
+
+    if ((ret = read_object_type(&br, &object_type)) != FLV_OK ||
+        (ret = read_sample_rate(&br, &config->sample_rate)) != FLV_OK ||
+        (ret = read_bits(&br, 4, &channels)) != FLV_OK)
+        return ret;
+    config->channel_config = (uint8_t) channels;
+    config->output_rate = config->sample_rate;
+
+    // Explicit HE-AAC: the extension rate comes first, then the core type
+    if (object_type == FLV_AAC_OBJECT_SBR || object_type == FLV_AAC_OBJECT_PS) {
+        config->extension_type = (uint8_t) object_type;
+        if ((ret = read_sample_rate(&br, &config->output_rate)) != FLV_OK ||
+            (ret = read_object_type(&br, &object_type)) != FLV_OK)
+            return ret;
+    }
+    config->object_type = (uint8_t) object_type;
+    if (config->sample_rate == 0)
+        return FLV_ERR_MALFORMED;
+
+    // GASpecificConfig starts with frameLengthFlag
+    config->frame_length = 1024;
+    switch (object_type) {
+        case 1: case 2: case 3: case 4: case 6: case 7:
+        case 17: case 19: case 20: case 21: case 22: case 23:
+            if (read_bits(&br, 1, &flag) == FLV_OK && flag)
+                config->frame_length = 960;
+            break;
+        default:
+            break;
+    }
+    return FLV_OK;
+}
+
+int flv_mp3_parse_header(const uint8_t *p, size_t size, flv_mp3_frame_t *frame) {
+    uint8_t version_bits = 0;
+    uint8_t layer_bits = 0;
+    uint8_t bitrate_index = 0;
+    uint8_t rate_index = 0;
+    int lsf = 0;
+
+    if (!p || !frame)
+        return FLV_ERR_INVALID_ARG;
+    if (size < 4)
+        return FLV_ERR_TRUNCATED;
+    if (p[0] != 0xFF || (p[1] & 0xE0) != 0xE0)
+        return FLV_ERR_MALFORMED;
+
+    version_bits = (p[1] >> 3) & 3;
+    layer_bits = (p[1] >> 1) & 3;
+    bitrate_index = p[2] >> 4;
+    rate_index = (p[2] >> 2) & 3;
+    // Reserved values, and free format whose size cannot be known
+    if (version_bits == 1 || layer_bits == 0 || bitrate_index == 0 || bitrate_index == 15 || rate_index == 3)
+        return FLV_ERR_MALFORMED;
+
+    frame->version = version_bits == 3 ? 1 : (version_bits == 2 ? 2 : 3);
+    frame->layer = 4 - layer_bits;
+    frame->padding = (p[2] >> 1) & 1;
+    frame->channels = (p[3] >> 6) == 3 ? 1 : 2;
+    lsf = frame->version != 1;
+    frame->bitrate = mp3_bitrates[lsf][frame->layer - 1][bitrate_index];
+    frame->sample_rate = mp3_sample_rates[frame->version - 1][rate_index];
+
+    switch (frame->layer) {
+        case 1:
+            frame->samples = 384;
+            frame->frame_size = (12 * frame->bitrate * 1000 / frame->sample_rate + frame->padding) * 4;
+            break;
+        case 2:
+            frame->samples = 1152;
+            frame->frame_size = 144 * frame->bitrate * 1000 / frame->sample_rate + frame->padding;
+            break;
+        default:
+            frame->samples = lsf ? 576 : 1152;
+            frame->frame_size = (lsf ? 72 : 144) * frame->bitrate * 1000 / frame->sample_rate + frame->padding;
+            break;
+    }
+    return FLV_OK;
+}
+
+const uint8_t *flv_mp3_find_sync(const uint8_t *p, const uint8_t *end) {
+    // memchr is vectorized by the C library; only candidates are checked by hand
+    while (p < end && (p = memchr(p, 0xFF, (size_t) (end - p))) != NULL) {
+        if (p + 1 < end && (p[1] & 0xE0) == 0xE0)
+            return p;
+        p++;
+    }
+    return NULL;
+}
+
+void flv_audio_init(flv_audio_t *audio) {
+    memset(audio, 0, sizeof(*audio));
+    audio->sound_format = 0xFF;
+}
+
+static void add_samples(flv_audio_t *audio, uint64_t samples, uint32_t rate) {
+    if (rate == 0)
+        return;
+    audio->samples += samples;
+    audio->duration += (double) samples / rate;
+    audio->sample_rate = rate;
+}
+
+/*
+ * @brief walk the MP3 frames of one payload; a frame may continue in the
+ * next tag
+ */
+static void scan_mp3(flv_audio_t *audio, const uint8_t *p, size_t size) {
+    const uint8_t *end = p + size;
+    flv_mp3_frame_t frame;
+
+    if (audio->mp3_pending) {
+        size_t skip = audio->mp3_pending < size ? audio->mp3_pending : size;
+
+        p += skip;
+        audio->mp3_pending -= (uint32_t) skip;
+    }
+    while (p < end) {
+        const uint8_t *sync = NULL;
+
+        if (flv_mp3_parse_header(p, (size_t) (end - p), &frame) == FLV_OK) {
+            audio->frames++;
+            audio->channels = frame.channels;
+            add_samples(audio, frame.samples, frame.sample_rate);
+            if (frame.frame_size > (size_t) (end - p)) {
+                audio->mp3_pending = frame.frame_size - (uint32_t) (end - p);
+                return;
+            }
+            // Frames usually follow each other directly, no search needed
+            p += frame.frame_size;
+            continue;
+        }
+        sync = flv_mp3_find_sync(p + 1, end);
+        audio->skipped_bytes += (uint64_t) ((sync ? sync : end) - p);
+        if (!sync)
+            return;
+        p = sync;
+    }
+}
+
+int flv_audio_update(flv_audio_t *audio, const flv_tag_info_t *tag) {
+    uint32_t timestamp = 0;
+    uint32_t rate = 0;
+    uint32_t width = 0;
+    double before = 0;
+
+    if (!audio || !tag)
+        return FLV_ERR_INVALID_ARG;
+    if (tag->tag_type != TAGTYPE_AUDIODATA)
+        return FLV_OK;
+    if (!tag->data && tag->data_size)
+        return FLV_ERR_INVALID_ARG;
+
+    if (audio->tags++ == 0)
+        audio->sound_format = tag->sound_format;
+    rate = flv_sound_rates[tag->sound_rate & 3];
+    before = audio->duration;
+
+    switch (tag->sound_format) {
+        case FLV_SOUND_FORMAT_AAC:
+            if (tag->aac_packet_type == FLV_AAC_SEQUENCE_HEADER) {
+                if (flv_aac_parse_config(tag->payload, tag->payload_size, &audio->aac) == FLV_OK) {
+                    audio->has_aac_config = 1;
+                    audio->channels = audio->aac.channel_config;
+                }
+                // Carries no samples and no meaningful timestamp
+                return FLV_OK;
+            }
+            audio->frames++;
+            if (audio->has_aac_config)
+                add_samples(audio, audio->aac.frame_length, audio->aac.sample_rate);
+            else
+                add_samples(audio, 1024, rate);
+            break;
+        case FLV_SOUND_FORMAT_MP3:
+        case FLV_SOUND_FORMAT_MP3_8K:
+            scan_mp3(audio, tag->payload, tag->payload_size);
+            break;
+        case FLV_SOUND_FORMAT_PCM:
+        case FLV_SOUND_FORMAT_PCM_LE:
+            width = (tag->sound_size ? 2 : 1) * (tag->sound_type ? 2 : 1);
+            audio->frames++;
+            audio->channels = tag->sound_type ? 2 : 1;
+            add_samples(audio, tag->payload_size / width, rate);
+            break;
+        case FLV_SOUND_FORMAT_G711_ALAW:
+        case FLV_SOUND_FORMAT_G711_MULAW:
+            audio->frames++;
+            audio->channels = 1;
+            add_samples(audio, tag->payload_size, 8000);
+            break;
+        case FLV_SOUND_FORMAT_NELLY_16K:
+        case FLV_SOUND_FORMAT_NELLY_8K:
+        case FLV_SOUND_FORMAT_NELLY:
+            if (tag->sound_format == FLV_SOUND_FORMAT_NELLY_16K)
+                rate = 16000;
+            else if (tag->sound_format == FLV_SOUND_FORMAT_NELLY_8K)
+                rate = 8000;
+            audio->frames++;
+            audio->channels = 1;
+            add_samples(audio, (uint64_t) (tag->payload_size / NELLY_BLOCK_SIZE) * NELLY_BLOCK_SAMPLES, rate);
+            break;
+        default:
+            // ADPCM, Speex and others would need a bitstream parser
+            return FLV_OK;
+    }
+
+    // Where this tag should start by the sample clock, against its timestamp
+    timestamp = flv_tag_timestamp(tag);
+    if (!audio->has_timestamp) {
+        audio->has_timestamp = 1;
+        audio->first_timestamp = timestamp;
+    }
+    audio->last_timestamp = timestamp;
+    audio->drift = (int64_t) timestamp - audio->first_timestamp - llround(before * 1000);
+    if (audio->drift < audio->min_drift)
+        audio->min_drift = audio->drift;
+    if (audio->drift > audio->max_drift)
+        audio->max_drift = audio->drift;
+    return FLV_OK;
+}
@@ -0,0 +1,99 @@
+#ifndef FLV_AUDIO_H_
+#define FLV_AUDIO_H_
+
+/*
+ * Audio frame analysis without decoding: the AAC AudioSpecificConfig, MP3
+ * frame headers inside the tag payloads and PCM block sizes give the exact
+ * number of samples per tag. Summed up they give the true audio duration,
+ * and comparing that sample clock with the tag timestamps shows how far
+ * the timestamps (and the video muxed against them) drift from the audio.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "flv-core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// AAC AudioObjectType values of interest
+#define FLV_AAC_OBJECT_MAIN        (1)
+#define FLV_AAC_OBJECT_LC          (2)
+#define FLV_AAC_OBJECT_SBR         (5)
+#define FLV_AAC_OBJECT_PS          (29)
+
+typedef struct flv_aac_config {
+    uint8_t object_type;       // AudioObjectType of the core codec
+    uint8_t extension_type;    // FLV_AAC_OBJECT_SBR / _PS if signalled explicitly, else 0
+    uint8_t channel_config;    // channelConfiguration, 0 = defined in the bitstream
+    uint32_t sample_rate;      // Core sampling frequency, Hz
+    uint32_t output_rate;      // Sampling frequency after SBR, Hz
+    uint16_t frame_length;     // Samples per raw access unit, 1024 or 960
+} flv_aac_config_t;
+
+typedef struct flv_mp3_frame {
+    uint8_t version;           // 1 = MPEG-1, 2 = MPEG-2, 3 = MPEG-2.5
+    uint8_t layer;             // 1, 2 or 3
+    uint8_t channels;
+    uint8_t padding;
+    uint32_t bitrate;          // Kilobits per second
+    uint32_t sample_rate;      // Hz
+    uint32_t samples;          // Samples per frame
+    uint32_t frame_size;       // Bytes, header included
+} flv_mp3_frame_t;
+
+/*
+ * @brief running audio analysis of one stream
+ */
+typedef struct flv_audio {
+    uint8_t sound_format;      // SoundFormat of the first audio tag, 0xFF before that
+    uint8_t channels;
+    uint32_t sample_rate;      // Latest sample rate seen, Hz
+    int has_aac_config;
+    flv_aac_config_t aac;
+    uint64_t tags;
+    uint64_t frames;           // AAC access units, MP3 frames or PCM tags
+    uint64_t samples;
+    double duration;           // Seconds of audio by the sample clock
+    uint64_t skipped_bytes;    // MP3 bytes that were not part of any frame
+    uint32_t mp3_pending;      // Bytes of an MP3 frame continuing in the next tag
+    int has_timestamp;
+    uint32_t first_timestamp;  // Of the audio tags, milliseconds
+    uint32_t last_timestamp;
+    int64_t drift;             // Last timestamp minus the sample clock, milliseconds
+    int64_t min_drift;
+    int64_t max_drift;
+} flv_audio_t;
+
+/*
+ * @brief parse an AudioSpecificConfig (the body of an AAC sequence header
+ * after the two FLV audio header bytes)
+ */
+int flv_aac_parse_config(const uint8_t *data, size_t size, flv_aac_config_t *config);
+
+/*
+ * @brief decode the 4-byte MPEG audio frame header at `p`. Returns
+ * FLV_ERR_MALFORMED if it is not a valid header.
+ */
+int flv_mp3_parse_header(const uint8_t *p, size_t size, flv_mp3_frame_t *frame);
+
+/*
+ * @brief first possible frame sync (0xFF followed by three set bits) in
+ * [p, end), or NULL
+ */
+const uint8_t *flv_mp3_find_sync(const uint8_t *p, const uint8_t *end);
+
+void flv_audio_init(flv_audio_t *audio);
+
+/*
+ * @brief account for one tag; tags other than audio are ignored. The tag
+ * body must be available (tag->data).
+ */
+int flv_audio_update(flv_audio_t *audio, const flv_tag_info_t *tag);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FLV_AUDIO_H_
@@ -0,0 +1,311 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "flv-cache.h"
+
+_Static_assert(sizeof(flv_cache_header_t) == 264, "flv_cache_header_t is a stored format");
+_Static_assert(sizeof(flv_index_entry_t) == 24, "flv_index_entry_t is a stored format");
+
+typedef struct cache_key {
+    uint64_t device;
+    uint64_t inode;
+    uint64_t file_size;
+    int64_t mtime_ns;
+    uint64_t partial_hash;
+} cache_key_t;
+
+static int read_at(int fd, uint8_t *p, size_t len, uint64_t offset) {
+    while (len > 0) {
+        ssize_t count = pread(fd, p, len, (off_t) offset);
+
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return count == 0 ? FLV_ERR_TRUNCATED : FLV_ERR_IO;
+        p += count;
+        len -= (size_t) count;
+        offset += (uint64_t) count;
+    }
+    return FLV_OK;
+}
+
+/*
+ * @brief identity of the file open on `fd`: stat fields plus a hash of
+ * both ends, which catches in-place rewrites within one mtime tick
+ */
+static int make_key(int fd, cache_key_t *key) {
+    uint8_t probe[FLV_CACHE_PROBE_SIZE];
+    struct stat st;
+    size_t len = 0;
+    int ret = 0;
+
+    if (fstat(fd, &st) != 0)
+        return FLV_ERR_IO;
+    if (!S_ISREG(st.st_mode))
+        return FLV_ERR_INVALID_ARG;
+    key->device = (uint64_t) st.st_dev;
+    key->inode = (uint64_t) st.st_ino;
+    key->file_size = (uint64_t) st.st_size;
+    key->mtime_ns = (int64_t) st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+
+    len = key->file_size < FLV_CACHE_PROBE_SIZE ? (size_t) key->file_size : FLV_CACHE_PROBE_SIZE;
+    ret = read_at(fd, probe, len, 0);
+    if (ret != FLV_OK)
+        return ret;
+    key->partial_hash = flv_hash64(probe, len, key->file_size);
+    if (key->file_size > FLV_CACHE_PROBE_SIZE) {
+        len = key->file_size - FLV_CACHE_PROBE_SIZE < FLV_CACHE_PROBE_SIZE ?
+              (size_t) (key->file_size - FLV_CACHE_PROBE_SIZE) : FLV_CACHE_PROBE_SIZE;
+        ret = read_at(fd, probe, len, key->file_size - len);
+        if (ret != FLV_OK)
+            return ret;
+        key->partial_hash = flv_hash64(probe, len, key->partial_hash);
+    }
+    return FLV_OK;
+}
+
+static char *entry_path(const char *dir, const cache_key_t *key) {
+    size_t size = strlen(dir) + 48;
+    char *path = malloc(size);
+
+    if (path)
+        snprintf(path, size, "%s/%016llx-%016llx.flvc", dir, (unsigned long long) key->device,
+                 (unsigned long long) key->inode);
+    return path;
+}
+
+/*
+ * @brief point `result` into an entry image after checking its layout
+ */
+static int set_result(flv_cache_result_t *result, void *image, size_t size) {
+    const flv_cache_header_t *header = (const flv_cache_header_t *) image;
+    const uint8_t *base = (const uint8_t *) image;
+
+    if (size < sizeof(*header))
+        return FLV_ERR_TRUNCATED;
+    if (memcmp(header->magic, FLV_CACHE_MAGIC, sizeof(header->magic)) != 0)
+        return FLV_ERR_SIGNATURE;
+    if (header->version != FLV_CACHE_VERSION || header->byte_order != FLV_CACHE_BYTE_ORDER ||
+        header->entry_size != sizeof(flv_index_entry_t))
+        return FLV_ERR_VERSION;
+    if (header->entry_count > (size - sizeof(*header)) / sizeof(flv_index_entry_t) ||
+        header->metadata_offset > size || header->metadata_size > size - header->metadata_offset)
+        return FLV_ERR_TRUNCATED;
+
+    result->header = header;
+    result->entries = (const flv_index_entry_t *) (base + sizeof(*header));
+    result->entry_count = (size_t) header->entry_count;
+    result->metadata = header->metadata_size ? base + header->metadata_offset : NULL;
+    result->metadata_size = (size_t) header->metadata_size;
+    result->image = image;
+    result->image_size = size;
+    return FLV_OK;
+}
+
+static int key_matches(const flv_cache_header_t *header, const cache_key_t *key) {
+    return header->device == key->device && header->inode == key->inode &&
+           header->file_size == key->file_size && header->mtime_ns == key->mtime_ns &&
+           header->partial_hash == key->partial_hash;
+}
+
+/*
+ * @brief map the entry at `path`. Returns FLV_OK on a current entry;
+ * otherwise result->source tells whether there was one at all.
+ */
+static int load_entry(const char *path, const cache_key_t *key, flv_cache_result_t *result) {
+    struct stat st;
+    void *map = NULL;
+    int fd = open(path, O_RDONLY);
+
+    result->source = FLV_CACHE_MISS;
+    if (fd < 0)
+        return FLV_ERR_IO;
+    result->source = FLV_CACHE_STALE;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(flv_cache_header_t)) {
+        close(fd);
+        return FLV_ERR_TRUNCATED;
+    }
+    map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return FLV_ERR_IO;
+    if (set_result(result, map, (size_t) st.st_size) != FLV_OK || !key_matches(result->header, key)) {
+        munmap(map, (size_t) st.st_size);
+        result->header = NULL;
+        return FLV_ERR_VERSION;
+    }
+    result->mapped = 1;
+    result->source = FLV_CACHE_HIT;
+    return FLV_OK;
+}
+
+/*
+ * @brief parse the file and lay the results out as an entry image
+ */
+static int build_image(int fd, const cache_key_t *key, void **image, size_t *image_size) {
+    flv_cache_header_t *header = NULL;
+    flv_summary_t summary;
+    flv_index_t index;
+    const flv_index_entry_t *metadata = NULL;
+    uint64_t metadata_size = 0;
+    size_t size = 0;
+    int status = 0;
+    int index_ret = 0;
+
+    if (key->file_size > 0) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        status = flv_summarize_fd(fd, key->file_size, &summary);
+    } else {
+        flv_summary_builder_t builder;
+
+        flv_summary_begin(&builder, NULL);
+        flv_summary_end(&builder, 0, &summary);
+        status = FLV_ERR_TRUNCATED;
+    }
+
+    // A file the index cannot start on gets an empty one
+    index_ret = flv_index_build(&index, fd);
+    if (index_ret == FLV_ERR_NOMEM)
+        return index_ret;
+    for (size_t i = 0; i < index.count && !metadata; ++i) {
+        if (index.entries[i].flags & FLV_INDEX_METADATA)
+            metadata = &index.entries[i];
+    }
+    if (metadata && metadata->data_size <= FLV_CACHE_MAX_METADATA)
+        metadata_size = metadata->data_size;
+
+    size = sizeof(*header) + index.count * sizeof(flv_index_entry_t) + (size_t) metadata_size;
+    header = calloc(1, size);
+    if (header) {
+        memcpy(header->magic, FLV_CACHE_MAGIC, sizeof(header->magic));
+        header->version = FLV_CACHE_VERSION;
+        header->byte_order = FLV_CACHE_BYTE_ORDER;
+        header->device = key->device;
+        header->inode = key->inode;
+        header->file_size = key->file_size;
+        header->mtime_ns = key->mtime_ns;
+        header->partial_hash = key->partial_hash;
+        header->status = status;
+        header->index_status = index_ret == FLV_OK ? index.status : index_ret;
+        header->entry_size = sizeof(flv_index_entry_t);
+        header->entry_count = index.count;
+        header->index_end = index.end;
+        header->metadata_offset = size - metadata_size;
+        header->metadata_size = metadata_size;
+        header->summary = summary;
+        if (index.count)
+            memcpy(header + 1, index.entries, index.count * sizeof(flv_index_entry_t));
+        // A file cut short since it was indexed is not worth an entry
+        if (metadata_size &&
+            read_at(fd, (uint8_t *) header + header->metadata_offset, (size_t) metadata_size,
+                    metadata->offset + FLV_TAG_HEADER_SIZE) != FLV_OK) {
+            free(header);
+            flv_index_destroy(&index);
+            return FLV_ERR_IO;
+        }
+    }
+
+    flv_index_destroy(&index);
+    if (!header)
+        return FLV_ERR_NOMEM;
+    *image = header;
+    *image_size = size;
+    return FLV_OK;
+}
+
+/*
+ * @brief write the entry next to `path` and rename it into place
+ */
+static int store_image(const char *dir, const char *path, const void *image, size_t size) {
+    size_t tmp_size = strlen(path) + 32;
+    char *tmp_path = malloc(tmp_size);
+    const uint8_t *p = (const uint8_t *) image;
+    int ret = FLV_OK;
+    int fd = -1;
+
+    if (!tmp_path)
+        return FLV_ERR_NOMEM;
+    // A unique name, as threads of one process may store the same entry
+    snprintf(tmp_path, tmp_size, "%s.XXXXXX", path);
+    fd = mkstemp(tmp_path);
+    if (fd < 0 && errno == ENOENT && (mkdir(dir, 0755) == 0 || errno == EEXIST)) {
+        snprintf(tmp_path, tmp_size, "%s.XXXXXX", path);
+        fd = mkstemp(tmp_path);
+    }
+    if (fd < 0) {
+        free(tmp_path);
+        return FLV_ERR_IO;
+    }
+    // mkstemp() creates it private; entries are shared like any cache file
+    if (fchmod(fd, 0644) != 0)
+        ret = FLV_ERR_IO;
+    while (ret == FLV_OK && size > 0) {
+        ssize_t count = write(fd, p, size);
+
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0) {
+            ret = FLV_ERR_IO;
+            break;
+        }
+        p += count;
+        size -= (size_t) count;
+    }
+    if (close(fd) != 0)
+        ret = FLV_ERR_IO;
+    if (ret == FLV_OK && rename(tmp_path, path) != 0)
+        ret = FLV_ERR_IO;
+    if (ret != FLV_OK)
+        unlink(tmp_path);
+    free(tmp_path);
+    return ret;
+}
+
+int flv_cache_get(const char *dir, int fd, flv_cache_result_t *result) {
+    cache_key_t key;
+    void *image = NULL;
+    size_t size = 0;
+    char *path = NULL;
+    int ret = 0;
+
+    if (!dir || fd < 0 || !result)
+        return FLV_ERR_INVALID_ARG;
+    memset(result, 0, sizeof(*result));
+    ret = make_key(fd, &key);
+    if (ret != FLV_OK)
+        return ret;
+    path = entry_path(dir, &key);
+    if (!path)
+        return FLV_ERR_NOMEM;
+
+    if (load_entry(path, &key, result) == FLV_OK) {
+        free(path);
+        return FLV_OK;
+    }
+
+    ret = build_image(fd, &key, &image, &size);
+    if (ret == FLV_OK) {
+        // Results are still returned when the directory is not writable
+        result->store_status = store_image(dir, path, image, size);
+        ret = set_result(result, image, size);
+        if (ret != FLV_OK)
+            free(image);
+    }
+    free(path);
+    return ret;
+}
+
+void flv_cache_release(flv_cache_result_t *result) {
+    if (!result || !result->image)
+        return;
+    if (result->mapped)
+        munmap(result->image, result->image_size);
+    else
+        free(result->image);
+    memset(result, 0, sizeof(*result));
+}
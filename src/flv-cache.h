@@ -0,0 +1,95 @@
+#ifndef FLV_CACHE_H_
+#define FLV_CACHE_H_
+
+/*
+ * Persistent parse-result cache. The summary, the tag index and the
+ * onMetaData body of a file are stored in a cache directory, one entry
+ * file per (device, inode), and are served from a read-only mapping for
+ * as long as the file stays the same. An entry is stale when the size,
+ * the mtime or a hash of the first and last FLV_CACHE_PROBE_SIZE bytes
+ * differ; it is then rebuilt and replaced atomically, so concurrent jobs
+ * can share one directory.
+ *
+ * Entry layout (host byte order, checked on load):
+ *   flv_cache_header_t   the key, the statuses and the summary
+ *   flv_index_entry_t    entry_count of them
+ *   onMetaData body      metadata_size bytes at metadata_offset
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "flv-index.h"
+#include "flv-summary.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FLV_CACHE_MAGIC      "FLVCACHE"
+#define FLV_CACHE_VERSION    (1)
+#define FLV_CACHE_BYTE_ORDER (0x01020304)
+
+// Bytes hashed at each end of the file to catch rewrites that keep size and mtime
+#define FLV_CACHE_PROBE_SIZE (4096)
+// Larger onMetaData bodies are not stored
+#define FLV_CACHE_MAX_METADATA (1 << 20)
+
+enum flv_cache_source {
+    FLV_CACHE_HIT = 1,         // Served from the cache
+    FLV_CACHE_MISS,            // No entry, the file was parsed
+    FLV_CACHE_STALE            // The entry described an older version, the file was parsed
+};
+
+typedef struct flv_cache_header {
+    char magic[8];             // FLV_CACHE_MAGIC
+    uint32_t version;          // FLV_CACHE_VERSION
+    uint32_t byte_order;       // FLV_CACHE_BYTE_ORDER as written by the host
+    uint64_t device;           // Key: identity and version of the file
+    uint64_t inode;
+    uint64_t file_size;
+    int64_t mtime_ns;
+    uint64_t partial_hash;     // Of the first and last FLV_CACHE_PROBE_SIZE bytes
+    int32_t status;            // flv_status of the parse; the results cover the readable part
+    int32_t index_status;      // flv_index_t.status
+    uint32_t entry_size;       // sizeof(flv_index_entry_t)
+    uint32_t reserved;
+    uint64_t entry_count;
+    uint64_t index_end;        // flv_index_t.end
+    uint64_t metadata_offset;
+    uint64_t metadata_size;
+    flv_summary_t summary;
+} flv_cache_header_t;
+
+/*
+ * @brief cached results of one file. The pointers refer to the entry
+ * image and stay valid until flv_cache_release.
+ */
+typedef struct flv_cache_result {
+    int source;                         // enum flv_cache_source
+    int store_status;                   // FLV_OK, or why a fresh entry could not be stored
+    const flv_cache_header_t *header;   // Statuses and summary
+    const flv_index_entry_t *entries;
+    size_t entry_count;
+    const uint8_t *metadata;            // onMetaData body, NULL if none
+    size_t metadata_size;
+    void *image;                        // Entry mapping or buffer
+    size_t image_size;
+    int mapped;
+} flv_cache_result_t;
+
+/*
+ * @brief results for the regular file open on `fd`, from the cache
+ * directory `dir` if they are current, otherwise by parsing the file and
+ * storing a new entry (`dir` is created if needed). Returns FLV_OK when
+ * `result` is filled in; the parse status of the file itself is
+ * result->header->status.
+ */
+int flv_cache_get(const char *dir, int fd, flv_cache_result_t *result);
+
+void flv_cache_release(flv_cache_result_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FLV_CACHE_H_
@@ -0,0 +1,209 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "flv-catalog.h"
+
+_Static_assert(sizeof(flv_catalog_header_t) == 64, "flv_catalog_header_t is a stored format");
+_Static_assert(sizeof(flv_catalog_record_t) == 192, "flv_catalog_record_t is a stored format");
+
+static void catalog_writer_free(flv_catalog_writer_t *writer) {
+    free(writer->tmp_path);
+    free(writer->path);
+    free(writer->strings);
+    memset(writer, 0, sizeof(*writer));
+}
+
+int flv_catalog_writer_open(flv_catalog_writer_t *writer, const char *path) {
+    flv_catalog_header_t header;
+    int fd = -1;
+
+    if (!writer || !path)
+        return FLV_ERR_INVALID_ARG;
+
+    memset(writer, 0, sizeof(*writer));
+    writer->path = strdup(path);
+    writer->tmp_path = malloc(strlen(path) + 8);
+    if (!writer->path || !writer->tmp_path) {
+        catalog_writer_free(writer);
+        return FLV_ERR_NOMEM;
+    }
+    // A unique name, so that concurrent runs on one catalog do not clash;
+    // the last one to finish wins
+    sprintf(writer->tmp_path, "%s.XXXXXX", path);
+    fd = mkstemp(writer->tmp_path);
+    if (fd < 0) {
+        catalog_writer_free(writer);
+        return FLV_ERR_IO;
+    }
+    // mkstemp() creates it private; a catalog is as readable as any file
+    if (fchmod(fd, 0644) != 0 || !(writer->file = fdopen(fd, "wb"))) {
+        close(fd);
+        unlink(writer->tmp_path);
+        catalog_writer_free(writer);
+        return FLV_ERR_IO;
+    }
+    // Placeholder, rewritten with the final counts on close
+    memset(&header, 0, sizeof(header));
+    if (fwrite(&header, sizeof(header), 1, writer->file) != 1) {
+        flv_catalog_writer_abort(writer);
+        return FLV_ERR_IO;
+    }
+    return FLV_OK;
+}
+
+int flv_catalog_writer_add(flv_catalog_writer_t *writer, const char *path, int status,
+                           uint64_t file_size, int64_t mtime, const flv_summary_t *summary) {
+    flv_catalog_record_t record;
+    size_t len = 0;
+
+    if (!writer || !writer->file || !path)
+        return FLV_ERR_INVALID_ARG;
+
+    len = strlen(path);
+    if (writer->strings_size + len > writer->strings_capacity) {
+        size_t capacity = writer->strings_capacity ? writer->strings_capacity : 4096;
+        char *strings = NULL;
+
+        while (capacity < writer->strings_size + len)
+            capacity *= 2;
+        strings = realloc(writer->strings, capacity);
+        if (!strings)
+            return FLV_ERR_NOMEM;
+        writer->strings = strings;
+        writer->strings_capacity = capacity;
+    }
+
+    memset(&record, 0, sizeof(record));
+    record.path_offset = writer->strings_size;
+    record.path_len = (uint32_t) len;
+    record.status = status;
+    record.file_size = file_size;
+    record.mtime = mtime;
+    if (summary)
+        record.summary = *summary;
+    if (fwrite(&record, sizeof(record), 1, writer->file) != 1)
+        return FLV_ERR_IO;
+
+    memcpy(writer->strings + writer->strings_size, path, len);
+    writer->strings_size += len;
+    writer->record_count++;
+    return FLV_OK;
+}
+
+int flv_catalog_writer_close(flv_catalog_writer_t *writer) {
+    flv_catalog_header_t header;
+    int ret = FLV_OK;
+
+    if (!writer || !writer->file)
+        return FLV_ERR_INVALID_ARG;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FLV_CATALOG_MAGIC, sizeof(header.magic));
+    header.version = FLV_CATALOG_VERSION;
+    header.byte_order = FLV_CATALOG_BYTE_ORDER;
+    header.record_size = sizeof(flv_catalog_record_t);
+    header.record_count = writer->record_count;
+    header.strings_offset = sizeof(header) + writer->record_count * sizeof(flv_catalog_record_t);
+    header.strings_size = writer->strings_size;
+
+    if ((writer->strings_size && fwrite(writer->strings, writer->strings_size, 1, writer->file) != 1) ||
+        fseek(writer->file, 0, SEEK_SET) != 0 ||
+        fwrite(&header, sizeof(header), 1, writer->file) != 1)
+        ret = FLV_ERR_IO;
+    if (fclose(writer->file) != 0)
+        ret = FLV_ERR_IO;
+    writer->file = NULL;
+    if (ret == FLV_OK && rename(writer->tmp_path, writer->path) != 0)
+        ret = FLV_ERR_IO;
+    if (ret != FLV_OK)
+        unlink(writer->tmp_path);
+    catalog_writer_free(writer);
+    return ret;
+}
+
+void flv_catalog_writer_abort(flv_catalog_writer_t *writer) {
+    if (!writer)
+        return;
+    if (writer->file) {
+        fclose(writer->file);
+        unlink(writer->tmp_path);
+    }
+    catalog_writer_free(writer);
+}
+
+int flv_catalog_open(flv_catalog_t *catalog, const char *path) {
+    const flv_catalog_header_t *header = NULL;
+    struct stat st;
+    void *map = NULL;
+    int fd = -1;
+
+    if (!catalog || !path)
+        return FLV_ERR_INVALID_ARG;
+    memset(catalog, 0, sizeof(*catalog));
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return FLV_ERR_IO;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return FLV_ERR_IO;
+    }
+    if ((size_t) st.st_size < sizeof(flv_catalog_header_t)) {
+        close(fd);
+        return FLV_ERR_TRUNCATED;
+    }
+    map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return FLV_ERR_IO;
+    madvise(map, (size_t) st.st_size, MADV_SEQUENTIAL);
+
+    catalog->map = (const uint8_t *) map;
+    catalog->map_size = (size_t) st.st_size;
+    header = (const flv_catalog_header_t *) map;
+    if (memcmp(header->magic, FLV_CATALOG_MAGIC, sizeof(header->magic)) != 0) {
+        flv_catalog_close(catalog);
+        return FLV_ERR_SIGNATURE;
+    }
+    if (header->version != FLV_CATALOG_VERSION || header->byte_order != FLV_CATALOG_BYTE_ORDER ||
+        header->record_size != sizeof(flv_catalog_record_t)) {
+        flv_catalog_close(catalog);
+        return FLV_ERR_VERSION;
+    }
+    if (header->record_count > (catalog->map_size - sizeof(*header)) / sizeof(flv_catalog_record_t) ||
+        header->strings_offset != sizeof(*header) + header->record_count * sizeof(flv_catalog_record_t) ||
+        header->strings_size > catalog->map_size - header->strings_offset) {
+        flv_catalog_close(catalog);
+        return FLV_ERR_TRUNCATED;
+    }
+
+    catalog->header = header;
+    catalog->records = (const flv_catalog_record_t *) (catalog->map + sizeof(*header));
+    catalog->record_count = header->record_count;
+    catalog->strings = (const char *) (catalog->map + header->strings_offset);
+    return FLV_OK;
+}
+
+void flv_catalog_close(flv_catalog_t *catalog) {
+    if (!catalog)
+        return;
+    if (catalog->map)
+        munmap((void *) catalog->map, catalog->map_size);
+    memset(catalog, 0, sizeof(*catalog));
+}
+
+const char *flv_catalog_record_path(const flv_catalog_t *catalog, const flv_catalog_record_t *record,
+                                    size_t *len) {
+    // Guard against a record pointing outside the string table
+    if (record->path_offset > catalog->header->strings_size ||
+        record->path_len > catalog->header->strings_size - record->path_offset) {
+        *len = 0;
+        return "";
+    }
+    *len = record->path_len;
+    return catalog->strings + record->path_offset;
+}
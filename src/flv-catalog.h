@@ -0,0 +1,101 @@
+#ifndef FLV_CATALOG_H_
+#define FLV_CATALOG_H_
+
+/*
+ * Corpus catalog: one fixed-size record per FLV file, holding its
+ * flv_summary_t, so that questions about a whole archive are answered by
+ * scanning a memory-mapped array instead of reparsing the files.
+ *
+ * File layout (host byte order, checked through byte_order on open):
+ *   flv_catalog_header_t   64 bytes
+ *   flv_catalog_record_t   record_size bytes each, record_count of them
+ *   path strings           strings_size bytes, not NUL terminated
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "flv-summary.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FLV_CATALOG_MAGIC      "FLVCATLG"
+#define FLV_CATALOG_VERSION    (1)
+#define FLV_CATALOG_BYTE_ORDER (0x01020304)
+
+typedef struct flv_catalog_header {
+    char magic[8];                 // FLV_CATALOG_MAGIC
+    uint32_t version;              // FLV_CATALOG_VERSION
+    uint32_t byte_order;           // FLV_CATALOG_BYTE_ORDER as written by the host
+    uint32_t record_size;          // sizeof(flv_catalog_record_t)
+    uint32_t reserved0;
+    uint64_t record_count;
+    uint64_t strings_offset;       // File offset of the path strings
+    uint64_t strings_size;
+    uint8_t reserved1[16];
+} flv_catalog_header_t;
+
+typedef struct flv_catalog_record {
+    uint64_t path_offset;          // Into the path strings
+    uint32_t path_len;
+    int32_t status;                // flv_status of indexing; the summary covers the readable part
+    uint64_t file_size;
+    int64_t mtime;                 // Seconds since the epoch
+    flv_summary_t summary;
+} flv_catalog_record_t;
+
+typedef struct flv_catalog_writer {
+    FILE *file;
+    char *tmp_path;                // Written here, renamed into place on close
+    char *path;
+    char *strings;
+    size_t strings_size;
+    size_t strings_capacity;
+    uint64_t record_count;
+} flv_catalog_writer_t;
+
+/*
+ * @brief a catalog opened for reading; records and strings point into the
+ * mapping
+ */
+typedef struct flv_catalog {
+    const uint8_t *map;
+    size_t map_size;
+    const flv_catalog_header_t *header;
+    const flv_catalog_record_t *records;
+    uint64_t record_count;
+    const char *strings;
+} flv_catalog_t;
+
+int flv_catalog_writer_open(flv_catalog_writer_t *writer, const char *path);
+
+int flv_catalog_writer_add(flv_catalog_writer_t *writer, const char *path, int status,
+                           uint64_t file_size, int64_t mtime, const flv_summary_t *summary);
+
+/*
+ * @brief finish the catalog and atomically replace `path`
+ */
+int flv_catalog_writer_close(flv_catalog_writer_t *writer);
+
+/*
+ * @brief drop an unfinished catalog
+ */
+void flv_catalog_writer_abort(flv_catalog_writer_t *writer);
+
+int flv_catalog_open(flv_catalog_t *catalog, const char *path);
+
+void flv_catalog_close(flv_catalog_t *catalog);
+
+/*
+ * @brief the file path of a record, `len` bytes long, not NUL terminated
+ */
+const char *flv_catalog_record_path(const flv_catalog_t *catalog, const flv_catalog_record_t *record,
+                                    size_t *len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FLV_CATALOG_H_
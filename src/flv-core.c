@@ -0,0 +1,661 @@
+#include <stdlib.h>
+#include <string.h>
+#include "flv-core.h"
+#include "flv-hash.h"
+
+// Nested AMF objects deeper than this are treated as malformed
+#define FLV_AMF_MAX_DEPTH (32)
+
+static const char *flv_signature = "FLV";
+
+const char *flv_strerror(int status) {
+    switch (status) {
+        case FLV_OK:
+            return "success";
+        case FLV_EOF:
+            return "end of stream";
+        case FLV_ERR_INVALID_ARG:
+            return "invalid argument";
+        case FLV_ERR_NOMEM:
+            return "out of memory";
+        case FLV_ERR_IO:
+            return "read error";
+        case FLV_ERR_TRUNCATED:
+            return "truncated data";
+        case FLV_ERR_SIGNATURE:
+            return "not an FLV file";
+        case FLV_ERR_MALFORMED:
+            return "malformed data";
+        case FLV_ERR_VERSION:
+            return "unsupported format version";
+        case FLV_ERR_LIMIT:
+            return "tag exceeds the buffer limit";
+        case FLV_ERR_MISMATCH:
+            return "codec configuration mismatch";
+        default:
+            return "unknown error";
+    }
+}
+
+uint8_t flv_get_bits(uint8_t value, uint8_t start_bit, uint8_t count) {
+    uint8_t mask = 0;
+
+    mask = (uint8_t) (((1 << count) - 1) << start_bit);
+    return (mask & value) >> start_bit;
+}
+
+// FLV files shall store multi-byte numbers in big-endian byte order
+uint32_t flv_get_ui24(const uint8_t *p) {
+    return ((uint32_t) p[0] << 16) | ((uint32_t) p[1] << 8) | p[2];
+}
+
+uint32_t flv_get_ui32(const uint8_t *p) {
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+void flv_put_ui24(uint8_t *p, uint32_t value) {
+    p[0] = (uint8_t) (value >> 16);
+    p[1] = (uint8_t) (value >> 8);
+    p[2] = (uint8_t) value;
+}
+
+void flv_put_ui32(uint8_t *p, uint32_t value) {
+    p[0] = (uint8_t) (value >> 24);
+    p[1] = (uint8_t) (value >> 16);
+    p[2] = (uint8_t) (value >> 8);
+    p[3] = (uint8_t) value;
+}
+
+/*
+ * @brief IEEE-754 double, 8 bytes, big-endian
+ */
+double flv_get_double(const uint8_t *p) {
+    uint64_t bits = ((uint64_t) flv_get_ui32(p) << 32) | flv_get_ui32(p + 4);
+    double value;
+
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+uint32_t flv_tag_timestamp(const flv_tag_info_t *tag) {
+    return tag->timestamp | ((uint32_t) tag->timestamp_ext << 24);
+}
+
+int flv_decode_header(const uint8_t *buf, size_t size, flv_header_t *header) {
+    if (!buf || !header)
+        return FLV_ERR_INVALID_ARG;
+    if (size < FLV_HEADER_SIZE)
+        return FLV_ERR_TRUNCATED;
+    if (memcmp(buf, flv_signature, 3) != 0)
+        return FLV_ERR_SIGNATURE;
+
+    memcpy(header->signature, buf, 3);
+    header->version = buf[3];
+    header->type_flags = buf[4];
+    header->data_offset = flv_get_ui32(buf + 5);
+    if (header->data_offset < FLV_HEADER_SIZE)
+        return FLV_ERR_MALFORMED;
+    return FLV_OK;
+}
+
+/*
+ * @brief decode the 11-byte tag header. Every other field of `tag` is
+ * cleared, so it is ready for flv_decode_tag_body.
+ */
+int flv_decode_tag_header(const uint8_t *buf, size_t size, flv_tag_info_t *tag) {
+    if (!buf || !tag)
+        return FLV_ERR_INVALID_ARG;
+    if (size < FLV_TAG_HEADER_SIZE)
+        return FLV_ERR_TRUNCATED;
+
+    memset(tag, 0, sizeof(*tag));
+    // Reserved UB[2], Filter UB[1], TagType UB[5]
+    tag->filter = flv_get_bits(buf[0], 5, 1);
+    tag->tag_type = flv_get_bits(buf[0], 0, 5);
+    tag->data_size = flv_get_ui24(buf + 1);
+    tag->timestamp = flv_get_ui24(buf + 4);
+    tag->timestamp_ext = buf[7];
+    tag->stream_id = flv_get_ui24(buf + 8);
+    return FLV_OK;
+}
+
+void flv_encode_tag_header(uint8_t *buf, const flv_tag_info_t *tag) {
+    buf[0] = (uint8_t) (((tag->filter & 1) << 5) | (tag->tag_type & 0x1F));
+    flv_put_ui24(buf + 1, tag->data_size);
+    flv_put_ui24(buf + 4, tag->timestamp);
+    buf[7] = tag->timestamp_ext;
+    flv_put_ui24(buf + 8, tag->stream_id);
+}
+
+/*
+ * @brief decode the audio/video tag headers from the first bytes of a body;
+ * `p` must hold min(data_size, FLV_READER_MIN_BUFFER) bytes
+ */
+static int decode_media_headers(flv_tag_info_t *tag, const uint8_t *p) {
+    uint32_t header_size = 0;
+
+    switch (tag->tag_type) {
+        case TAGTYPE_AUDIODATA:
+            if (tag->data_size < 1)
+                return FLV_ERR_MALFORMED;
+            tag->sound_format = flv_get_bits(p[0], 4, 4);    // UB[4]
+            tag->sound_rate = flv_get_bits(p[0], 2, 2);      // UB[2]
+            tag->sound_size = flv_get_bits(p[0], 1, 1);      // UB[1]
+            tag->sound_type = flv_get_bits(p[0], 0, 1);      // UB[1], total 1 byte.
+            header_size = 1;
+            // AAC Encoding
+            if (tag->sound_format == FLV_SOUND_FORMAT_AAC) {
+                if (tag->data_size < 2)
+                    return FLV_ERR_MALFORMED;
+                tag->aac_packet_type = p[1];
+                header_size = 2;
+            }
+            break;
+        case TAGTYPE_VIDEODATA:
+            if (tag->data_size < 1)
+                return FLV_ERR_MALFORMED;
+            tag->frame_type = flv_get_bits(p[0], 4, 4);
+            tag->codec_id = flv_get_bits(p[0], 0, 4);
+            header_size = 1;
+            // frame info
+            if (tag->frame_type == FLV_FRAME_TYPE_COMMAND) {
+                if (tag->data_size < 2)
+                    return FLV_ERR_MALFORMED;
+                tag->command = p[1];
+                header_size = 2;
+            }
+            // AVCVIDEOPACKET: AVCPacketType UI8, CompositionTime SI24
+            else if (tag->codec_id == FLV_CODEC_ID_AVC) {
+                if (tag->data_size < 5)
+                    return FLV_ERR_MALFORMED;
+                tag->avc_packet_type = p[1];
+                tag->composition_time = (int32_t) (flv_get_ui24(p + 2) << 8) >> 8;
+                header_size = 5;
+                // if AVCPacketType == 1, one or more NALUs, each with a
+                // 4-byte length prefix: 0x17|01|00 00 00|xx xx xx xx|
+                if (tag->avc_packet_type == FLV_AVC_NALU && tag->data_size >= 9)
+                    tag->nalu_len = flv_get_ui32(p + 5);
+            }
+            break;
+        default:
+            break;
+    }
+    tag->payload_size = tag->data_size - header_size;
+    return FLV_OK;
+}
+
+/*
+ * @brief decode the audio/video tag headers at the start of a tag body.
+ * `body` must hold at least tag->data_size bytes and has to outlive any use
+ * of tag->data and tag->payload.
+ */
+int flv_decode_tag_body(flv_tag_info_t *tag, const uint8_t *body, size_t size) {
+    int ret = 0;
+
+    if (!tag || (!body && tag->data_size))
+        return FLV_ERR_INVALID_ARG;
+    if (size < tag->data_size)
+        return FLV_ERR_TRUNCATED;
+
+    tag->data = body;
+    ret = decode_media_headers(tag, body);
+    if (ret != FLV_OK)
+        return ret;
+    tag->payload = body + (tag->data_size - tag->payload_size);
+    return FLV_OK;
+}
+
+/*
+ * @brief walk one AMF0 value starting at *pp. Scalars are decoded into
+ * `value` (may be NULL), compound values are skipped.
+ */
+static int amf_read_value(const uint8_t **pp, const uint8_t *end, flv_amf_value_t *value, int depth);
+
+static int amf_read_properties(const uint8_t **pp, const uint8_t *end,
+                               flv_script_property_fn fn, void *opaque, int depth) {
+    const uint8_t *p = *pp;
+
+    while (p < end) {
+        uint16_t name_len = 0;
+        const char *name = NULL;
+        flv_amf_value_t value;
+        int ret = 0;
+
+        if (end - p < 2)
+            return FLV_ERR_TRUNCATED;
+        name_len = (uint16_t) ((p[0] << 8) | p[1]);
+        p += 2;
+        if (name_len > end - p)
+            return FLV_ERR_TRUNCATED;
+        name = (const char *) p;
+        p += name_len;
+        // ScriptDataObjectEnd: empty name followed by 0x09
+        if (name_len == 0 && p < end && *p == AMF_TYPE_OBJECT_END) {
+            *pp = p + 1;
+            return FLV_OK;
+        }
+        ret = amf_read_value(&p, end, &value, depth);
+        if (ret != FLV_OK)
+            return ret;
+        if (fn) {
+            ret = fn(opaque, name, name_len, &value);
+            if (ret != 0)
+                return ret;
+        }
+    }
+    // Missing object end marker, tolerated at the end of the tag
+    *pp = p;
+    return FLV_OK;
+}
+
+static int amf_read_value(const uint8_t **pp, const uint8_t *end, flv_amf_value_t *value, int depth) {
+    const uint8_t *p = *pp;
+    flv_amf_value_t unused;
+    uint32_t count = 0;
+    int ret = FLV_OK;
+
+    if (!value)
+        value = &unused;
+    memset(value, 0, sizeof(*value));
+    if (depth > FLV_AMF_MAX_DEPTH)
+        return FLV_ERR_MALFORMED;
+    if (p >= end)
+        return FLV_ERR_TRUNCATED;
+
+    value->type = *p++;
+    switch (value->type) {
+        case AMF_TYPE_NUMBER:
+            if (end - p < 8)
+                return FLV_ERR_TRUNCATED;
+            value->number = flv_get_double(p);
+            p += 8;
+            break;
+        case AMF_TYPE_BOOLEAN:
+            if (end - p < 1)
+                return FLV_ERR_TRUNCATED;
+            value->boolean = *p++;
+            break;
+        case AMF_TYPE_STRING:
+            if (end - p < 2)
+                return FLV_ERR_TRUNCATED;
+            value->string_len = (uint32_t) ((p[0] << 8) | p[1]);
+            p += 2;
+            if (value->string_len > (size_t) (end - p))
+                return FLV_ERR_TRUNCATED;
+            value->string = (const char *) p;
+            p += value->string_len;
+            break;
+        case AMF_TYPE_LONG_STRING:
+            if (end - p < 4)
+                return FLV_ERR_TRUNCATED;
+            value->string_len = flv_get_ui32(p);
+            p += 4;
+            if (value->string_len > (size_t) (end - p))
+                return FLV_ERR_TRUNCATED;
+            value->string = (const char *) p;
+            p += value->string_len;
+            break;
+        case AMF_TYPE_OBJECT:
+            ret = amf_read_properties(&p, end, NULL, NULL, depth + 1);
+            break;
+        case AMF_TYPE_ECMA_ARRAY:
+            // ECMAArrayLength is only a hint, the end marker terminates the array
+            if (end - p < 4)
+                return FLV_ERR_TRUNCATED;
+            p += 4;
+            ret = amf_read_properties(&p, end, NULL, NULL, depth + 1);
+            break;
+        case AMF_TYPE_STRICT_ARRAY:
+            if (end - p < 4)
+                return FLV_ERR_TRUNCATED;
+            count = flv_get_ui32(p);
+            p += 4;
+            for (uint32_t i = 0; i < count && ret == FLV_OK; ++i)
+                ret = amf_read_value(&p, end, NULL, depth + 1);
+            break;
+        case AMF_TYPE_DATE:
+            // DateTime DOUBLE, LocalDateTimeOffset SI16
+            if (end - p < 10)
+                return FLV_ERR_TRUNCATED;
+            value->number = flv_get_double(p);
+            p += 10;
+            break;
+        case AMF_TYPE_REFERENCE:
+            if (end - p < 2)
+                return FLV_ERR_TRUNCATED;
+            p += 2;
+            break;
+        case AMF_TYPE_NULL:
+        case AMF_TYPE_UNDEFINED:
+            break;
+        default:
+            return FLV_ERR_MALFORMED;
+    }
+    *pp = p;
+    return ret;
+}
+
+/*
+ * @brief walk a script data tag body: a ScriptDataString name such as
+ * "onMetaData" followed by an object or ECMA array. `fn` is called for each
+ * of its properties, in file order.
+ */
+int flv_parse_script_data(const uint8_t *data, size_t size,
+                          flv_script_property_fn fn, void *opaque) {
+    const uint8_t *p = data;
+    const uint8_t *end = data + size;
+    flv_amf_value_t name;
+    int ret = 0;
+
+    if (!data)
+        return FLV_ERR_INVALID_ARG;
+
+    ret = amf_read_value(&p, end, &name, 0);
+    if (ret != FLV_OK)
+        return ret;
+    if (name.type != AMF_TYPE_STRING)
+        return FLV_ERR_MALFORMED;
+    if (p >= end)
+        return FLV_ERR_TRUNCATED;
+
+    switch (*p++) {
+        case AMF_TYPE_ECMA_ARRAY:
+            if (end - p < 4)
+                return FLV_ERR_TRUNCATED;
+            p += 4;
+            return amf_read_properties(&p, end, fn, opaque, 1);
+        case AMF_TYPE_OBJECT:
+            return amf_read_properties(&p, end, fn, opaque, 1);
+        default:
+            return FLV_ERR_MALFORMED;
+    }
+}
+
+long flv_file_read(void *opaque, void *buf, size_t size) {
+    FILE *file = (FILE *) opaque;
+    size_t count = fread(buf, 1, size, file);
+
+    if (count < size && ferror(file))
+        return -1;
+    return (long) count;
+}
+
+void flv_reader_init(flv_reader_t *reader, flv_read_fn read, void *opaque) {
+    memset(reader, 0, sizeof(*reader));
+    reader->read = read;
+    reader->opaque = opaque;
+}
+
+void flv_reader_init_file(flv_reader_t *reader, FILE *file) {
+    flv_reader_init(reader, flv_file_read, file);
+}
+
+/*
+ * @brief read straight from memory, e.g. a mmap()ed file. Tags returned by
+ * this reader point into `data` and no copy is ever made.
+ */
+void flv_reader_init_memory(flv_reader_t *reader, const void *data, size_t size) {
+    memset(reader, 0, sizeof(*reader));
+    reader->mem = (const uint8_t *) data;
+    reader->mem_size = size;
+}
+
+void flv_reader_destroy(flv_reader_t *reader) {
+    if (!reader)
+        return;
+    free(reader->buf);
+    reader->buf = NULL;
+    reader->buf_size = 0;
+}
+
+void flv_reader_set_hash(flv_reader_t *reader, int enable) {
+    if (reader)
+        reader->hash_payloads = enable;
+}
+
+void flv_reader_set_max_buffer(flv_reader_t *reader, size_t max_buffer) {
+    if (!reader)
+        return;
+    if (max_buffer && max_buffer < FLV_READER_MIN_BUFFER)
+        max_buffer = FLV_READER_MIN_BUFFER;
+    reader->max_buffer = max_buffer;
+}
+
+static int reader_reserve(flv_reader_t *reader, size_t size) {
+    uint8_t *buf = NULL;
+    size_t new_size = reader->buf_size ? reader->buf_size : 4096;
+
+    if (size <= reader->buf_size)
+        return FLV_OK;
+    while (new_size < size)
+        new_size *= 2;
+    // Never round up past the limit
+    if (reader->max_buffer && new_size > reader->max_buffer && size <= reader->max_buffer)
+        new_size = reader->max_buffer;
+    buf = realloc(reader->buf, new_size);
+    if (!buf)
+        return FLV_ERR_NOMEM;
+    reader->buf = buf;
+    reader->buf_size = new_size;
+    return FLV_OK;
+}
+
+/*
+ * @brief get the next `size` bytes of the stream. For memory sources *out
+ * points into the source, otherwise the bytes are read into `dst`.
+ * Returns FLV_EOF only if the stream ended before the first byte.
+ */
+static int reader_read(flv_reader_t *reader, uint8_t *dst, size_t size, const uint8_t **out) {
+    size_t done = 0;
+
+    if (reader->mem) {
+        size_t avail = reader->mem_size - (size_t) reader->offset;
+
+        if (avail == 0 && size > 0)
+            return FLV_EOF;
+        if (avail < size)
+            return FLV_ERR_TRUNCATED;
+        *out = reader->mem + reader->offset;
+        reader->offset += size;
+        return FLV_OK;
+    }
+
+    while (done < size) {
+        long count = reader->read(reader->opaque, dst + done, size - done);
+
+        if (count < 0)
+            return FLV_ERR_IO;
+        if (count == 0)
+            return done == 0 ? FLV_EOF : FLV_ERR_TRUNCATED;
+        done += (size_t) count;
+    }
+    reader->offset += size;
+    *out = dst;
+    return FLV_OK;
+}
+
+/*
+ * @brief pass over `size` bytes without keeping them, using at most one
+ * buffer of the reader's chunk size
+ */
+static int reader_skip(flv_reader_t *reader, uint64_t size) {
+    size_t chunk = reader->max_buffer ? reader->max_buffer : FLV_READER_CHUNK_SIZE;
+    const uint8_t *p = NULL;
+    int ret = 0;
+
+    if (reader->mem) {
+        if (size > reader->mem_size - reader->offset)
+            return FLV_ERR_TRUNCATED;
+        reader->offset += size;
+        return FLV_OK;
+    }
+    ret = reader_reserve(reader, chunk);
+    while (ret == FLV_OK && size > 0) {
+        size_t count = size < chunk ? (size_t) size : chunk;
+
+        ret = reader_read(reader, reader->buf, count, &p);
+        size -= count;
+    }
+    return ret == FLV_EOF ? FLV_ERR_TRUNCATED : ret;
+}
+
+int flv_reader_read_header(flv_reader_t *reader, flv_header_t *header) {
+    uint8_t bytes[FLV_HEADER_SIZE];
+    const uint8_t *p = NULL;
+    flv_header_t unused;
+    int ret = 0;
+
+    if (!reader)
+        return FLV_ERR_INVALID_ARG;
+    if (!header)
+        header = &unused;
+
+    ret = reader_read(reader, bytes, sizeof(bytes), &p);
+    if (ret != FLV_OK)
+        return ret == FLV_EOF ? FLV_ERR_TRUNCATED : ret;
+    ret = flv_decode_header(p, FLV_HEADER_SIZE, header);
+    if (ret != FLV_OK)
+        return ret;
+
+    // Newer versions may carry a longer header, the body starts at DataOffset
+    // and may be up to 4 GB away, so it is skipped in chunks
+    if (header->data_offset > FLV_HEADER_SIZE) {
+        ret = reader_skip(reader, header->data_offset - FLV_HEADER_SIZE);
+        if (ret != FLV_OK)
+            return ret;
+    }
+    reader->header_done = 1;
+    return FLV_OK;
+}
+
+// FLV File Body
+// PreviousTagSize0   UI32    (Always 0)
+// Tag1               FLVTAG
+// PreviousTagSize1   UI32
+// ...
+// TagN               FLVTAG
+// PreviousTagSizeN   UI32
+/*
+ * @brief read the PreviousTagSize and the tag header in front of the next
+ * tag body
+ */
+static int reader_next_tag_header(flv_reader_t *reader, flv_tag_info_t *tag) {
+    uint8_t bytes[FLV_TAG_HEADER_SIZE];
+    const uint8_t *p = NULL;
+    uint32_t prev_tag_size = 0;
+    uint64_t offset = 0;
+    int ret = 0;
+
+    if (!reader || !tag)
+        return FLV_ERR_INVALID_ARG;
+    if (!reader->header_done) {
+        ret = flv_reader_read_header(reader, NULL);
+        if (ret != FLV_OK)
+            return ret;
+    }
+
+    memset(tag, 0, sizeof(*tag));
+    ret = reader_read(reader, bytes, FLV_PREV_TAG_SIZE_SIZE, &p);
+    if (ret != FLV_OK)
+        return ret;
+    prev_tag_size = flv_get_ui32(p);
+    tag->prev_tag_size = prev_tag_size;
+
+    // Start reading next tag
+    offset = reader->offset;
+    ret = reader_read(reader, bytes, FLV_TAG_HEADER_SIZE, &p);
+    if (ret != FLV_OK)
+        return ret;
+    flv_decode_tag_header(p, FLV_TAG_HEADER_SIZE, tag);
+    tag->offset = offset;
+    tag->prev_tag_size = prev_tag_size;
+    return FLV_OK;
+}
+
+/*
+ * @brief read the next tag. Returns FLV_OK with `tag` filled in, FLV_EOF at
+ * the end of the stream (tag->prev_tag_size then holds the trailing
+ * PreviousTagSize), or an error. The tag memory is reused by the next call.
+ */
+int flv_reader_next_tag(flv_reader_t *reader, flv_tag_info_t *tag) {
+    const uint8_t *p = NULL;
+    int ret = 0;
+
+    ret = reader_next_tag_header(reader, tag);
+    if (ret != FLV_OK)
+        return ret;
+
+    if (reader->max_buffer && tag->data_size > reader->max_buffer) {
+        // Stay in step with the stream so that the caller may go on
+        ret = reader_skip(reader, tag->data_size);
+        reader->tag_count++;
+        return ret == FLV_OK ? FLV_ERR_LIMIT : ret;
+    }
+    if (!reader->mem) {
+        ret = reader_reserve(reader, tag->data_size);
+        if (ret != FLV_OK)
+            return ret;
+    }
+    p = reader->buf;
+    if (tag->data_size > 0) {
+        ret = reader_read(reader, reader->buf, tag->data_size, &p);
+        if (ret != FLV_OK)
+            return ret == FLV_EOF ? FLV_ERR_TRUNCATED : ret;
+    }
+    reader->tag_count++;
+    if (reader->hash_payloads)
+        tag->hash = flv_hash64(p, tag->data_size, 0);
+    return flv_decode_tag_body(tag, p, tag->data_size);
+}
+
+int flv_reader_next_tag_chunked(flv_reader_t *reader, flv_tag_info_t *tag,
+                                flv_chunk_fn fn, void *opaque) {
+    size_t chunk = 0;
+    flv_hash64_state_t hash;
+    const uint8_t *p = NULL;
+    uint32_t pos = 0;
+    int ret = 0;
+
+    ret = reader_next_tag_header(reader, tag);
+    if (ret != FLV_OK)
+        return ret;
+
+    chunk = reader->max_buffer ? reader->max_buffer : FLV_READER_CHUNK_SIZE;
+    if (!reader->mem) {
+        ret = reader_reserve(reader, tag->data_size < chunk ? tag->data_size : chunk);
+        if (ret != FLV_OK)
+            return ret;
+    }
+    if (reader->hash_payloads)
+        flv_hash64_reset(&hash, 0);
+
+    while (pos < tag->data_size) {
+        size_t count = tag->data_size - pos < chunk ? tag->data_size - pos : chunk;
+
+        ret = reader_read(reader, reader->buf, count, &p);
+        if (ret != FLV_OK)
+            return ret == FLV_EOF ? FLV_ERR_TRUNCATED : ret;
+        // The first chunk always holds the audio/video tag headers
+        if (pos == 0) {
+            ret = decode_media_headers(tag, p);
+            if (ret != FLV_OK) {
+                // Stay in step with the stream so that the caller may go on
+                int skipped = reader_skip(reader, tag->data_size - count);
+
+                reader->tag_count++;
+                return skipped == FLV_OK ? ret : skipped;
+            }
+        }
+        if (reader->hash_payloads)
+            flv_hash64_update(&hash, p, count);
+        if (fn && (ret = fn(opaque, tag, p, count, pos)) != 0)
+            return ret;
+        pos += (uint32_t) count;
+    }
+    if (tag->data_size == 0)
+        ret = decode_media_headers(tag, NULL);
+    reader->tag_count++;
+    if (reader->hash_payloads)
+        tag->hash = flv_hash64_digest(&hash);
+    return ret;
+}
@@ -0,0 +1,288 @@
+#ifndef FLV_CORE_H_
+#define FLV_CORE_H_
+
+/*
+ * libflvparser core: FLV container decoding without any stdout output,
+ * exit() calls or global state. Every function reports problems through
+ * the flv_status codes below, so the library can be linked into servers
+ * and driven in-process.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FLV_HEADER_SIZE        (9)
+#define FLV_TAG_HEADER_SIZE    (11)
+#define FLV_PREV_TAG_SIZE_SIZE (4)
+
+#define FLV_HEADER_AUDIO_BIT (2)
+#define FLV_HEADER_VIDEO_BIT (0)
+
+#define FLV_CODEC_ID_H263          (2)
+#define FLV_CODEC_ID_SCREEN        (3)
+#define FLV_CODEC_ID_VP6           (4)
+#define FLV_CODEC_ID_VP6_ALPHA     (5)
+#define FLV_CODEC_ID_SCREEN_V2     (6)
+#define FLV_CODEC_ID_AVC           (7)
+
+#define FLV_SOUND_FORMAT_MP3       (2)
+#define FLV_SOUND_FORMAT_AAC       (10)
+#define FLV_SOUND_FORMAT_MP3_8K    (14)
+
+#define FLV_FRAME_TYPE_KEY         (1)
+#define FLV_FRAME_TYPE_INTER       (2)
+#define FLV_FRAME_TYPE_DISPOSABLE  (3)
+#define FLV_FRAME_TYPE_GENERATED   (4)
+#define FLV_FRAME_TYPE_COMMAND     (5)
+
+#define FLV_AVC_SEQUENCE_HEADER    (0)
+#define FLV_AVC_NALU               (1)
+#define FLV_AVC_END_OF_SEQUENCE    (2)
+
+#define FLV_AAC_SEQUENCE_HEADER    (0)
+#define FLV_AAC_RAW                (1)
+
+/* AMF data types */
+enum amf_data_types {
+    AMF_TYPE_NUMBER = 0,
+    AMF_TYPE_BOOLEAN,
+    AMF_TYPE_STRING,
+    AMF_TYPE_OBJECT,
+    AMF_TYPE_MOVIECLIP,
+    AMF_TYPE_NULL,
+    AMF_TYPE_UNDEFINED,
+    AMF_TYPE_REFERENCE,
+    AMF_TYPE_ECMA_ARRAY,
+    AMF_TYPE_OBJECT_END,
+    AMF_TYPE_STRICT_ARRAY,
+    AMF_TYPE_DATE,
+    AMF_TYPE_LONG_STRING
+};
+
+enum tag_types {
+    TAGTYPE_AUDIODATA = 8,
+    TAGTYPE_VIDEODATA = 9,
+    TAGTYPE_SCRIPTDATAOBJECT = 18
+};
+
+/*
+ * @brief status codes returned by every library call.
+ * FLV_OK and FLV_EOF are not errors, everything below zero is.
+ */
+enum flv_status {
+    FLV_OK = 0,
+    FLV_EOF = 1,                 // Clean end of stream
+    FLV_ERR_INVALID_ARG = -1,    // NULL pointer or unusable argument
+    FLV_ERR_NOMEM = -2,          // Allocation failed
+    FLV_ERR_IO = -3,             // The read callback reported an error
+    FLV_ERR_TRUNCATED = -4,      // Stream ended in the middle of a structure
+    FLV_ERR_SIGNATURE = -5,      // File does not start with "FLV"
+    FLV_ERR_MALFORMED = -6,      // A field is inconsistent with the data around it
+    FLV_ERR_VERSION = -7,        // Stored data has an unsupported format version
+    FLV_ERR_LIMIT = -8,          // A tag is larger than the configured buffer limit
+    FLV_ERR_MISMATCH = -9        // Streams to be joined have different codecs or codec configuration
+};
+
+/*
+ * @brief flv file header 9 bytes
+ */
+struct flv_header {
+    uint8_t signature[3]; // 0x46, 0x4C, 0x56(FLV), UI8
+    uint8_t version;      // For FLV version 1, this vaule is 1. UI8
+    uint8_t type_flags;   // TypeFlagsReserved: UB[5]  Shall be 0
+                          // TypeFlagsAudio:    UB[1]  1 = Audio tags are present
+                          // TypeFlagsReserved: UB[1]  Shall be 0
+                          // TypeFlagsVideo:    UB[1]  1 = Video tags are present
+    uint32_t data_offset; // Length of FLV header in bytes, UI32. For FLV version 1,
+                          // this field has a value of 9.
+} __attribute__((__packed__));
+
+typedef struct flv_header flv_header_t;
+
+/*
+ * @brief one decoded tag. Nothing in here is allocated: `data` and `payload`
+ * point into memory owned by whoever produced the tag (the reader, or the
+ * caller of flv_decode_tag_body) and stay valid until that owner moves on.
+ */
+typedef struct flv_tag_info {
+    uint64_t offset;           // Byte offset of the 11-byte tag header in the stream
+    uint32_t prev_tag_size;    // PreviousTagSize that preceded this tag
+    uint8_t filter;            // Filter, UB[1]
+    uint8_t tag_type;          // TagType, UB[5]: 8 = audio; 9 = video; 18 = script data
+    uint32_t data_size;        // DataSize, UI24
+    uint32_t timestamp;        // Timestamp, UI24 (lower 24 bits)
+    uint8_t timestamp_ext;     // TimestampExtended, upper 8 bits
+    uint32_t stream_id;        // StreamID, UI24, always 0
+
+    // Audio tags (TAGTYPE_AUDIODATA)
+    uint8_t sound_format;      // SoundFormat, UB[4]
+    uint8_t sound_rate;        // SoundRate, UB[2]
+    uint8_t sound_size;        // SoundSize, UB[1]
+    uint8_t sound_type;        // SoundType, UB[1]
+    uint8_t aac_packet_type;   // AACPacketType, only if SoundFormat == 10
+
+    // Video tags (TAGTYPE_VIDEODATA)
+    uint8_t frame_type;        // FrameType, UB[4]
+    uint8_t codec_id;          // CodecID, UB[4]
+    uint8_t command;           // Video info/command byte, only if FrameType == 5
+    uint8_t avc_packet_type;   // AVCPacketType, only if CodecID == 7
+    int32_t composition_time;  // CompositionTime, SI24, only if CodecID == 7
+    uint32_t nalu_len;         // Length of the first NALU, only if AVCPacketType == 1
+
+    const uint8_t *data;       // The whole tag body, data_size bytes
+    const uint8_t *payload;    // Body after the audio/video tag headers
+    uint32_t payload_size;
+    uint64_t hash;             // flv_hash64 of the body, if the producer hashes payloads
+} flv_tag_info_t;
+
+/*
+ * @brief an AMF0 value as seen by the script data walker. Strings are not
+ * NUL terminated and point into the tag body. Objects and arrays are
+ * skipped over; only their type is reported.
+ */
+typedef struct flv_amf_value {
+    uint8_t type;              // enum amf_data_types
+    double number;             // AMF_TYPE_NUMBER, AMF_TYPE_DATE
+    uint8_t boolean;           // AMF_TYPE_BOOLEAN
+    const char *string;        // AMF_TYPE_STRING, AMF_TYPE_LONG_STRING
+    uint32_t string_len;
+} flv_amf_value_t;
+
+/*
+ * @brief called once per top level property of a script data object.
+ * Returning non-zero stops the walk and that value is handed back by
+ * flv_parse_script_data.
+ */
+typedef int (*flv_script_property_fn)(void *opaque, const char *name, size_t name_len,
+                                      const flv_amf_value_t *value);
+
+/*
+ * @brief pull data source: fill `buf` with up to `size` bytes. Return the
+ * number of bytes read (0 at end of stream) or a negative value on error.
+ */
+typedef long (*flv_read_fn)(void *opaque, void *buf, size_t size);
+
+// Chunk size of flv_reader_next_tag_chunked when no buffer limit is set
+#define FLV_READER_CHUNK_SIZE (64 << 10)
+// Smallest buffer limit; every audio/video tag header fits in the first chunk
+#define FLV_READER_MIN_BUFFER (16)
+
+/*
+ * @brief receives a tag body piece by piece. The tag header and the
+ * audio/video tag headers of `tag` are decoded, tag->data and tag->payload
+ * are NULL. `chunk` holds `size` bytes of the body starting at body offset
+ * `pos`, and is only valid during the call. Returning non-zero stops the
+ * reader, which hands that value back.
+ */
+typedef int (*flv_chunk_fn)(void *opaque, const flv_tag_info_t *tag,
+                            const uint8_t *chunk, size_t size, uint32_t pos);
+
+/*
+ * @brief streaming reader state. Treat the members as private; the struct
+ * is public only so that it can live on the stack.
+ */
+typedef struct flv_reader {
+    flv_read_fn read;
+    void *opaque;
+    const uint8_t *mem;        // Memory source, tags are returned in place
+    size_t mem_size;
+    uint8_t *buf;              // Tag body buffer for callback sources
+    size_t buf_size;
+    size_t max_buffer;         // Largest body buffer, 0 = unlimited
+    uint64_t offset;           // Bytes consumed so far
+    uint32_t tag_count;
+    int header_done;
+    int hash_payloads;
+} flv_reader_t;
+
+const char *flv_strerror(int status);
+
+/*
+ * @brief read bits from 1 byte
+ * @param[in] value: 1 byte to analysize
+ * @param[in] start_bit: start from the low bit side
+ * @param[in] count: number of bits
+ */
+uint8_t flv_get_bits(uint8_t value, uint8_t start_bit, uint8_t count);
+
+uint32_t flv_get_ui24(const uint8_t *p);
+
+uint32_t flv_get_ui32(const uint8_t *p);
+
+double flv_get_double(const uint8_t *p);
+
+void flv_put_ui24(uint8_t *p, uint32_t value);
+
+void flv_put_ui32(uint8_t *p, uint32_t value);
+
+/*
+ * @brief full 32-bit timestamp of a tag (Timestamp | TimestampExtended << 24)
+ */
+uint32_t flv_tag_timestamp(const flv_tag_info_t *tag);
+
+int flv_decode_header(const uint8_t *buf, size_t size, flv_header_t *header);
+
+int flv_decode_tag_header(const uint8_t *buf, size_t size, flv_tag_info_t *tag);
+
+int flv_decode_tag_body(flv_tag_info_t *tag, const uint8_t *body, size_t size);
+
+/*
+ * @brief write the 11-byte tag header for `tag` into `buf`
+ */
+void flv_encode_tag_header(uint8_t *buf, const flv_tag_info_t *tag);
+
+int flv_parse_script_data(const uint8_t *data, size_t size,
+                          flv_script_property_fn fn, void *opaque);
+
+/*
+ * @brief flv_read_fn over a stdio FILE
+ */
+long flv_file_read(void *opaque, void *buf, size_t size);
+
+void flv_reader_init(flv_reader_t *reader, flv_read_fn read, void *opaque);
+
+void flv_reader_init_file(flv_reader_t *reader, FILE *file);
+
+void flv_reader_init_memory(flv_reader_t *reader, const void *data, size_t size);
+
+void flv_reader_destroy(flv_reader_t *reader);
+
+/*
+ * @brief also fill tag->hash for every tag, while the body is still hot
+ * in the cache
+ */
+void flv_reader_set_hash(flv_reader_t *reader, int enable);
+
+/*
+ * @brief bound the memory a reader may allocate for tag bodies, whatever
+ * DataSize claims. flv_reader_next_tag then skips a larger tag and returns
+ * FLV_ERR_LIMIT with its header decoded; reading can go on after that.
+ * flv_reader_next_tag_chunked uses `max_buffer` as its chunk size.
+ * 0 removes the limit.
+ */
+void flv_reader_set_max_buffer(flv_reader_t *reader, size_t max_buffer);
+
+int flv_reader_read_header(flv_reader_t *reader, flv_header_t *header);
+
+int flv_reader_next_tag(flv_reader_t *reader, flv_tag_info_t *tag);
+
+/*
+ * @brief read the next tag and hand its body to `fn` in chunks, never
+ * buffering more than one chunk. Returns like flv_reader_next_tag, with
+ * tag->hash covering the whole body if hashing is enabled. A tag whose
+ * audio/video headers do not decode is passed over before the error is
+ * returned, so reading can go on.
+ */
+int flv_reader_next_tag_chunked(flv_reader_t *reader, flv_tag_info_t *tag,
+                                flv_chunk_fn fn, void *opaque);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FLV_CORE_H_
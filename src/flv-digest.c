@@ -0,0 +1,106 @@
+#include <stdlib.h>
+#include <string.h>
+#include "flv-digest.h"
+
+void flv_digest_init(flv_digest_t *digest, const flv_header_t *header) {
+    memset(digest, 0, sizeof(*digest));
+    flv_hash64_reset(&digest->file_state, 0);
+    if (header)
+        digest->has_video = (header->type_flags & (1 << FLV_HEADER_VIDEO_BIT)) != 0;
+}
+
+void flv_digest_destroy(flv_digest_t *digest) {
+    if (!digest)
+        return;
+    free(digest->gops);
+    digest->gops = NULL;
+    digest->gop_count = 0;
+    digest->gop_size = 0;
+}
+
+static int digest_close_gop(flv_digest_t *digest) {
+    if (!digest->in_gop)
+        return FLV_OK;
+    if (digest->gop_count == digest->gop_size) {
+        size_t size = digest->gop_size ? digest->gop_size * 2 : 64;
+        flv_gop_digest_t *gops = realloc(digest->gops, size * sizeof(*gops));
+
+        if (!gops)
+            return FLV_ERR_NOMEM;
+        digest->gops = gops;
+        digest->gop_size = size;
+    }
+    digest->current.hash = flv_hash64_digest(&digest->gop_state);
+    digest->gops[digest->gop_count++] = digest->current;
+    digest->in_gop = 0;
+    return FLV_OK;
+}
+
+/*
+ * @brief does this tag start a new GOP?
+ */
+static int digest_is_boundary(const flv_digest_t *digest, const flv_tag_info_t *tag) {
+    if (tag->tag_type == TAGTYPE_VIDEODATA)
+        return tag->frame_type == FLV_FRAME_TYPE_KEY;
+    if (tag->tag_type != TAGTYPE_AUDIODATA || digest->has_video)
+        return 0;
+    return !digest->in_gop ||
+           flv_tag_timestamp(tag) - digest->current.timestamp >= FLV_DIGEST_AUDIO_SEGMENT_MS;
+}
+
+int flv_digest_update(flv_digest_t *digest, const flv_tag_info_t *tag, int hashed) {
+    uint64_t hash = 0;
+    uint8_t bytes[8];
+    int ret = FLV_OK;
+
+    if (!digest || !tag)
+        return FLV_ERR_INVALID_ARG;
+
+    hash = hashed ? tag->hash : flv_hash64(tag->data, tag->data_size, 0);
+    flv_put_ui32(bytes, (uint32_t) (hash >> 32));
+    flv_put_ui32(bytes + 4, (uint32_t) hash);
+    flv_hash64_update(&digest->file_state, bytes, sizeof(bytes));
+    digest->tag_count++;
+
+    if (tag->tag_type != TAGTYPE_AUDIODATA && tag->tag_type != TAGTYPE_VIDEODATA)
+        return FLV_OK;
+    // Codec configuration is not media, keep it out of the GOPs
+    if (tag->tag_type == TAGTYPE_VIDEODATA && tag->codec_id == FLV_CODEC_ID_AVC &&
+        tag->frame_type != FLV_FRAME_TYPE_COMMAND && tag->avc_packet_type == FLV_AVC_SEQUENCE_HEADER)
+        return FLV_OK;
+    if (tag->tag_type == TAGTYPE_AUDIODATA && tag->sound_format == FLV_SOUND_FORMAT_AAC &&
+        tag->aac_packet_type == FLV_AAC_SEQUENCE_HEADER)
+        return FLV_OK;
+    if (tag->tag_type == TAGTYPE_VIDEODATA)
+        digest->has_video = 1;
+
+    if (digest_is_boundary(digest, tag)) {
+        ret = digest_close_gop(digest);
+        if (ret != FLV_OK)
+            return ret;
+        memset(&digest->current, 0, sizeof(digest->current));
+        digest->current.offset = tag->offset;
+        digest->current.timestamp = flv_tag_timestamp(tag);
+        flv_hash64_reset(&digest->gop_state, 0);
+        digest->in_gop = 1;
+    }
+    // Tags before the first keyframe belong to no GOP
+    if (!digest->in_gop)
+        return FLV_OK;
+
+    flv_hash64_update(&digest->gop_state, bytes, sizeof(bytes));
+    digest->current.tag_count++;
+    digest->current.bytes += tag->data_size;
+    digest->current.duration = flv_tag_timestamp(tag) - digest->current.timestamp;
+    return FLV_OK;
+}
+
+int flv_digest_final(flv_digest_t *digest) {
+    int ret = 0;
+
+    if (!digest)
+        return FLV_ERR_INVALID_ARG;
+    ret = digest_close_gop(digest);
+    digest->file_hash = flv_hash64_digest(&digest->file_state);
+    return ret;
+}
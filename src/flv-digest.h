@@ -0,0 +1,69 @@
+#ifndef FLV_DIGEST_H_
+#define FLV_DIGEST_H_
+
+/*
+ * Per-file and per-GOP content digests built from the per-tag payload
+ * hashes (flv_tag_info_t.hash). GOP digests cover only audio/video tag
+ * bodies, not timestamps or metadata, so the same segment hashes the same
+ * in different recordings; the file digest covers every tag body and
+ * verifies replicas.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "flv-core.h"
+#include "flv-hash.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// GOP length used to segment audio-only streams
+#define FLV_DIGEST_AUDIO_SEGMENT_MS (2000)
+
+typedef struct flv_gop_digest {
+    uint64_t offset;           // Offset of the first tag of the GOP
+    uint32_t timestamp;        // Timestamp of the first tag
+    uint32_t duration;         // Last timestamp - first timestamp
+    uint32_t tag_count;
+    uint64_t bytes;            // Sum of tag body sizes
+    uint64_t hash;
+} flv_gop_digest_t;
+
+typedef struct flv_digest {
+    flv_hash64_state_t file_state;
+    flv_hash64_state_t gop_state;
+    flv_gop_digest_t current;
+    int in_gop;
+    int has_video;
+    uint64_t tag_count;
+    flv_gop_digest_t *gops;    // Completed GOPs, in stream order
+    size_t gop_count;
+    size_t gop_size;
+    uint64_t file_hash;        // Valid after flv_digest_final
+} flv_digest_t;
+
+/*
+ * @brief `header` may be NULL; if it announces video, audio tags never
+ * start a GOP of their own
+ */
+void flv_digest_init(flv_digest_t *digest, const flv_header_t *header);
+
+/*
+ * @brief add the next tag. Uses tag->hash when the producer hashed
+ * payloads (flv_reader_set_hash), otherwise hashes the body here.
+ */
+int flv_digest_update(flv_digest_t *digest, const flv_tag_info_t *tag, int hashed);
+
+/*
+ * @brief close the last GOP and compute file_hash
+ */
+int flv_digest_final(flv_digest_t *digest);
+
+void flv_digest_destroy(flv_digest_t *digest);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FLV_DIGEST_H_
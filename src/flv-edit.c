@@ -0,0 +1,673 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
+#include "flv-edit.h"
+#include "flv-index.h"
+
+// Longest range handed to one copy call
+#define SPLICE_MAX_RUN (64 << 20)
+// Buffer for the read/write fallback
+#define SPLICE_BUFFER_SIZE (256 << 10)
+// Largest onMetaData body searched for the values to update
+#define METADATA_MAX_SIZE (1 << 20)
+
+enum copy_method {
+    COPY_FILE_RANGE,
+    COPY_SENDFILE,
+    COPY_READ_WRITE
+};
+
+typedef struct patch {
+    uint64_t offset;
+    uint32_t len;
+    uint8_t bytes[8];
+} patch_t;
+
+/*
+ * @brief output assembler. Input ranges that follow each other are merged
+ * into one run, and patches wait until the run under them is written.
+ */
+typedef struct splice {
+    int out_fd;
+    uint64_t pos;              // Output size, pending run included
+    int run_fd;
+    uint64_t run_in;           // Input offset of the pending run
+    uint64_t run_out;
+    uint64_t run_len;
+    patch_t *patches;
+    size_t patch_count;
+    size_t patch_capacity;
+    int method;                // enum copy_method, downgraded when the kernel refuses
+    uint8_t *buffer;
+    flv_edit_stats_t *stats;
+} splice_t;
+
+static int pwrite_all(int fd, const uint8_t *p, size_t len, uint64_t offset) {
+    while (len > 0) {
+        ssize_t count = pwrite(fd, p, len, (off_t) offset);
+
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return FLV_ERR_IO;
+        p += count;
+        len -= (size_t) count;
+        offset += (uint64_t) count;
+    }
+    return FLV_OK;
+}
+
+static int copy_range(splice_t *s, int in_fd, uint64_t in_off, uint64_t out_off, uint64_t len) {
+    while (len > 0) {
+        size_t want = len > SPLICE_MAX_RUN ? SPLICE_MAX_RUN : (size_t) len;
+        ssize_t count = -1;
+
+        if (s->method == COPY_FILE_RANGE) {
+            loff_t src = (loff_t) in_off;
+            loff_t dst = (loff_t) out_off;
+
+            count = copy_file_range(in_fd, &src, s->out_fd, &dst, want, 0);
+            // Older kernels, other file systems or special files
+            if (count < 0 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP)) {
+                s->method = COPY_SENDFILE;
+                continue;
+            }
+        } else if (s->method == COPY_SENDFILE) {
+            off_t src = (off_t) in_off;
+
+            if (lseek(s->out_fd, (off_t) out_off, SEEK_SET) < 0)
+                return FLV_ERR_IO;
+            count = sendfile(s->out_fd, in_fd, &src, want);
+            if (count < 0 && (errno == EINVAL || errno == ENOSYS)) {
+                s->method = COPY_READ_WRITE;
+                continue;
+            }
+        } else {
+            if (!s->buffer && !(s->buffer = malloc(SPLICE_BUFFER_SIZE)))
+                return FLV_ERR_NOMEM;
+            if (want > SPLICE_BUFFER_SIZE)
+                want = SPLICE_BUFFER_SIZE;
+            count = pread(in_fd, s->buffer, want, (off_t) in_off);
+            if (count > 0 && pwrite_all(s->out_fd, s->buffer, (size_t) count, out_off) != FLV_OK)
+                return FLV_ERR_IO;
+        }
+
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0)
+            return FLV_ERR_IO;
+        // The input shrank since it was indexed
+        if (count == 0)
+            return FLV_ERR_TRUNCATED;
+        if (s->method != COPY_READ_WRITE && s->stats)
+            s->stats->bytes_copied += (uint64_t) count;
+        in_off += (uint64_t) count;
+        out_off += (uint64_t) count;
+        len -= (uint64_t) count;
+    }
+    return FLV_OK;
+}
+
+static int splice_flush(splice_t *s) {
+    int ret = 0;
+
+    if (s->run_len > 0) {
+        ret = copy_range(s, s->run_fd, s->run_in, s->run_out, s->run_len);
+        if (ret != FLV_OK)
+            return ret;
+        s->run_len = 0;
+    }
+    for (size_t i = 0; i < s->patch_count; ++i) {
+        ret = pwrite_all(s->out_fd, s->patches[i].bytes, s->patches[i].len, s->patches[i].offset);
+        if (ret != FLV_OK)
+            return ret;
+    }
+    s->patch_count = 0;
+    return FLV_OK;
+}
+
+static int splice_copy(splice_t *s, int in_fd, uint64_t in_off, uint64_t len) {
+    int ret = 0;
+
+    if (s->run_len > 0 && s->run_fd == in_fd && s->run_in + s->run_len == in_off &&
+        s->run_len + len <= SPLICE_MAX_RUN) {
+        s->run_len += len;
+    } else {
+        ret = splice_flush(s);
+        if (ret != FLV_OK)
+            return ret;
+        s->run_fd = in_fd;
+        s->run_in = in_off;
+        s->run_out = s->pos;
+        s->run_len = len;
+    }
+    s->pos += len;
+    return FLV_OK;
+}
+
+static int splice_write(splice_t *s, const uint8_t *p, size_t len) {
+    int ret = splice_flush(s);
+
+    if (ret != FLV_OK)
+        return ret;
+    ret = pwrite_all(s->out_fd, p, len, s->pos);
+    s->pos += len;
+    return ret;
+}
+
+/*
+ * @brief overwrite up to 8 already placed output bytes at `offset`
+ */
+static int splice_patch(splice_t *s, uint64_t offset, const uint8_t *p, uint32_t len) {
+    if (s->patch_count == s->patch_capacity) {
+        size_t capacity = s->patch_capacity ? s->patch_capacity * 2 : 256;
+        patch_t *patches = realloc(s->patches, capacity * sizeof(*patches));
+
+        if (!patches)
+            return FLV_ERR_NOMEM;
+        s->patches = patches;
+        s->patch_capacity = capacity;
+    }
+    s->patches[s->patch_count].offset = offset;
+    s->patches[s->patch_count].len = len;
+    memcpy(s->patches[s->patch_count].bytes, p, len);
+    s->patch_count++;
+    if (s->stats)
+        s->stats->patches++;
+    return FLV_OK;
+}
+
+/*
+ * @brief copy one tag with its trailing PreviousTagSize, restamped with
+ * `timestamp`. The pair is self-contained, so only the timestamp and, in
+ * damaged inputs, the PreviousTagSize need rewriting.
+ */
+static int splice_tag(splice_t *s, int in_fd, const flv_index_entry_t *entry, uint32_t timestamp) {
+    uint64_t out = s->pos;
+    uint32_t tag_size = FLV_TAG_HEADER_SIZE + entry->data_size;
+    uint8_t bytes[4];
+    int ret = splice_copy(s, in_fd, entry->offset, flv_index_record_size(entry));
+
+    if (ret == FLV_OK && timestamp != entry->timestamp) {
+        // Timestamp UI24 and TimestampExtended UI8 are adjacent
+        flv_put_ui24(bytes, timestamp & 0xFFFFFF);
+        bytes[3] = (uint8_t) (timestamp >> 24);
+        ret = splice_patch(s, out + 4, bytes, 4);
+    }
+    if (ret == FLV_OK && entry->prev_tag_size != tag_size) {
+        flv_put_ui32(bytes, tag_size);
+        ret = splice_patch(s, out + tag_size, bytes, 4);
+    }
+    if (ret == FLV_OK && s->stats)
+        s->stats->tags_out++;
+    return ret;
+}
+
+static int splice_begin(splice_t *s, int out_fd, uint8_t type_flags, flv_edit_stats_t *stats) {
+    uint8_t header[FLV_HEADER_SIZE + FLV_PREV_TAG_SIZE_SIZE] = {'F', 'L', 'V', 1};
+
+    memset(s, 0, sizeof(*s));
+    s->out_fd = out_fd;
+    s->stats = stats;
+    header[4] = type_flags;
+    flv_put_ui32(header + 5, FLV_HEADER_SIZE);
+    return splice_write(s, header, sizeof(header));
+}
+
+static int splice_end(splice_t *s) {
+    int ret = splice_flush(s);
+
+    // The output may have been longer before
+    if (ret == FLV_OK && ftruncate(s->out_fd, (off_t) s->pos) != 0)
+        ret = FLV_ERR_IO;
+    if (s->stats)
+        s->stats->bytes_out = s->pos;
+    free(s->patches);
+    free(s->buffer);
+    return ret;
+}
+
+static int read_body(int fd, const flv_index_entry_t *entry, uint8_t **body) {
+    size_t done = 0;
+
+    *body = malloc(entry->data_size ? entry->data_size : 1);
+    if (!*body)
+        return FLV_ERR_NOMEM;
+    while (done < entry->data_size) {
+        ssize_t count = pread(fd, *body + done, entry->data_size - done,
+                              (off_t) (entry->offset + FLV_TAG_HEADER_SIZE + done));
+
+        if (count <= 0) {
+            free(*body);
+            *body = NULL;
+            return count == 0 ? FLV_ERR_TRUNCATED : FLV_ERR_IO;
+        }
+        done += (size_t) count;
+    }
+    return FLV_OK;
+}
+
+// onMetaData values describing a track, cleared when flv_filter drops it
+static const char *const audio_fields[] = {
+    "audiocodecid", "audiodatarate", "audiosamplerate", "audiosamplesize", "audiosize", "stereo",
+    "hasAudio", NULL
+};
+static const char *const video_fields[] = {
+    "videocodecid", "videodatarate", "framerate", "width", "height", "videosize", "hasVideo", NULL
+};
+// Keyframes only: no audio, and the video rates no longer hold
+static const char *const keyframe_fields[] = {
+    "audiocodecid", "audiodatarate", "audiosamplerate", "audiosamplesize", "audiosize", "stereo",
+    "hasAudio", "videodatarate", "framerate", NULL
+};
+
+/*
+ * @brief offset of the AMF number or boolean stored under `name` in a
+ * script tag body, -1 if there is none; *type tells which. A plain byte
+ * search: onMetaData keys are unique enough that nested objects do not get
+ * in the way.
+ */
+static long find_meta_value(const uint8_t *body, size_t size, const char *name, uint8_t *type) {
+    static const uint8_t types[] = {AMF_TYPE_NUMBER, AMF_TYPE_BOOLEAN};
+    uint8_t key[32];
+    size_t len = strlen(name);
+
+    key[0] = 0;
+    key[1] = (uint8_t) len;
+    memcpy(key + 2, name, len);
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); ++i) {
+        size_t value_size = types[i] == AMF_TYPE_NUMBER ? 8 : 1;
+        const uint8_t *found = NULL;
+
+        key[2 + len] = types[i];
+        found = memmem(body, size, key, len + 3);
+        if (found && (size_t) (found - body) + len + 3 + value_size <= size) {
+            *type = types[i];
+            return (long) (found - body) + (long) len + 3;
+        }
+    }
+    return -1;
+}
+
+static long find_meta_number(const uint8_t *body, size_t size, const char *name) {
+    uint8_t type = 0;
+    long offset = find_meta_value(body, size, name, &type);
+
+    return type == AMF_TYPE_NUMBER ? offset : -1;
+}
+
+static int patch_meta_number(splice_t *s, uint64_t offset, double value) {
+    uint8_t bytes[8];
+    uint64_t bits = 0;
+
+    memcpy(&bits, &value, sizeof(bits));
+    flv_put_ui32(bytes, (uint32_t) (bits >> 32));
+    flv_put_ui32(bytes + 4, (uint32_t) bits);
+    return splice_patch(s, offset, bytes, 8);
+}
+
+/*
+ * @brief rewrite the onMetaData filesize, and the duration unless
+ * `duration` (milliseconds) is negative, of the script tag `entry` that
+ * was written at `out`. The values named in `cleared` (NULL-terminated,
+ * may be NULL) are set to 0 or false. Call once the output is complete.
+ */
+static int update_metadata(splice_t *s, int fd, const flv_index_entry_t *entry, uint64_t out, int64_t duration,
+                           const char *const *cleared) {
+    static const uint8_t zero = 0;
+    uint8_t *body = NULL;
+    long offset = 0;
+    int ret = 0;
+
+    if (entry->data_size > METADATA_MAX_SIZE)
+        return FLV_OK;
+    ret = read_body(fd, entry, &body);
+    if (ret != FLV_OK)
+        return ret;
+    out += FLV_TAG_HEADER_SIZE;
+    if (duration >= 0 && (offset = find_meta_number(body, entry->data_size, "duration")) >= 0)
+        ret = patch_meta_number(s, out + (uint64_t) offset, duration / 1000.0);
+    if (ret == FLV_OK && (offset = find_meta_number(body, entry->data_size, "filesize")) >= 0)
+        ret = patch_meta_number(s, out + (uint64_t) offset, (double) s->pos);
+    for (size_t i = 0; cleared && cleared[i] && ret == FLV_OK; ++i) {
+        uint8_t type = 0;
+
+        offset = find_meta_value(body, entry->data_size, cleared[i], &type);
+        if (offset >= 0 && type == AMF_TYPE_NUMBER)
+            ret = patch_meta_number(s, out + (uint64_t) offset, 0);
+        else if (offset >= 0)
+            ret = splice_patch(s, out + (uint64_t) offset, &zero, 1);
+    }
+    free(body);
+    return ret;
+}
+
+typedef struct concat_input {
+    int fd;
+    flv_index_t index;
+    uint32_t first;            // First and last audio/video timestamp
+    uint32_t last;
+    uint32_t frame;            // Duration of the last frame, at least 1 ms
+    int video_codec;           // -1 = no such track
+    int audio_codec;
+    const flv_index_entry_t *video_config;   // First sequence headers
+    const flv_index_entry_t *audio_config;
+} concat_input_t;
+
+static void scan_input(concat_input_t *in) {
+    uint32_t prev_video = 0;
+    uint32_t prev_audio = 0;
+    uint32_t video_frame = 0;
+    uint32_t audio_frame = 0;
+    size_t media = 0;
+
+    in->video_codec = -1;
+    in->audio_codec = -1;
+    for (size_t i = 0; i < in->index.count; ++i) {
+        const flv_index_entry_t *entry = &in->index.entries[i];
+
+        if (entry->tag_type != TAGTYPE_VIDEODATA && entry->tag_type != TAGTYPE_AUDIODATA)
+            continue;
+        if (media == 0 || entry->timestamp < in->first)
+            in->first = entry->timestamp;
+        if (media++ == 0 || entry->timestamp > in->last)
+            in->last = entry->timestamp;
+
+        if (entry->tag_type == TAGTYPE_VIDEODATA) {
+            if (entry->flags & FLV_INDEX_SEQUENCE_HEADER) {
+                if (!in->video_config)
+                    in->video_config = entry;
+                continue;
+            }
+            if (in->video_codec >= 0 && entry->timestamp > prev_video)
+                video_frame = entry->timestamp - prev_video;
+            if (in->video_codec < 0)
+                in->video_codec = entry->codec;
+            prev_video = entry->timestamp;
+        } else {
+            if (entry->flags & FLV_INDEX_SEQUENCE_HEADER) {
+                if (!in->audio_config)
+                    in->audio_config = entry;
+                continue;
+            }
+            if (in->audio_codec >= 0 && entry->timestamp > prev_audio)
+                audio_frame = entry->timestamp - prev_audio;
+            if (in->audio_codec < 0)
+                in->audio_codec = entry->codec;
+            prev_audio = entry->timestamp;
+        }
+    }
+    // The video frame rate paces the join when there is video
+    in->frame = in->video_codec >= 0 ? video_frame : audio_frame;
+    if (in->frame == 0)
+        in->frame = 1;
+}
+
+/*
+ * @brief whether two sequence headers carry the same codec configuration.
+ * A missing one matches anything: the stream goes on with the other.
+ */
+static int same_config(int fd_a, const flv_index_entry_t *a, int fd_b, const flv_index_entry_t *b, int *same) {
+    uint8_t *body_a = NULL;
+    uint8_t *body_b = NULL;
+    int ret = 0;
+
+    *same = 1;
+    if (!a || !b)
+        return FLV_OK;
+    if (a->data_size != b->data_size) {
+        *same = 0;
+        return FLV_OK;
+    }
+    ret = read_body(fd_a, a, &body_a);
+    if (ret == FLV_OK)
+        ret = read_body(fd_b, b, &body_b);
+    if (ret == FLV_OK)
+        *same = memcmp(body_a, body_b, a->data_size) == 0;
+    free(body_a);
+    free(body_b);
+    return ret;
+}
+
+static int check_input(concat_input_t *in, const concat_input_t *ref) {
+    int same = 1;
+    int ret = 0;
+
+    if (in->index.header.version != 1)
+        return FLV_ERR_VERSION;
+    if ((in->video_codec >= 0 && ref->video_codec >= 0 && in->video_codec != ref->video_codec) ||
+        (in->audio_codec >= 0 && ref->audio_codec >= 0 && in->audio_codec != ref->audio_codec))
+        return FLV_ERR_MISMATCH;
+    ret = same_config(ref->fd, ref->video_config, in->fd, in->video_config, &same);
+    if (ret == FLV_OK && same)
+        ret = same_config(ref->fd, ref->audio_config, in->fd, in->audio_config, &same);
+    if (ret == FLV_OK && !same)
+        ret = FLV_ERR_MISMATCH;
+    return ret;
+}
+
+/*
+ * @brief whether a tag of a later input is left out of the output
+ */
+static int concat_drop(const concat_input_t *in, const flv_index_entry_t *entry, const concat_input_t *ref,
+                       int *drop) {
+    const flv_index_entry_t *config = NULL;
+
+    *drop = 0;
+    if (entry->flags & FLV_INDEX_METADATA) {
+        *drop = 1;
+        return FLV_OK;
+    }
+    if (!(entry->flags & FLV_INDEX_SEQUENCE_HEADER))
+        return FLV_OK;
+    config = entry->tag_type == TAGTYPE_VIDEODATA ? ref->video_config : ref->audio_config;
+    if (!config)
+        return FLV_OK;
+    return same_config(ref->fd, config, in->fd, entry, drop);
+}
+
+static int concat_write(splice_t *s, concat_input_t *inputs, size_t count, const flv_concat_config_t *config,
+                        flv_edit_stats_t *stats) {
+    const flv_index_entry_t *metadata = NULL;
+    uint64_t metadata_out = 0;
+    uint64_t base = 0;
+    uint64_t end = 0;
+    int ret = 0;
+
+    for (size_t k = 0; k < count; ++k) {
+        concat_input_t *in = &inputs[k];
+
+        stats->failed_input = (int) k;
+        for (size_t i = 0; i < in->index.count; ++i) {
+            const flv_index_entry_t *entry = &in->index.entries[i];
+            uint64_t timestamp = base + (entry->timestamp > in->first ? entry->timestamp - in->first : 0);
+            int drop = 0;
+
+            if (k > 0) {
+                ret = concat_drop(in, entry, &inputs[0], &drop);
+                if (ret != FLV_OK)
+                    return ret;
+                if (drop)
+                    continue;
+            }
+            if (timestamp > UINT32_MAX)
+                return FLV_ERR_LIMIT;
+            if (!metadata && (entry->flags & FLV_INDEX_METADATA)) {
+                metadata = entry;
+                metadata_out = s->pos;
+            }
+            ret = splice_tag(s, in->fd, entry, (uint32_t) timestamp);
+            if (ret != FLV_OK)
+                return ret;
+        }
+        // The next input starts one frame after this one ends
+        if (in->video_codec >= 0 || in->audio_codec >= 0) {
+            end = base + (in->last - in->first) + in->frame;
+            base = end;
+        }
+    }
+    stats->failed_input = -1;
+    stats->duration = end > UINT32_MAX ? UINT32_MAX : (uint32_t) end;
+
+    if (metadata && !config->keep_metadata)
+        ret = update_metadata(s, inputs[0].fd, metadata, metadata_out, (int64_t) end, NULL);
+    return ret;
+}
+
+int flv_concat(int out_fd, const int *in_fds, size_t count, const flv_concat_config_t *config,
+               flv_edit_stats_t *stats) {
+    static const flv_concat_config_t default_config;
+    concat_input_t *inputs = NULL;
+    flv_edit_stats_t local_stats;
+    uint8_t type_flags = 0;
+    splice_t splice;
+    size_t k = 0;
+    int ret = 0;
+
+    if (out_fd < 0 || !in_fds || count == 0)
+        return FLV_ERR_INVALID_ARG;
+    if (!config)
+        config = &default_config;
+    if (!stats)
+        stats = &local_stats;
+    memset(stats, 0, sizeof(*stats));
+    stats->failed_input = -1;
+    inputs = calloc(count, sizeof(concat_input_t));
+    if (!inputs)
+        return FLV_ERR_NOMEM;
+
+    // Everything is checked before the first byte is written
+    for (k = 0; k < count; ++k) {
+        concat_input_t *in = &inputs[k];
+
+        in->fd = in_fds[k];
+        ret = flv_index_build(&in->index, in->fd);
+        if (ret != FLV_OK)
+            break;
+        scan_input(in);
+        ret = check_input(in, &inputs[0]);
+        if (ret == FLV_ERR_MISMATCH && config->force)
+            ret = FLV_OK;
+        if (ret != FLV_OK)
+            break;
+        if (in->index.status != FLV_OK)
+            stats->truncated_inputs++;
+        stats->tags_in += in->index.count;
+        if (in->video_codec >= 0)
+            type_flags |= 1 << FLV_HEADER_VIDEO_BIT;
+        if (in->audio_codec >= 0)
+            type_flags |= 1 << FLV_HEADER_AUDIO_BIT;
+    }
+
+    if (ret == FLV_OK) {
+        ret = splice_begin(&splice, out_fd, type_flags, stats);
+        if (ret == FLV_OK)
+            ret = concat_write(&splice, inputs, count, config, stats);
+        if (ret == FLV_OK)
+            ret = splice_end(&splice);
+        else
+            splice_end(&splice);
+    } else {
+        stats->failed_input = (int) k;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+        flv_index_destroy(&inputs[i].index);
+    free(inputs);
+    return ret;
+}
+
+/*
+ * @brief whether `entry` is kept. `keyframes` counts the keyframes seen.
+ */
+static int filter_keep(const flv_filter_config_t *config, const flv_index_entry_t *entry, uint32_t *keyframes) {
+    if (entry->flags & FLV_INDEX_METADATA)
+        return !config->drop_metadata;
+    switch (config->mode) {
+        case FLV_FILTER_AUDIO:
+            return entry->tag_type == TAGTYPE_AUDIODATA;
+        case FLV_FILTER_VIDEO:
+            return entry->tag_type == TAGTYPE_VIDEODATA;
+        case FLV_FILTER_KEYFRAMES:
+            if (entry->tag_type != TAGTYPE_VIDEODATA)
+                return 0;
+            if (entry->flags & FLV_INDEX_SEQUENCE_HEADER)
+                return 1;
+            if (!(entry->flags & FLV_INDEX_KEYFRAME))
+                return 0;
+            return config->keyframe_step <= 1 || (*keyframes)++ % config->keyframe_step == 0;
+        default:
+            return 0;
+    }
+}
+
+int flv_filter(int out_fd, int in_fd, const flv_filter_config_t *config, flv_edit_stats_t *stats) {
+    static const char *const *cleared[] = {NULL, video_fields, audio_fields, keyframe_fields};
+    const flv_index_entry_t *metadata = NULL;
+    flv_edit_stats_t local_stats;
+    concat_input_t in;
+    uint64_t metadata_out = 0;
+    uint32_t keyframes = 0;
+    uint64_t media = 0;
+    uint32_t first = 0;
+    uint32_t last = 0;
+    uint8_t type_flags = 0;
+    splice_t splice;
+    int ret = 0;
+
+    if (out_fd < 0 || in_fd < 0 || !config || config->mode < FLV_FILTER_AUDIO || config->mode > FLV_FILTER_KEYFRAMES)
+        return FLV_ERR_INVALID_ARG;
+    if (!stats)
+        stats = &local_stats;
+    memset(stats, 0, sizeof(*stats));
+    stats->failed_input = 0;
+    memset(&in, 0, sizeof(in));
+    in.fd = in_fd;
+    ret = flv_index_build(&in.index, in_fd);
+    if (ret != FLV_OK)
+        return ret;
+    scan_input(&in);
+    if (in.index.status != FLV_OK)
+        stats->truncated_inputs = 1;
+    stats->tags_in = in.index.count;
+
+    // TypeFlags are known once the tags are chosen; patched in at the end
+    ret = splice_begin(&splice, out_fd, 0, stats);
+    for (size_t i = 0; ret == FLV_OK && i < in.index.count; ++i) {
+        const flv_index_entry_t *entry = &in.index.entries[i];
+
+        if (!filter_keep(config, entry, &keyframes))
+            continue;
+        if (entry->flags & FLV_INDEX_METADATA) {
+            if (!metadata) {
+                metadata = entry;
+                metadata_out = splice.pos;
+            }
+        } else {
+            type_flags |= 1 << (entry->tag_type == TAGTYPE_VIDEODATA ? FLV_HEADER_VIDEO_BIT : FLV_HEADER_AUDIO_BIT);
+            if (!(entry->flags & FLV_INDEX_SEQUENCE_HEADER)) {
+                if (media == 0 || entry->timestamp < first)
+                    first = entry->timestamp;
+                if (media++ == 0 || entry->timestamp > last)
+                    last = entry->timestamp;
+            }
+        }
+        ret = splice_tag(&splice, in_fd, entry, entry->timestamp);
+    }
+    stats->duration = last - first;
+    if (ret == FLV_OK && type_flags != 0)
+        ret = splice_patch(&splice, 4, &type_flags, 1);
+    if (ret == FLV_OK && metadata)
+        ret = update_metadata(&splice, in_fd, metadata, metadata_out, -1, cleared[config->mode]);
+    if (ret == FLV_OK) {
+        stats->failed_input = -1;
+        ret = splice_end(&splice);
+    } else {
+        splice_end(&splice);
+    }
+    flv_index_destroy(&in.index);
+    return ret;
+}
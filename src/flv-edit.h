@@ -0,0 +1,74 @@
+#ifndef FLV_EDIT_H_
+#define FLV_EDIT_H_
+
+/*
+ * Editing whole files without rewriting the payloads. The inputs are
+ * indexed (flv-index.h), the selected tags are moved to the output with
+ * copy_file_range() or sendfile(), and only the few header bytes that
+ * change, timestamps and PreviousTagSize fields, are patched in afterwards.
+ * Outputs must be regular files, inputs must be seekable.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "flv-core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct flv_concat_config {
+    int force;                 // Join inputs whose codecs or codec configuration differ
+    int keep_metadata;         // Leave onMetaData duration and filesize as they are
+} flv_concat_config_t;
+
+enum flv_filter_mode {
+    FLV_FILTER_AUDIO = 1,      // Audio tags only
+    FLV_FILTER_VIDEO,          // Video tags only
+    FLV_FILTER_KEYFRAMES       // Video keyframes only, for scrubbing and trick play
+};
+
+typedef struct flv_filter_config {
+    int mode;                  // enum flv_filter_mode
+    uint32_t keyframe_step;    // FLV_FILTER_KEYFRAMES: keep every Nth keyframe, 0 = every one
+    int drop_metadata;         // Leave the script tags out as well
+} flv_filter_config_t;
+
+typedef struct flv_edit_stats {
+    uint64_t tags_in;          // Complete tags found in the inputs
+    uint64_t tags_out;
+    uint64_t bytes_out;
+    uint64_t bytes_copied;     // Moved by copy_file_range() or sendfile()
+    uint64_t patches;          // Header fields rewritten in the output
+    uint32_t duration;         // Milliseconds of output, including the last frame
+    uint32_t truncated_inputs; // Inputs with an incomplete last tag, which is left out
+    int failed_input;          // Input an error refers to, -1 if none
+} flv_edit_stats_t;
+
+/*
+ * @brief join `count` inputs into `out_fd`, rebasing each input's
+ * timestamps to continue one frame after the previous input ends. Script
+ * tags and repeated sequence headers of later inputs are dropped. Inputs
+ * with other codecs or codec configuration fail with FLV_ERR_MISMATCH
+ * unless config->force is set, in which case their sequence headers are
+ * kept. `config` and `stats` may be NULL.
+ */
+int flv_concat(int out_fd, const int *in_fds, size_t count, const flv_concat_config_t *config,
+               flv_edit_stats_t *stats);
+
+/*
+ * @brief copy the tags of `in_fd` selected by `config` to `out_fd` with
+ * their timestamps unchanged. Sequence headers of the kept track and, by
+ * default, script tags are kept; the header TypeFlags are recomputed from
+ * the tags written and the onMetaData filesize is updated. The onMetaData
+ * values of a dropped track (codec id, data rate, dimensions and so on)
+ * are set to 0 or false, as are framerate and videodatarate when only
+ * keyframes are kept.
+ */
+int flv_filter(int out_fd, int in_fd, const flv_filter_config_t *config, flv_edit_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FLV_EDIT_H_
@@ -0,0 +1,479 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "flv-estimate.h"
+
+// PreviousTagSize followed by the tag header
+#define RECORD_HEADER_SIZE (FLV_PREV_TAG_SIZE_SIZE + FLV_TAG_HEADER_SIZE)
+
+// Consecutive tags that must check out before a resync point is trusted
+#define RESYNC_CHAIN (3)
+
+// Read at the start of the body to find the first audio/video tag
+#define HEAD_PROBE_BYTES (64 << 10)
+
+// Two-sided 95% Student t quantiles for 1..30 degrees of freedom
+static const double t_quantiles[] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+};
+
+/*
+ * @brief random access to the file, either mapped or through pread()
+ */
+typedef struct source {
+    const uint8_t *mem;
+    int fd;
+    uint64_t size;
+    uint8_t *buf;
+    uint64_t last_offset;      // Range of the last read, still in buf
+    size_t last_len;
+    uint64_t bytes_read;       // Reads served from the last range are not counted
+} source_t;
+
+/*
+ * @brief running sums of one sampled quantity
+ */
+typedef struct sample_sum {
+    double sum;
+    double sum_sq;
+    uint32_t count;
+} sample_sum_t;
+
+/*
+ * @brief what the GOPs of one window measured. Neighbouring GOPs are not
+ * independent, so a window is pooled into one sample.
+ */
+typedef struct window_sum {
+    uint64_t bytes;
+    uint64_t video_bytes;
+    uint32_t span;             // Milliseconds covered by bytes
+    uint32_t frames;
+    uint32_t frame_span;       // Milliseconds covered by frames
+    uint32_t gops;             // Complete GOPs
+    uint32_t gop_span;
+} window_sum_t;
+
+typedef struct estimator {
+    sample_sum_t bitrate;
+    sample_sum_t frame_rate;
+    sample_sum_t keyframe_interval;
+    sample_sum_t video_share;
+    uint8_t video_codec;
+    uint8_t audio_codec;
+} estimator_t;
+
+/*
+ * @brief up to `len` bytes at `offset`; *got is short near the end of the
+ * file. NULL on a read error.
+ */
+static const uint8_t *source_read(source_t *src, uint64_t offset, size_t len, size_t *got) {
+    size_t done = 0;
+
+    *got = 0;
+    if (offset >= src->size)
+        return src->mem ? src->mem : src->buf;
+    if (len > src->size - offset)
+        len = (size_t) (src->size - offset);
+    if (src->last_len && offset >= src->last_offset && offset + len <= src->last_offset + src->last_len) {
+        *got = len;
+        return src->mem ? src->mem + offset : src->buf + (offset - src->last_offset);
+    }
+    src->bytes_read += len;
+    src->last_offset = offset;
+    src->last_len = len;
+    if (src->mem) {
+        *got = len;
+        return src->mem + offset;
+    }
+    while (done < len) {
+        ssize_t count = pread(src->fd, src->buf + done, len - done, (off_t) (offset + done));
+
+        if (count < 0) {
+            src->last_len = 0;
+            return NULL;
+        }
+        if (count == 0)
+            break;
+        done += (size_t) count;
+    }
+    src->last_len = done;
+    *got = done;
+    return src->buf;
+}
+
+static void sample_add(sample_sum_t *s, double value) {
+    s->sum += value;
+    s->sum_sq += value * value;
+    s->count++;
+}
+
+static void sample_range(const sample_sum_t *s, flv_estimate_range_t *range) {
+    double variance = 0;
+    double half = 0;
+
+    memset(range, 0, sizeof(*range));
+    if (s->count == 0)
+        return;
+    range->count = s->count;
+    range->mean = s->sum / s->count;
+    if (s->count > 1) {
+        variance = (s->sum_sq - s->sum * range->mean) / (s->count - 1);
+        if (variance < 0)
+            variance = 0;
+        half = (s->count - 1 <= sizeof(t_quantiles) / sizeof(t_quantiles[0]) ?
+                t_quantiles[s->count - 2] : 1.96) * sqrt(variance / s->count);
+    }
+    range->low = range->mean - half;
+    range->high = range->mean + half;
+}
+
+static int plausible_tag(const uint8_t *p) {
+    return (p[0] == TAGTYPE_AUDIODATA || p[0] == TAGTYPE_VIDEODATA || p[0] == TAGTYPE_SCRIPTDATAOBJECT) &&
+           p[8] == 0 && p[9] == 0 && p[10] == 0;
+}
+
+/*
+ * @brief offset of the first tag header at or after `from` that starts a
+ * chain of RESYNC_CHAIN well-formed tags, each followed by a matching
+ * PreviousTagSize; `len` if there is none
+ */
+static size_t resync(const uint8_t *p, size_t len, size_t from) {
+    for (size_t q = from; q + FLV_TAG_HEADER_SIZE <= len; ++q) {
+        size_t r = q;
+        int chain = 0;
+
+        while (chain < RESYNC_CHAIN && r + FLV_TAG_HEADER_SIZE <= len && plausible_tag(p + r)) {
+            uint32_t tag_size = FLV_TAG_HEADER_SIZE + flv_get_ui24(p + r + 1);
+
+            if (len - r < tag_size + FLV_PREV_TAG_SIZE_SIZE || flv_get_ui32(p + r + tag_size) != tag_size)
+                break;
+            r += tag_size + FLV_PREV_TAG_SIZE_SIZE;
+            chain++;
+        }
+        if (chain == RESYNC_CHAIN)
+            return q;
+    }
+    return len;
+}
+
+static int is_video_frame(const flv_tag_info_t *tag) {
+    if (tag->frame_type == FLV_FRAME_TYPE_COMMAND)
+        return 0;
+    return tag->codec_id != FLV_CODEC_ID_AVC || tag->avc_packet_type == FLV_AVC_NALU;
+}
+
+/*
+ * @brief whether the complete tags from `q` on include video; the header
+ * TypeFlags are not trusted for this
+ */
+static int window_has_video(const uint8_t *p, size_t len, size_t q) {
+    while (q + FLV_TAG_HEADER_SIZE <= len) {
+        if (p[q] == TAGTYPE_VIDEODATA)
+            return 1;
+        q += FLV_TAG_HEADER_SIZE + (size_t) flv_get_ui24(p + q + 1) + FLV_PREV_TAG_SIZE_SIZE;
+    }
+    return 0;
+}
+
+/*
+ * @brief measure one GOP (video) or the rest of the window (audio only)
+ * from the tag header at `q`. A GOP cut off by the end of the window is
+ * measured only if `partial` is set, since the stub left after whole GOPs
+ * would skew the results. The figures are added to `w`. Returns 1 if
+ * anything could be measured; *next is where the following GOP starts, or
+ * `len`.
+ */
+static int measure_window(estimator_t *est, window_sum_t *w, const uint8_t *p, size_t len, size_t q,
+                          int has_video, int partial, size_t *next) {
+    flv_tag_info_t tag;
+    int started = 0;
+    int complete = 0;
+    uint32_t start_ts = 0;
+    uint32_t last_ts = 0;          // Of the last audio/video tag
+    uint32_t last_video_ts = 0;
+    uint64_t bytes = 0;            // Records from the start up to the current tag
+    uint64_t video_bytes = 0;
+    uint64_t bytes_at_last = 0;    // Records before the last audio/video tag
+    uint64_t video_bytes_at_last = 0;
+    uint32_t frames = 0;
+    uint32_t span = 0;
+
+    *next = len;
+    while (q + FLV_TAG_HEADER_SIZE <= len) {
+        uint32_t timestamp = 0;
+        size_t record = 0;
+        int media = 0;
+
+        flv_decode_tag_header(p + q, len - q, &tag);
+        record = FLV_TAG_HEADER_SIZE + (size_t) tag.data_size + FLV_PREV_TAG_SIZE_SIZE;
+        if (len - q < record || flv_decode_tag_body(&tag, p + q + FLV_TAG_HEADER_SIZE, tag.data_size) != FLV_OK)
+            break;
+        timestamp = flv_tag_timestamp(&tag);
+        media = tag.tag_type == TAGTYPE_AUDIODATA || tag.tag_type == TAGTYPE_VIDEODATA;
+
+        if (tag.tag_type == TAGTYPE_VIDEODATA && est->video_codec == 0xFF)
+            est->video_codec = tag.codec_id;
+        else if (tag.tag_type == TAGTYPE_AUDIODATA && est->audio_codec == 0xFF) {
+            est->audio_codec = tag.sound_format;
+        }
+
+        // Video streams are measured from one keyframe to the next
+        if (has_video && tag.tag_type == TAGTYPE_VIDEODATA && tag.frame_type == FLV_FRAME_TYPE_KEY &&
+            is_video_frame(&tag)) {
+            if (started) {
+                complete = 1;
+                last_ts = timestamp;
+                *next = q;
+                break;
+            }
+            started = 1;
+            start_ts = timestamp;
+        } else if (!has_video && tag.tag_type == TAGTYPE_AUDIODATA && !started) {
+            started = 1;
+            start_ts = timestamp;
+        }
+
+        if (started) {
+            if (media) {
+                last_ts = timestamp;
+                bytes_at_last = bytes;
+                video_bytes_at_last = video_bytes;
+            }
+            if (tag.tag_type == TAGTYPE_VIDEODATA) {
+                video_bytes += record;
+                if (is_video_frame(&tag)) {
+                    frames++;
+                    last_video_ts = timestamp;
+                }
+            }
+            bytes += record;
+        }
+        q += record;
+    }
+
+    if (!started || last_ts <= start_ts || (!complete && !partial))
+        return 0;
+    span = last_ts - start_ts;
+    if (complete) {
+        w->gops++;
+        w->gop_span += span;
+        w->frames += frames;
+        w->frame_span += span;
+    } else {
+        bytes = bytes_at_last;
+        video_bytes = video_bytes_at_last;
+        if (frames > 1 && last_video_ts > start_ts) {
+            w->frames += frames - 1;
+            w->frame_span += last_video_ts - start_ts;
+        }
+    }
+    if (bytes > 0) {
+        w->bytes += bytes;
+        w->video_bytes += video_bytes;
+        w->span += span;
+    }
+    return 1;
+}
+
+/*
+ * @brief add one window's figures as one sample of each quantity
+ */
+static void window_add(estimator_t *est, const window_sum_t *w) {
+    if (w->gops > 0)
+        sample_add(&est->keyframe_interval, w->gop_span / 1000.0 / w->gops);
+    if (w->frame_span > 0)
+        sample_add(&est->frame_rate, w->frames * 1000.0 / w->frame_span);
+    if (w->bytes > 0 && w->span > 0) {
+        sample_add(&est->bitrate, w->bytes * 8.0 / w->span);    // bits per ms == kbit/s
+        sample_add(&est->video_share, (double) w->video_bytes / w->bytes);
+    }
+}
+
+/*
+ * @brief timestamp of the first audio/video tag in `p`, which holds the
+ * start of the body
+ */
+static int first_timestamp(const uint8_t *p, size_t len, uint32_t *timestamp) {
+    flv_tag_info_t tag;
+    size_t q = FLV_PREV_TAG_SIZE_SIZE;
+
+    while (q + FLV_TAG_HEADER_SIZE <= len) {
+        flv_decode_tag_header(p + q, len - q, &tag);
+        if (tag.tag_type == TAGTYPE_AUDIODATA || tag.tag_type == TAGTYPE_VIDEODATA) {
+            *timestamp = flv_tag_timestamp(&tag);
+            return FLV_OK;
+        }
+        q += FLV_TAG_HEADER_SIZE + (size_t) tag.data_size + FLV_PREV_TAG_SIZE_SIZE;
+    }
+    return FLV_ERR_TRUNCATED;
+}
+
+/*
+ * @brief timestamp of the first audio/video tag, for when the first window
+ * was too short to hold it
+ */
+static int probe_head(source_t *src, uint64_t data_offset, uint32_t *timestamp) {
+    const uint8_t *p = NULL;
+    size_t len = 0;
+
+    p = source_read(src, data_offset, HEAD_PROBE_BYTES, &len);
+    if (!p)
+        return FLV_ERR_IO;
+    return first_timestamp(p, len, timestamp);
+}
+
+/*
+ * @brief timestamp of the last tag, found through the trailing
+ * PreviousTagSize
+ */
+static int probe_tail(source_t *src, uint64_t data_offset, uint32_t *timestamp) {
+    flv_tag_info_t tag;
+    const uint8_t *p = NULL;
+    uint32_t prev_tag_size = 0;
+    size_t len = 0;
+
+    if (src->size < data_offset + FLV_PREV_TAG_SIZE_SIZE * 2 + FLV_TAG_HEADER_SIZE)
+        return FLV_ERR_TRUNCATED;
+    p = source_read(src, src->size - FLV_PREV_TAG_SIZE_SIZE, FLV_PREV_TAG_SIZE_SIZE, &len);
+    if (!p || len < FLV_PREV_TAG_SIZE_SIZE)
+        return FLV_ERR_IO;
+    prev_tag_size = flv_get_ui32(p);
+    if (prev_tag_size < FLV_TAG_HEADER_SIZE ||
+        prev_tag_size > src->size - data_offset - FLV_PREV_TAG_SIZE_SIZE * 2)
+        return FLV_ERR_MALFORMED;
+
+    p = source_read(src, src->size - FLV_PREV_TAG_SIZE_SIZE - prev_tag_size, FLV_TAG_HEADER_SIZE, &len);
+    if (!p || len < FLV_TAG_HEADER_SIZE)
+        return FLV_ERR_IO;
+    flv_decode_tag_header(p, len, &tag);
+    if (!plausible_tag(p) || tag.data_size + FLV_TAG_HEADER_SIZE != prev_tag_size)
+        return FLV_ERR_MALFORMED;
+    *timestamp = flv_tag_timestamp(&tag);
+    return FLV_OK;
+}
+
+static int estimate(source_t *src, const flv_estimate_config_t *config, flv_estimate_t *out) {
+    estimator_t est;
+    flv_header_t header;
+    const uint8_t *p = NULL;
+    size_t window_bytes = (config && config->window_bytes) ? config->window_bytes : FLV_ESTIMATE_WINDOW_BYTES;
+    uint32_t samples = (config && config->samples) ? config->samples : FLV_ESTIMATE_SAMPLES;
+    uint32_t windows = 0;
+    uint64_t body = 0;
+    uint32_t first_ts = 0;
+    uint32_t last_ts = 0;
+    size_t len = 0;
+    size_t first_len = 0;
+    int head = FLV_ERR_TRUNCATED;
+    int ret = 0;
+
+    memset(out, 0, sizeof(*out));
+    memset(&est, 0, sizeof(est));
+    est.video_codec = 0xFF;
+    est.audio_codec = 0xFF;
+    out->file_size = src->size;
+    if (!src->mem) {
+        src->buf = malloc(window_bytes > HEAD_PROBE_BYTES ? window_bytes : HEAD_PROBE_BYTES);
+        if (!src->buf)
+            return FLV_ERR_NOMEM;
+    }
+
+    p = source_read(src, 0, FLV_HEADER_SIZE, &len);
+    if (!p)
+        return FLV_ERR_IO;
+    ret = flv_decode_header(p, len, &header);
+    if (ret != FLV_OK)
+        return ret;
+    out->type_flags = header.type_flags;
+    if (header.data_offset >= src->size)
+        return FLV_ERR_TRUNCATED;
+
+    // Windows must not overlap, or small files would be counted twice;
+    // fewer windows then measure several GOPs each
+    body = src->size - header.data_offset;
+    windows = samples;
+    if (body / window_bytes < windows)
+        windows = body / window_bytes > 0 ? (uint32_t) (body / window_bytes) : 1;
+
+    for (uint32_t i = 0; i < windows; ++i) {
+        uint64_t offset = header.data_offset + body * i / windows;
+        uint32_t quota = (samples * (i + 1)) / windows - (samples * i) / windows;
+        window_sum_t w;
+        int has_video = 0;
+        int measured = 0;
+        size_t q = 0;
+
+        p = source_read(src, offset, window_bytes, &len);
+        if (!p)
+            return FLV_ERR_IO;
+        out->windows++;
+        // The very first window starts right at PreviousTagSize0 and
+        // normally holds the first timestamp too
+        if (i == 0) {
+            head = first_timestamp(p, len, &first_ts);
+            first_len = len;
+        }
+        q = resync(p, len, i == 0 ? FLV_PREV_TAG_SIZE_SIZE : 0);
+        has_video = window_has_video(p, len, q);
+        memset(&w, 0, sizeof(w));
+        while (quota-- > 0 && q < len && measure_window(&est, &w, p, len, q, has_video, !measured, &q))
+            measured = 1;
+        window_add(&est, &w);
+        out->synced += measured;
+    }
+
+    sample_range(&est.bitrate, &out->bitrate);
+    sample_range(&est.frame_rate, &out->frame_rate);
+    sample_range(&est.keyframe_interval, &out->keyframe_interval);
+    sample_range(&est.video_share, &out->video_share);
+    out->video_codec = est.video_codec;
+    out->audio_codec = est.audio_codec;
+
+    // A first window shorter than the head probe may have stopped short of
+    // the first tag; the probe reads it again, so it is counted only once
+    if (head != FLV_OK && window_bytes < HEAD_PROBE_BYTES) {
+        src->bytes_read -= first_len;
+        head = probe_head(src, header.data_offset, &first_ts);
+    }
+    if (head == FLV_OK && probe_tail(src, header.data_offset, &last_ts) == FLV_OK && last_ts >= first_ts) {
+        out->exact_duration = 1;
+        out->duration = (last_ts - first_ts) / 1000.0;
+    } else if (out->bitrate.mean > 0) {
+        out->duration = src->size * 8.0 / out->bitrate.mean / 1000.0;
+    }
+    out->bytes_read = src->bytes_read;
+    return FLV_OK;
+}
+
+int flv_estimate_fd(int fd, const flv_estimate_config_t *config, flv_estimate_t *estimate_out) {
+    source_t src;
+    struct stat st;
+    int ret = 0;
+
+    if (fd < 0 || !estimate_out)
+        return FLV_ERR_INVALID_ARG;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+        return FLV_ERR_IO;
+    memset(&src, 0, sizeof(src));
+    src.fd = fd;
+    src.size = (uint64_t) st.st_size;
+    ret = estimate(&src, config, estimate_out);
+    free(src.buf);
+    return ret;
+}
+
+int flv_estimate_memory(const void *data, size_t size, const flv_estimate_config_t *config,
+                        flv_estimate_t *estimate_out) {
+    source_t src;
+
+    if (!data || !estimate_out)
+        return FLV_ERR_INVALID_ARG;
+    memset(&src, 0, sizeof(src));
+    src.mem = (const uint8_t *) data;
+    src.size = size;
+    return estimate(&src, config, estimate_out);
+}
@@ -0,0 +1,71 @@
+#ifndef FLV_ESTIMATE_H_
+#define FLV_ESTIMATE_H_
+
+/*
+ * Sampled estimates for files too large to read. The file is probed at
+ * evenly spaced offsets; at each one the reader resyncs to the next tag
+ * header, measures one GOP (or a window of audio) with the regular tag
+ * decoder, and the per-window figures are extrapolated with confidence
+ * bounds. A small file gets fewer windows that measure several GOPs each;
+ * those are pooled, so every window is one sample. The duration is read
+ * exactly from the first and last tags.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "flv-core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FLV_ESTIMATE_SAMPLES      (16)
+#define FLV_ESTIMATE_WINDOW_BYTES (1 << 20)
+
+typedef struct flv_estimate_config {
+    uint32_t samples;          // Offsets to probe, 0 = FLV_ESTIMATE_SAMPLES
+    size_t window_bytes;       // Bytes read at each offset, 0 = FLV_ESTIMATE_WINDOW_BYTES
+} flv_estimate_config_t;
+
+/*
+ * @brief a sampled value: mean over the windows and its 95% confidence
+ * interval. `count` is the number of windows that measured it; with one
+ * the interval is just the mean.
+ */
+typedef struct flv_estimate_range {
+    double mean;
+    double low;
+    double high;
+    uint32_t count;
+} flv_estimate_range_t;
+
+typedef struct flv_estimate {
+    uint64_t file_size;
+    uint64_t bytes_read;       // Overlapping reads are counted once
+    uint32_t windows;          // Windows probed
+    uint32_t synced;           // Windows where a tag header was found
+    uint8_t type_flags;        // FLV header TypeFlags
+    uint8_t video_codec;       // CodecID seen in the windows, 0xFF if none
+    uint8_t audio_codec;       // SoundFormat seen in the windows, 0xFF if none
+    int exact_duration;        // duration comes from the first and last tags
+    double duration;           // Seconds; extrapolated from the bitrate if not exact
+    flv_estimate_range_t bitrate;            // Kilobits per second, all tags
+    flv_estimate_range_t frame_rate;         // Video frames per second
+    flv_estimate_range_t keyframe_interval;  // Seconds
+    flv_estimate_range_t video_share;        // Fraction of the bytes that is video
+} flv_estimate_t;
+
+/*
+ * @brief estimate the file open on `fd`, which must support pread().
+ * `config` may be NULL.
+ */
+int flv_estimate_fd(int fd, const flv_estimate_config_t *config, flv_estimate_t *estimate);
+
+int flv_estimate_memory(const void *data, size_t size, const flv_estimate_config_t *config,
+                        flv_estimate_t *estimate);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FLV_ESTIMATE_H_
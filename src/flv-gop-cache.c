@@ -0,0 +1,168 @@
+#include <stdlib.h>
+#include <string.h>
+#include "flv-gop-cache.h"
+
+/*
+ * @brief one GOP. Tags are only ever appended, and the array is allocated
+ * at full size up front, so a snapshot can keep reading tags[0..count)
+ * while the cache keeps appending behind it.
+ */
+struct flv_gop {
+    atomic_int refs;
+    size_t count;
+    size_t bytes;
+    flv_tag_buf_t *tags[];
+};
+
+struct flv_gop_cache {
+    flv_gop_cache_config_t config;
+    flv_tag_buf_t *metadata;
+    flv_tag_buf_t *video_config;
+    flv_tag_buf_t *audio_config;
+    flv_gop_t *gop;            // Current GOP, NULL until a keyframe or after overflow
+    int has_video;
+};
+
+static flv_gop_t *gop_new(size_t max_tags) {
+    flv_gop_t *gop = malloc(sizeof(flv_gop_t) + max_tags * sizeof(flv_tag_buf_t *));
+
+    if (!gop)
+        return NULL;
+    atomic_init(&gop->refs, 1);
+    gop->count = 0;
+    gop->bytes = 0;
+    return gop;
+}
+
+static void gop_unref(flv_gop_t *gop) {
+    if (!gop)
+        return;
+    if (atomic_fetch_sub_explicit(&gop->refs, 1, memory_order_acq_rel) == 1) {
+        for (size_t i = 0; i < gop->count; ++i)
+            flv_tag_buf_unref(gop->tags[i]);
+        free(gop);
+    }
+}
+
+static void replace_buf(flv_tag_buf_t **slot, flv_tag_buf_t *buf) {
+    flv_tag_buf_unref(*slot);
+    *slot = flv_tag_buf_ref(buf);
+}
+
+flv_gop_cache_t *flv_gop_cache_create(const flv_gop_cache_config_t *config) {
+    flv_gop_cache_t *cache = calloc(1, sizeof(flv_gop_cache_t));
+
+    if (!cache)
+        return NULL;
+    if (config)
+        cache->config = *config;
+    if (!cache->config.max_bytes)
+        cache->config.max_bytes = FLV_GOP_CACHE_MAX_BYTES;
+    if (!cache->config.max_tags)
+        cache->config.max_tags = FLV_GOP_CACHE_MAX_TAGS;
+    if (!cache->config.max_audio_ms)
+        cache->config.max_audio_ms = FLV_GOP_CACHE_MAX_AUDIO_MS;
+    return cache;
+}
+
+void flv_gop_cache_destroy(flv_gop_cache_t *cache) {
+    if (!cache)
+        return;
+    flv_tag_buf_unref(cache->metadata);
+    flv_tag_buf_unref(cache->video_config);
+    flv_tag_buf_unref(cache->audio_config);
+    gop_unref(cache->gop);
+    free(cache);
+}
+
+int flv_gop_cache_push(flv_gop_cache_t *cache, flv_tag_buf_t *buf) {
+    int sync = 0;
+
+    if (!cache || !buf)
+        return FLV_ERR_INVALID_ARG;
+
+    if (buf->tag_type == TAGTYPE_VIDEODATA)
+        cache->has_video = 1;
+    // Metadata and codec configuration are kept aside, latest wins
+    if (buf->flags & FLV_TAG_BUF_METADATA) {
+        replace_buf(&cache->metadata, buf);
+        return FLV_OK;
+    }
+    if (buf->flags & FLV_TAG_BUF_SEQUENCE_HEADER) {
+        replace_buf(buf->tag_type == TAGTYPE_VIDEODATA ? &cache->video_config : &cache->audio_config, buf);
+        // An audio-only GOP starts over with the new configuration
+        if (buf->tag_type == TAGTYPE_AUDIODATA && !cache->has_video) {
+            gop_unref(cache->gop);
+            cache->gop = NULL;
+        }
+        return FLV_OK;
+    }
+    if (cache->config.disabled)
+        return FLV_OK;
+
+    // Any audio frame can start an audio-only GOP, once the open one (if
+    // any) spans max_audio_ms or the timestamps went backwards
+    if (buf->tag_type == TAGTYPE_VIDEODATA) {
+        sync = (buf->flags & FLV_TAG_BUF_KEYFRAME) != 0;
+    } else if (buf->tag_type == TAGTYPE_AUDIODATA && !cache->has_video) {
+        uint32_t start = cache->gop && cache->gop->count ? cache->gop->tags[0]->timestamp : 0;
+
+        sync = !cache->gop || !cache->gop->count || buf->timestamp < start ||
+               buf->timestamp - start >= cache->config.max_audio_ms;
+    }
+
+    if (sync && cache->gop && atomic_load_explicit(&cache->gop->refs, memory_order_acquire) == 1) {
+        // No snapshot holds the old GOP, recycle it
+        for (size_t i = 0; i < cache->gop->count; ++i)
+            flv_tag_buf_unref(cache->gop->tags[i]);
+        cache->gop->count = 0;
+        cache->gop->bytes = 0;
+    } else if (sync) {
+        gop_unref(cache->gop);
+        cache->gop = gop_new(cache->config.max_tags);
+        if (!cache->gop)
+            return FLV_ERR_NOMEM;
+    }
+    if (!cache->gop)
+        return FLV_OK;
+
+    if (cache->gop->count == cache->config.max_tags ||
+        cache->gop->bytes + buf->size > cache->config.max_bytes) {
+        // Too long to be useful; wait for the next keyframe
+        gop_unref(cache->gop);
+        cache->gop = NULL;
+        return FLV_OK;
+    }
+    cache->gop->tags[cache->gop->count] = flv_tag_buf_ref(buf);
+    cache->gop->bytes += buf->size;
+    cache->gop->count++;
+    return FLV_OK;
+}
+
+int flv_gop_cache_snapshot(flv_gop_cache_t *cache, flv_gop_snapshot_t *snapshot) {
+    if (!cache || !snapshot)
+        return FLV_ERR_INVALID_ARG;
+
+    memset(snapshot, 0, sizeof(*snapshot));
+    snapshot->metadata = flv_tag_buf_ref(cache->metadata);
+    snapshot->video_config = flv_tag_buf_ref(cache->video_config);
+    snapshot->audio_config = flv_tag_buf_ref(cache->audio_config);
+    if (cache->gop) {
+        snapshot->gop = cache->gop;
+        atomic_fetch_add_explicit(&snapshot->gop->refs, 1, memory_order_relaxed);
+        snapshot->tags = snapshot->gop->tags;
+        snapshot->count = snapshot->gop->count;
+        snapshot->bytes = snapshot->gop->bytes;
+    }
+    return FLV_OK;
+}
+
+void flv_gop_snapshot_release(flv_gop_snapshot_t *snapshot) {
+    if (!snapshot)
+        return;
+    flv_tag_buf_unref(snapshot->metadata);
+    flv_tag_buf_unref(snapshot->video_config);
+    flv_tag_buf_unref(snapshot->audio_config);
+    gop_unref(snapshot->gop);
+    memset(snapshot, 0, sizeof(*snapshot));
+}
@@ -0,0 +1,80 @@
+#ifndef FLV_GOP_CACHE_H_
+#define FLV_GOP_CACHE_H_
+
+/*
+ * GOP cache: everything a consumer joining a live stream needs to show the
+ * first frame right away - the latest onMetaData, the AVC/AAC sequence
+ * headers and all tags since the last keyframe. Audio-only streams have no
+ * keyframes; their GOP runs from the sequence header, or the first frame,
+ * for max_audio_ms of stream time and then starts over, so joiners are not
+ * handed (and delayed by) a long stretch of old audio.
+ *
+ * The cache is fed from one thread. Snapshots are taken on that thread in
+ * O(1): they share the cached buffers by reference and stay valid, on any
+ * thread, until released, however the cache moves on.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "flv-tagbuf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FLV_GOP_CACHE_MAX_BYTES (4 << 20)
+#define FLV_GOP_CACHE_MAX_TAGS  (4096)
+#define FLV_GOP_CACHE_MAX_AUDIO_MS (2000)
+
+typedef struct flv_gop_cache_config {
+    size_t max_bytes;          // Largest GOP kept, 0 = FLV_GOP_CACHE_MAX_BYTES
+    size_t max_tags;           // Most tags in a GOP, 0 = FLV_GOP_CACHE_MAX_TAGS
+    int disabled;              // Keep metadata and sequence headers only, never a GOP
+    uint32_t max_audio_ms;     // Longest audio-only GOP, 0 = FLV_GOP_CACHE_MAX_AUDIO_MS
+} flv_gop_cache_config_t;
+
+typedef struct flv_gop flv_gop_t;
+
+typedef struct flv_gop_cache flv_gop_cache_t;
+
+/*
+ * @brief a consumer's view of the cache. Send metadata, video_config and
+ * audio_config (each may be NULL), then tags[0..count), which start with
+ * a keyframe.
+ */
+typedef struct flv_gop_snapshot {
+    flv_tag_buf_t *metadata;
+    flv_tag_buf_t *video_config;
+    flv_tag_buf_t *audio_config;
+    flv_tag_buf_t *const *tags;
+    size_t count;
+    size_t bytes;              // Total size of tags[0..count)
+    flv_gop_t *gop;            // Keeps tags alive, private
+} flv_gop_snapshot_t;
+
+/*
+ * @brief `config` may be NULL. Returns NULL if out of memory.
+ */
+flv_gop_cache_t *flv_gop_cache_create(const flv_gop_cache_config_t *config);
+
+void flv_gop_cache_destroy(flv_gop_cache_t *cache);
+
+/*
+ * @brief feed the next tag of the stream. The cache takes its own
+ * reference. A GOP that outgrows the limits is dropped until the next
+ * keyframe, so memory stays bounded.
+ */
+int flv_gop_cache_push(flv_gop_cache_t *cache, flv_tag_buf_t *buf);
+
+/*
+ * @brief take a snapshot; release it with flv_gop_snapshot_release
+ */
+int flv_gop_cache_snapshot(flv_gop_cache_t *cache, flv_gop_snapshot_t *snapshot);
+
+void flv_gop_snapshot_release(flv_gop_snapshot_t *snapshot);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FLV_GOP_CACHE_H_
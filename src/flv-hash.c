@@ -0,0 +1,169 @@
+#include <string.h>
+#include "flv-hash.h"
+
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+// Input words are little-endian whatever the host is
+static inline uint64_t read64(const uint8_t *p) {
+    uint64_t v;
+
+    memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+static inline uint32_t read32(const uint8_t *p) {
+    uint32_t v;
+
+    memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+}
+
+static inline uint64_t round64(uint64_t acc, uint64_t input) {
+    acc += input * PRIME64_2;
+    acc = rotl64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+static inline uint64_t merge_round64(uint64_t acc, uint64_t val) {
+    acc ^= round64(0, val);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+/*
+ * @brief consume 32-byte stripes; the four lanes are independent, which
+ * lets the CPU overlap them
+ */
+static const uint8_t *consume_stripes(uint64_t v[4], const uint8_t *p, const uint8_t *limit) {
+    uint64_t v1 = v[0], v2 = v[1], v3 = v[2], v4 = v[3];
+
+    do {
+        v1 = round64(v1, read64(p));
+        v2 = round64(v2, read64(p + 8));
+        v3 = round64(v3, read64(p + 16));
+        v4 = round64(v4, read64(p + 24));
+        p += 32;
+    } while (p <= limit);
+    v[0] = v1;
+    v[1] = v2;
+    v[2] = v3;
+    v[3] = v4;
+    return p;
+}
+
+static uint64_t finalize64(uint64_t h, const uint8_t *p, size_t len) {
+    while (len >= 8) {
+        h ^= round64(0, read64(p));
+        h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+        p += 8;
+        len -= 8;
+    }
+    if (len >= 4) {
+        h ^= (uint64_t) read32(p) * PRIME64_1;
+        h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+        len -= 4;
+    }
+    while (len > 0) {
+        h ^= (*p) * PRIME64_5;
+        h = rotl64(h, 11) * PRIME64_1;
+        p++;
+        len--;
+    }
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+static uint64_t merge_lanes(const uint64_t v[4]) {
+    uint64_t h = rotl64(v[0], 1) + rotl64(v[1], 7) + rotl64(v[2], 12) + rotl64(v[3], 18);
+
+    h = merge_round64(h, v[0]);
+    h = merge_round64(h, v[1]);
+    h = merge_round64(h, v[2]);
+    h = merge_round64(h, v[3]);
+    return h;
+}
+
+static void init_lanes(uint64_t v[4], uint64_t seed) {
+    v[0] = seed + PRIME64_1 + PRIME64_2;
+    v[1] = seed + PRIME64_2;
+    v[2] = seed;
+    v[3] = seed - PRIME64_1;
+}
+
+uint64_t flv_hash64(const void *data, size_t len, uint64_t seed) {
+    const uint8_t *p = (const uint8_t *) data;
+    uint64_t h = 0;
+
+    if (len >= 32) {
+        uint64_t v[4];
+
+        init_lanes(v, seed);
+        p = consume_stripes(v, p, p + len - 32);
+        h = merge_lanes(v);
+    } else {
+        h = seed + PRIME64_5;
+    }
+    h += (uint64_t) len;
+    return finalize64(h, p, len & 31);
+}
+
+void flv_hash64_reset(flv_hash64_state_t *state, uint64_t seed) {
+    memset(state, 0, sizeof(*state));
+    state->seed = seed;
+    init_lanes(state->v, seed);
+}
+
+void flv_hash64_update(flv_hash64_state_t *state, const void *data, size_t len) {
+    const uint8_t *p = (const uint8_t *) data;
+    const uint8_t *end = p + len;
+
+    state->total_len += len;
+    if (state->mem_size + len < 32) {
+        memcpy(state->mem + state->mem_size, p, len);
+        state->mem_size += (uint32_t) len;
+        return;
+    }
+    if (state->mem_size > 0) {
+        size_t fill = 32 - state->mem_size;
+
+        memcpy(state->mem + state->mem_size, p, fill);
+        consume_stripes(state->v, state->mem, state->mem);
+        p += fill;
+        state->mem_size = 0;
+    }
+    if (end - p >= 32)
+        p = consume_stripes(state->v, p, end - 32);
+    if (p < end) {
+        memcpy(state->mem, p, (size_t) (end - p));
+        state->mem_size = (uint32_t) (end - p);
+    }
+}
+
+uint64_t flv_hash64_digest(const flv_hash64_state_t *state) {
+    uint64_t h = 0;
+
+    if (state->total_len >= 32)
+        h = merge_lanes(state->v);
+    else
+        h = state->seed + PRIME64_5;
+    h += state->total_len;
+    return finalize64(h, state->mem, state->mem_size);
+}
@@ -0,0 +1,37 @@
+#ifndef FLV_HASH_H_
+#define FLV_HASH_H_
+
+/*
+ * 64-bit non-cryptographic hashing (XXH64 algorithm, compatible with the
+ * reference xxHash output). Used to fingerprint tag payloads for dedup and
+ * integrity checks.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct flv_hash64_state {
+    uint64_t total_len;
+    uint64_t v[4];
+    uint8_t mem[32];           // Input not yet consumed by a full stripe
+    uint32_t mem_size;
+    uint64_t seed;
+} flv_hash64_state_t;
+
+uint64_t flv_hash64(const void *data, size_t len, uint64_t seed);
+
+void flv_hash64_reset(flv_hash64_state_t *state, uint64_t seed);
+
+void flv_hash64_update(flv_hash64_state_t *state, const void *data, size_t len);
+
+uint64_t flv_hash64_digest(const flv_hash64_state_t *state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FLV_HASH_H_
@@ -0,0 +1,167 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "flv-index.h"
+
+// PreviousTagSize, tag header and the audio/video tag headers
+#define PROBE_SIZE (FLV_PREV_TAG_SIZE_SIZE + FLV_TAG_HEADER_SIZE + 5)
+
+typedef struct index_reader {
+    int fd;
+    uint64_t size;
+    uint8_t *window;
+    uint64_t window_pos;
+    size_t window_len;
+} index_reader_t;
+
+/*
+ * @brief up to `len` bytes at `pos`, *got of them; NULL on a read error
+ */
+static const uint8_t *fetch(index_reader_t *r, uint64_t pos, size_t len, size_t *got) {
+    size_t done = 0;
+
+    if (len > r->size - pos)
+        len = (size_t) (r->size - pos);
+    *got = len;
+    if (pos >= r->window_pos && pos + len <= r->window_pos + r->window_len)
+        return r->window + (pos - r->window_pos);
+
+    r->window_pos = pos;
+    r->window_len = 0;
+    while (done < len) {
+        ssize_t count = pread(r->fd, r->window + done, FLV_INDEX_WINDOW - done, (off_t) (pos + done));
+
+        if (count <= 0)
+            return NULL;
+        done += (size_t) count;
+    }
+    r->window_len = done;
+    return r->window;
+}
+
+static int index_append(flv_index_t *index, const flv_index_entry_t *entry) {
+    if (index->count == index->capacity) {
+        size_t capacity = index->capacity ? index->capacity * 2 : 1024;
+        flv_index_entry_t *entries = realloc(index->entries, capacity * sizeof(*entries));
+
+        if (!entries)
+            return FLV_ERR_NOMEM;
+        index->entries = entries;
+        index->capacity = capacity;
+    }
+    index->entries[index->count++] = *entry;
+    return FLV_OK;
+}
+
+int flv_index_build(flv_index_t *index, int fd) {
+    index_reader_t r;
+    struct stat st;
+    const uint8_t *p = NULL;
+    uint64_t pos = 0;
+    size_t got = 0;
+    int ret = 0;
+
+    if (!index || fd < 0)
+        return FLV_ERR_INVALID_ARG;
+    memset(index, 0, sizeof(*index));
+    if (fstat(fd, &st) != 0)
+        return FLV_ERR_IO;
+    memset(&r, 0, sizeof(r));
+    r.fd = fd;
+    r.size = (uint64_t) st.st_size;
+    index->file_size = r.size;
+    r.window = malloc(FLV_INDEX_WINDOW);
+    if (!r.window)
+        return FLV_ERR_NOMEM;
+
+    p = fetch(&r, 0, FLV_HEADER_SIZE, &got);
+    if (!p) {
+        ret = FLV_ERR_IO;
+        goto done;
+    }
+    ret = flv_decode_header(p, got, &index->header);
+    if (ret != FLV_OK)
+        goto done;
+    pos = index->header.data_offset;
+    index->end = pos + FLV_PREV_TAG_SIZE_SIZE;
+    if (index->end > r.size) {
+        index->status = FLV_ERR_TRUNCATED;
+        index->end = r.size;
+        goto done;
+    }
+
+    for (; ;) {
+        flv_index_entry_t entry;
+        flv_tag_info_t tag;
+
+        // The PreviousTagSize in front belongs to the tag before
+        p = fetch(&r, pos, PROBE_SIZE, &got);
+        if (!p) {
+            ret = FLV_ERR_IO;
+            goto done;
+        }
+        if (got < FLV_PREV_TAG_SIZE_SIZE) {
+            index->status = FLV_ERR_TRUNCATED;
+            break;
+        }
+        if (index->count > 0)
+            index->entries[index->count - 1].prev_tag_size = flv_get_ui32(p);
+        index->end = pos + FLV_PREV_TAG_SIZE_SIZE;
+        if (got == FLV_PREV_TAG_SIZE_SIZE && pos + got == r.size)
+            break;
+        if (flv_decode_tag_header(p + FLV_PREV_TAG_SIZE_SIZE, got - FLV_PREV_TAG_SIZE_SIZE, &tag) != FLV_OK ||
+            r.size - pos - FLV_PREV_TAG_SIZE_SIZE < FLV_TAG_HEADER_SIZE + (uint64_t) tag.data_size +
+                                                   FLV_PREV_TAG_SIZE_SIZE) {
+            index->status = FLV_ERR_TRUNCATED;
+            break;
+        }
+
+        // Only the audio/video tag headers are decoded, from the probe
+        memset(&entry, 0, sizeof(entry));
+        entry.offset = pos + FLV_PREV_TAG_SIZE_SIZE;
+        entry.data_size = tag.data_size;
+        entry.timestamp = flv_tag_timestamp(&tag);
+        entry.tag_type = tag.tag_type;
+        if (tag.data_size > 0 && got > FLV_PREV_TAG_SIZE_SIZE + FLV_TAG_HEADER_SIZE) {
+            const uint8_t *body = p + FLV_PREV_TAG_SIZE_SIZE + FLV_TAG_HEADER_SIZE;
+            size_t avail = got - FLV_PREV_TAG_SIZE_SIZE - FLV_TAG_HEADER_SIZE;
+
+            if (tag.tag_type == TAGTYPE_VIDEODATA) {
+                entry.codec = body[0] & 0x0F;
+                if ((body[0] >> 4) == FLV_FRAME_TYPE_KEY)
+                    entry.flags |= FLV_INDEX_KEYFRAME;
+                if (entry.codec == FLV_CODEC_ID_AVC && avail > 1 && body[1] != FLV_AVC_NALU) {
+                    entry.flags &= ~FLV_INDEX_KEYFRAME;
+                    if (body[1] == FLV_AVC_SEQUENCE_HEADER)
+                        entry.flags |= FLV_INDEX_SEQUENCE_HEADER;
+                }
+            } else if (tag.tag_type == TAGTYPE_AUDIODATA) {
+                entry.codec = body[0] >> 4;
+                if (entry.codec == FLV_SOUND_FORMAT_AAC && avail > 1 && body[1] == FLV_AAC_SEQUENCE_HEADER)
+                    entry.flags |= FLV_INDEX_SEQUENCE_HEADER;
+            }
+        }
+        if (tag.tag_type == TAGTYPE_SCRIPTDATAOBJECT)
+            entry.flags |= FLV_INDEX_METADATA;
+        ret = index_append(index, &entry);
+        if (ret != FLV_OK)
+            goto done;
+        pos = entry.offset + FLV_TAG_HEADER_SIZE + tag.data_size;
+    }
+
+done:
+    free(r.window);
+    if (ret != FLV_OK)
+        flv_index_destroy(index);
+    return ret;
+}
+
+void flv_index_destroy(flv_index_t *index) {
+    if (!index)
+        return;
+    free(index->entries);
+    index->entries = NULL;
+    index->count = 0;
+    index->capacity = 0;
+}
@@ -0,0 +1,66 @@
+#ifndef FLV_INDEX_H_
+#define FLV_INDEX_H_
+
+/*
+ * Tag index of a file: offset, size, timestamp and kind of every tag,
+ * built by reading only the tag headers and the first bytes of each body.
+ * Editing tools work from the index and move the bodies kernel-side.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "flv-core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FLV_INDEX_KEYFRAME         (1 << 0)  // Video keyframe (not an AVC sequence header)
+#define FLV_INDEX_SEQUENCE_HEADER  (1 << 1)  // AVC or AAC sequence header
+#define FLV_INDEX_METADATA         (1 << 2)  // Script data tag
+
+// Read size while indexing; consecutive small tags share one read
+#define FLV_INDEX_WINDOW (64 << 10)
+
+typedef struct flv_index_entry {
+    uint64_t offset;           // Offset of the 11-byte tag header
+    uint32_t data_size;
+    uint32_t timestamp;        // Full 32-bit timestamp
+    uint32_t prev_tag_size;    // The PreviousTagSize stored right after this tag
+    uint8_t tag_type;
+    uint8_t flags;             // FLV_INDEX_*
+    uint8_t codec;             // CodecID for video, SoundFormat for audio
+    uint8_t reserved;
+} flv_index_entry_t;
+
+typedef struct flv_index {
+    flv_header_t header;
+    flv_index_entry_t *entries;
+    size_t count;
+    size_t capacity;
+    uint64_t file_size;
+    uint64_t end;              // End of the last complete tag and its PreviousTagSize
+    int status;                // FLV_OK, or FLV_ERR_TRUNCATED if the file ends inside a tag
+} flv_index_t;
+
+/*
+ * @brief index the file open on `fd` (read with pread, the file position
+ * is left alone). A truncated tail is not an error: the index covers the
+ * complete tags and index->status tells.
+ */
+int flv_index_build(flv_index_t *index, int fd);
+
+void flv_index_destroy(flv_index_t *index);
+
+/*
+ * @brief size of a tag together with its trailing PreviousTagSize
+ */
+static inline uint64_t flv_index_record_size(const flv_index_entry_t *entry) {
+    return FLV_TAG_HEADER_SIZE + (uint64_t) entry->data_size + FLV_PREV_TAG_SIZE_SIZE;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FLV_INDEX_H_
@@ -1,12 +1,13 @@
 #include <stdlib.h>
 #include <string.h>
-#include <assert.h>
-#include <arpa/inet.h>
+#include "flv-audio.h"
+#include "flv-cache.h"
+#include "flv-digest.h"
+#include "flv-estimate.h"
 #include "flv-parser.h"
+#include "flv-pipeline.h"
 
 // File-scope ("global") variables
-const char *flv_signature = "FLV";
-
 const char *sound_formats[] = {
         "Linear PCM, platform endian",
         "ADPCM",
@@ -93,32 +94,21 @@ const char *postfix[] = {
     "pixels",
     "bytes"
 };
-union ieee_754_double {
-    double data;
-    uint8_t b[8];
-};
+static flv_reader_t g_reader;
 static FILE *g_infile;
-static uint32_t tag_count;
-void die(void) {
-    printf("Error!\n");
-    exit(-1);
-}
+
+#define TABLE_SIZE(table) (sizeof(table) / sizeof((table)[0]))
 
 /*
- * @brief read bits from 1 byte
- * @param[in] value: 1 byte to analysize
- * @param[in] start_bit: start from the low bit side
- * @param[in] count: number of bits
+ * @brief look up a name table, tolerating values the standard does not define
  */
-uint8_t flv_get_bits(uint8_t value, uint8_t start_bit, uint8_t count) {
-    uint8_t mask = 0;
-
-    mask = (uint8_t) (((1 << count) - 1) << start_bit);
-    return (mask & value) >> start_bit;
-
+static const char *table_name(const char **table, size_t count, unsigned int index) {
+    if (index >= count)
+        return "not defined by standard";
+    return table[index];
 }
 
-void flv_print_header(flv_header_t *flv_header) {
+void flv_print_header(const flv_header_t *flv_header) {
     if (!flv_header)
     {
         printf("line: %d, the parameter flv_header is NULL!", __LINE__);
@@ -141,649 +131,482 @@ void flv_print_header(flv_header_t *flv_header) {
     }
     printf("  Data offset: %lu\n", (unsigned long) flv_header->data_offset);
 }
-size_t check_read_error(int line_num, const char * func_name, int count, int read_bytes)
-{
-    if (!feof(g_infile) && count != read_bytes)
-    {
-        printf("line: %d, read error in function %s", line_num, func_name);
-        return 1; // Some Error
-    }
-    return 0;     // OK
-}
-size_t fread_1(uint8_t *ptr) {
-    assert(NULL != ptr);
-    size_t count = 0;
-    count = fread(ptr, 1, 1, g_infile);
-    if (!check_read_error(__LINE__, __FUNCTION__, count, 1))
-       return count * 1;
-    else
-       exit(1);
-}
-void fread_2(uint16_t *ptr) {
-    assert(NULL != ptr);
-    size_t count = 0;
-    uint8_t bytes[2] = {0};
-    *ptr = 0;
-    count = fread(bytes, 2, 1, g_infile);
-    if(!check_read_error(__LINE__, __FUNCTION__, count, 1)) 
-        *ptr = ((bytes[0] << 8) | bytes[1]);
-    else
-        exit(1);
-}
-void fread_3(uint32_t *ptr) {
-    assert(NULL != ptr);
-    size_t count = 0;
-    uint8_t bytes[3] = {0};
-    *ptr = 0;
-    count = fread(bytes, 3, 1, g_infile);
-    if(!check_read_error(__LINE__, __FUNCTION__, count, 1)) 
-        *ptr = (bytes[0] << 16) | (bytes[1] << 8) | bytes[2];
-    else
-        exit(1);
-}
 
-void fread_4(uint32_t *ptr) {
-    assert(NULL != ptr);
-    size_t count = 0;
-    uint8_t bytes[4] = {0};
-    *ptr = 0;
-    count = fread(bytes, 4, 1, g_infile);
-    if(!check_read_error(__LINE__, __FUNCTION__, count, 1)) 
-    {
-        // BIG-ENDIAN
-        *ptr = (bytes[0] << 24) | (bytes[1] << 16) | (bytes[2] << 8) | bytes[3];
-    }
-    else
-       exit(1);
+void print_general_tag_info(const flv_tag_info_t *tag) {
+    printf("  Data size: %lu\n", (unsigned long) tag->data_size);
+    printf("  Timestamp: %lu\n", (unsigned long) tag->timestamp);
+    printf("  Timestamp extended: %u\n", tag->timestamp_ext);
+    printf("  StreamID: %lu\n", (unsigned long) tag->stream_id);
 }
 
-void fread_double(double *ptr) {
-    assert(NULL != ptr);
-    size_t count = 0;
-    uint8_t bytes[8] = {0};
-    *ptr = 0.0;
-    count = fread(bytes, 8, 1, g_infile);
-    // IEEE-754 DOUBLE 8-byte, BIG-ENDIAN,the sign bit is at the low memeory
-    //         bit[63]  bit[53]-bit[62]         bit[0]-bit[52]
-    // data =(sign bit) * (weishu)         *      2^(jiema) 
-    if(!check_read_error(__LINE__, __FUNCTION__, count, 1))
-    {
-        union ieee_754_double read_data;
-        for (int i = 0; i < 8; ++i)
-    	    read_data.b[7 - i] = bytes[i];
-        *ptr = read_data.data;
-    }
-    else
-        exit(1);
-}
-void init_audio_tag(audio_tag_t * tag)
-{
-    assert(tag != NULL);
-    tag->sound_format = 0;
-    tag->sound_rate = 0;
-    tag->sound_size = 0;
-    tag->sound_type = 0;
-    tag->data = NULL;
-}
 /*
- * @brief read audio tag
+ * @brief print audio tag
  */
-audio_tag_t *read_audio_tag(flv_tag_t *flv_tag) {
-    assert(NULL != flv_tag);
-    uint8_t byte = 0;
-    audio_tag_t *tag = NULL;
-
-    tag = malloc(sizeof(audio_tag_t));
-    if (!tag)
-    {
-        printf("line: %d, the parameter flv_tag is NULL!", __LINE__);
-        return NULL;
-    }
-    init_audio_tag(tag);
-    fread_1(&byte);
-
-    tag->sound_format = flv_get_bits(byte, 4, 4);    // UB[4]
-    tag->sound_rate = flv_get_bits(byte, 2, 2);      // UB[2]
-    tag->sound_size = flv_get_bits(byte, 1, 1);      // UB[1]
-    tag->sound_type = flv_get_bits(byte, 0, 1);      // UB[1], total 1 byte.
-
+void print_audio_tag(const flv_tag_info_t *tag) {
     printf("  Audio tag:\n");
     printf("    SoundFormat: %u - %s\n", tag->sound_format, sound_formats[tag->sound_format]);
     printf("    SoundRate: %u - %s\n", tag->sound_rate, sound_rates[tag->sound_rate]);
 
     printf("    SoundSize: %u - %s\n", tag->sound_size, sound_sizes[tag->sound_size]);
     printf("    SoundType: %u - %s\n", tag->sound_type, sound_types[tag->sound_type]);
-    
-    byte = 0;
-    if (tag->sound_format != 10)
-    {
-        // -1 because the first byte in the AudioTagHeader
-        tag->data = malloc((size_t) flv_tag->data_size - 1);
-        size_t count = 0;
-        count  = fread(tag->data, 1, (size_t) flv_tag->data_size - 1, g_infile); 
-        if(!check_read_error(__LINE__, __FUNCTION__, count, flv_tag->data_size - 1))
-        {
-            return tag;
-        }
-        else
-        {
-            free(tag->data);
-            free(tag);
-            return NULL;
-        }
-     }
-     // AAC Encoding
-     else 
-     {
-        fread_1(&byte); 
+
+    // AAC Encoding
+    if (tag->sound_format == FLV_SOUND_FORMAT_AAC) {
         // 0 = AAC sequence header
-        // 1 = AAC raw   
-        printf("    AACPacketType: %u - %s\n", byte, (byte == 0?"AAC sequence header":"AAC raw"));
-        tag->data = malloc((size_t) flv_tag->data_size - 2);
-        size_t count = 0;
-        count  = fread(tag->data, 1, (size_t) flv_tag->data_size - 2, g_infile); 
-        if(!check_read_error(__LINE__, __FUNCTION__, count, flv_tag->data_size - 2))
-        {
-            return tag;
-        }
-        else
-        {
-            free(tag->data);
-            free(tag);
-            return NULL;
-        } 
-        
-     }
-}
-void init_video_tag(video_tag_t * tag)
-{
-    assert(tag != NULL);
-    tag->frame_type = 0;
-    tag->codec_id = 0;
-    tag->data = NULL;
+        // 1 = AAC raw
+        printf("    AACPacketType: %u - %s\n", tag->aac_packet_type,
+               (tag->aac_packet_type == FLV_AAC_SEQUENCE_HEADER ? "AAC sequence header" : "AAC raw"));
+    }
 }
+
 /*
- * @brief read video tag
+ * @brief print video tag
  */
-video_tag_t *read_video_tag(flv_tag_t *flv_tag) {
-    assert(flv_tag != NULL);
-    uint8_t byte = 0;
-    video_tag_t *tag = NULL;
-
-    tag = malloc(sizeof(video_tag_t));
-    if (tag == NULL)
-    {
-        printf("line: %d, malloc error in function %s\n", __LINE__, __FUNCTION__);
-        return NULL;
-    }
-
-    init_video_tag(tag);
-
-    fread_1(&byte);
-
-    tag->frame_type = flv_get_bits(byte, 4, 4);
-    tag->codec_id = flv_get_bits(byte, 0, 4);
-
+void print_video_tag(const flv_tag_info_t *tag) {
     printf("  Video tag:\n");
-    printf("    Frame type: %u - %s\n", tag->frame_type, frame_types[tag->frame_type]);
-    printf("    Codec ID: %u - %s\n", tag->codec_id, codec_ids[tag->codec_id]);
-    
-    // Video frame payload 
-    // IF CodecID == 2 
-    //      H263VIDEOPACKET
-    // IF CodecID == 3
-    //      SCREENVIDEOPACKET
-    // IF CodecID == 4
-    //      VP6FLVVIDEOPACKET
-    // IF CodecID == 5
-    //      VP6FLVALPHAVIDEOPACKET
-    // IF CodecID == 6
-    //      SCREENV2VIDEOPACKET
-    // IF CodecID == 7
-    //      AVCVIDEOPACKET
-    if (tag->frame_type != 5)
-    {
-        // AVCVIDEOPACKET
-        if (tag->codec_id == FLV_CODEC_ID_AVC) {
-            tag->data = read_avc_video_tag(tag, flv_tag, (uint32_t) (flv_tag->data_size - 1));
-        }
-        // Other Packets, TO_DO
+    printf("    Frame type: %u - %s\n", tag->frame_type,
+           table_name(frame_types, TABLE_SIZE(frame_types), tag->frame_type));
+    printf("    Codec ID: %u - %s\n", tag->codec_id,
+           table_name(codec_ids, TABLE_SIZE(codec_ids), tag->codec_id));
+
+    // frame info
+    if (tag->frame_type == FLV_FRAME_TYPE_COMMAND) {
+        if (tag->command == 0)
+            printf("     Start of client-side seeking video frame sequence.\n");
         else
-        {
-            tag->data = malloc((size_t) flv_tag->data_size - 1);
-            size_t count = 0;
-            count = fread(tag->data, 1, (size_t) flv_tag->data_size - 1, g_infile);
-            if(check_read_error(__LINE__, __FUNCTION__, count, flv_tag->data_size - 1))
-            {
-                free(tag->data);
-                free(tag);
-                return NULL; 
-            }
-            switch(tag->codec_id) 
-            {
-                case FLV_CODEC_ID_H263:
-                    printf("    H263VIDEOPACKET\n");
-                    break;
-                case FLV_CODEC_ID_SCREEN:
-                    printf("    SCREENVIDEOPACKET\n");
-                    break;
-                case FLV_CODEC_ID_VP6:
-                    printf("    VP6VIDEOPACKET\n");
-                    break;
-                case FLV_CODEC_ID_VP6_ALPHA:
-                    printf("    VP6ALPHAPACKET\n"); 
-                    break;
-                case FLV_CODEC_ID_SCREEN_V2:
-                    printf("    SCREENV2PACKET\n");
-                    break;
-                default:
-                    break;
-            }
-        }     
+            printf("     End of client-side seeking video frame sequence.\n");
+        return;
     }
-    // frame info
-    else
+    // Video frame payload
+    switch (tag->codec_id)
     {
-        byte = 0;
-        fread_1(&byte);
-        if (byte == 0)
-            printf("     Start of client-side seeking video frame sequence.\n");   
-        else
-            printf("     End of client-side seeking video frame sequence.\n"); 
-        tag->data = NULL;
-    } 
-    
-    return tag;
+        case FLV_CODEC_ID_H263:
+            printf("    H263VIDEOPACKET\n");
+            break;
+        case FLV_CODEC_ID_SCREEN:
+            printf("    SCREENVIDEOPACKET\n");
+            break;
+        case FLV_CODEC_ID_VP6:
+            printf("    VP6VIDEOPACKET\n");
+            break;
+        case FLV_CODEC_ID_VP6_ALPHA:
+            printf("    VP6ALPHAPACKET\n");
+            break;
+        case FLV_CODEC_ID_SCREEN_V2:
+            printf("    SCREENV2PACKET\n");
+            break;
+        case FLV_CODEC_ID_AVC:
+            print_avc_video_tag(tag);
+            break;
+        default:
+            break;
+    }
 }
 
-void init_avc_video_tag(avc_video_tag_t * tag)
-{
-    assert(tag != NULL);
-    tag->avc_packet_type = 0;
-    tag->composition_time = 0;
-    tag->nalu_len = 0;
-    tag->data = NULL; 
-}
 /*
- * @brief read AVC video tag
+ * @brief print AVC video tag
  */
-avc_video_tag_t *read_avc_video_tag(video_tag_t *video_tag, flv_tag_t *flv_tag, uint32_t data_size) {
-    avc_video_tag_t *tag = NULL;
-
-    tag = malloc(sizeof(avc_video_tag_t));
-    if (tag == NULL)
-    {
-        printf("line: %d, malloc error in function %s\n", __LINE__, __FUNCTION__);
-        return NULL;
-    } 
-
-    init_avc_video_tag(tag);
-
-    // AVCPacketType:UI8
-    fread_1(&(tag->avc_packet_type));
-    // CompositionTime:SI24
-    fread_3(&(tag->composition_time));
-
-    // if AVCPacketType == 1, one or more NALUS
-    // 0x17|01|00 00 00|xx xx xx xx|
-    if (tag->avc_packet_type == 1) 
-    {
-        // 4-byte, the actual length of the raw data(NALU)
-        fread_4(&(tag->nalu_len));
-    }
-
+void print_avc_video_tag(const flv_tag_info_t *tag) {
     printf("    AVC video tag:\n");
-    printf("      AVC packet type: %u - %s\n", tag->avc_packet_type, avc_packet_types[tag->avc_packet_type]);
+    printf("      AVC packet type: %u - %s\n", tag->avc_packet_type,
+           table_name(avc_packet_types, TABLE_SIZE(avc_packet_types), tag->avc_packet_type));
     printf("      AVC composition time: %i\n", tag->composition_time);
     // 0 = AVC sequence header
     // 1 = AVC NALU
     // 2 = AVC end of sequence (lower level NALU sequence ender is not required or supported)
-    if (tag->avc_packet_type == 1)
-    {
-        printf("      AVC nalu length: %i\n", tag->nalu_len);
-        tag->data = malloc((size_t) data_size - 1 - 3 - 4);
-        if (tag->data == NULL)
-        {
-           printf("line: %d, malloc error in function %s\n", __LINE__, __FUNCTION__);
-           free(tag);
-           return NULL; 
-        }
-        size_t count = 0;
-        count = fread(tag->data, 1, (size_t) data_size - 1 - 3 - 4, g_infile);
-        if(check_read_error(__LINE__, __FUNCTION__, count, data_size - 8))
-        {
-            free(tag->data);
-            free(tag);
-            return NULL;
-        }
-    }
-    else
-    {
-        tag->data = malloc((size_t) data_size - 1 - 3);
-        size_t count = 0;
-        count = fread(tag->data, 1, (size_t) data_size - 1 - 3, g_infile);
-        if(check_read_error(__LINE__, __FUNCTION__, count, data_size - 4))
-        {
-            free(tag->data);
-            free(tag);
-            return NULL;
-        }
-    }
-    return tag;
+    if (tag->avc_packet_type == FLV_AVC_NALU)
+        printf("      AVC nalu length: %u\n", tag->nalu_len);
 }
+
 const char * check_property_name(const char *name)
 {
-    assert( NULL != name);
-    if(strncmp(metadata_properties[1], name, strlen(name)) == 0 || 
-       strncmp(metadata_properties[13], name, strlen(name)) ==0 ) 
+    if (name == NULL)
+       return NULL;
+    if(strcmp(metadata_properties[1], name) == 0 ||
+       strcmp(metadata_properties[13], name) == 0)
        return postfix[0];
-    if(strncmp(metadata_properties[2], name, strlen(name)) == 0 || 
-       strncmp(metadata_properties[7], name, strlen(name)) ==0 ) 
+    if(strcmp(metadata_properties[2], name) == 0 ||
+       strcmp(metadata_properties[7], name) == 0)
        return postfix[1];
-    if(strncmp(metadata_properties[3], name, strlen(name)) == 0) 
+    if(strcmp(metadata_properties[3], name) == 0)
        return postfix[2];
-    if(strncmp(metadata_properties[9], name, strlen(name)) == 0) 
+    if(strcmp(metadata_properties[9], name) == 0)
        return postfix[3];
-    if(strncmp(metadata_properties[10], name, strlen(name)) == 0 || 
-       strncmp(metadata_properties[14], name, strlen(name)) ==0 ) 
+    if(strcmp(metadata_properties[10], name) == 0 ||
+       strcmp(metadata_properties[14], name) == 0)
        return postfix[4];
-     if(strncmp(metadata_properties[8], name, strlen(name)) == 0) 
+    if(strcmp(metadata_properties[8], name) == 0)
        return postfix[5];
-     return NULL; 
+    return NULL;
 }
-void read_scriptdata_tag(void)
-{
-    // type: 0x02, length: 0x000A, "onMetaData"
-    uint8_t type = 0;
-    fread_1(&type);
-    // length, because the byte order is BIG-ENDIAN
-    // We should read the byte one by one
-    uint16_t length;
-    fread_2(&length);
-    // "onMetaData"
-    uint8_t name[10];
-    size_t count = 0;
-    count = fread(name, 1, 10, g_infile); 
-    if (!feof(g_infile) && count != 10)
-    {
-        printf("line: %d, read error in function %s", __LINE__, __FUNCTION__);
-        return; 
-    }
-    // Type:ScriptDataECMAArray, type: 0x08 
-    fread_1(&type);
-    // ECMAArrayLength(UI32):0x0000000C
-    uint32_t ecma_array_length = 0;
-    fread_4(&ecma_array_length);
-    
-    // Read the property one by one
-    // ScriptDataObjectProperty: PropertyName(ScriptDataString), PropertyData(ScriptDataValue)
-    for (int i = 0; i < ecma_array_length; ++i)
+
+static int print_script_property(void *opaque, const char *name, size_t name_len,
+                                 const flv_amf_value_t *value) {
+    (void) opaque;
+    // Consider the end identifier '\0'
+    char *property_name = malloc(name_len + 1);
+
+    if (property_name == NULL)
     {
-        length = 0;
-        fread_2(&length); // Length of PropertyName
-        
-        // For Debug
-        // printf("the length of propertyname is: %d\n", length);
-        char *property_name = NULL;
-        // Consider the end identifier '\0'
-        property_name = malloc(length + 1);
-        
-        if(property_name == NULL)
-        {
-            printf("line: %d, malloc error in function %s\n", __LINE__, __FUNCTION__);
-            return;
-        }
-        // MUST Initialize the memory
-        memset(property_name, 0, length + 1);
-
-        fread(property_name, 1, length, g_infile);
-        fread_1(&type);  // Type of PropertyData
-        switch (type) {
-            // Number: DOUBLE 8-byte
-            case AMF_TYPE_NUMBER:
-                {
-                    double data1 = 0.0;
-                    fread_double(&data1);
-                    if (check_property_name(property_name) != NULL)
-                         printf("    Property: %s - value: %.12g %s\n", property_name, data1, check_property_name(property_name));
-                    else
-                         printf("    Property: %s - value: %.12g\n", property_name, data1);
-                }
-               break;
-            // Boolean: UI8
-            case AMF_TYPE_BOOLEAN:
-                {
-                    uint8_t value = 0;
-                    fread_1(&value);
-                    printf("    Property: %s - value: %u\n", property_name, value);
-                }
-               break;
-            // ScriptDataString 
-            case AMF_TYPE_STRING:
-                {
-                    // get the length of ScriptDataString
-                    fread_2(&length);
-                    char *property_data_str = NULL;
-                    property_data_str = malloc(length + 1);
-                    if(property_data_str == NULL)
-                    {
-                        printf("line: %d, malloc error in function %s\n", __LINE__, __FUNCTION__);
-                        free(property_name);
-                        return;
-                    }
-                    // MUST Initialize the memory
-                    memset(property_data_str, 0, length + 1);
-
-                    count = fread(property_data_str, 1, length, g_infile);
-                    if (!feof(g_infile) && count != length)
-                    {
-                        printf("line: %d, read error in function %s", __LINE__, __FUNCTION__);
-                        return; 
-                    }
-                    printf("    Property: %s - value: %s", property_name, property_data_str);
-                    free(property_data_str);
-                    property_data_str = NULL;
-                }
-               break;
-            default:
-                break;
-        }
-        free(property_name);
-        property_name = NULL; 
+        printf("line: %d, malloc error in function %s\n", __LINE__, __FUNCTION__);
+        return FLV_ERR_NOMEM;
     }
-    // ScirptDataObjectEND
-    uint8_t end[3] = {0};
-    count = fread(end, sizeof(uint8_t), 3, g_infile);
-    if (!feof(g_infile) && count != 3)
-    {
-        printf("line: %d, read error in function %s", __LINE__, __FUNCTION__);
-        return; 
+    memcpy(property_name, name, name_len);
+    property_name[name_len] = '\0';
+
+    switch (value->type) {
+        // Number: DOUBLE 8-byte
+        case AMF_TYPE_NUMBER:
+            if (check_property_name(property_name) != NULL)
+                printf("    Property: %s - value: %.12g %s\n", property_name, value->number,
+                       check_property_name(property_name));
+            else
+                printf("    Property: %s - value: %.12g\n", property_name, value->number);
+            break;
+        // Boolean: UI8
+        case AMF_TYPE_BOOLEAN:
+            printf("    Property: %s - value: %u\n", property_name, value->boolean);
+            break;
+        // ScriptDataString
+        case AMF_TYPE_STRING:
+        case AMF_TYPE_LONG_STRING:
+            printf("    Property: %s - value: %.*s\n", property_name,
+                   (int) value->string_len, value->string);
+            break;
+        default:
+            break;
     }
+    free(property_name);
+    return 0;
 }
-void flv_parser_init(FILE *in_file) {
-    g_infile = in_file;
-    tag_count = 0;
+
+/*
+ * @brief print the properties of a script data tag, e.g. onMetaData
+ */
+int print_scriptdata_tag(const flv_tag_info_t *tag) {
+    return flv_parse_script_data(tag->data, tag->data_size, print_script_property, NULL);
+}
+
+/*
+ * @brief dump callbacks, shared by the sequential and the pipelined mode
+ */
+static int dump_header(void *opaque, const flv_header_t *header) {
+    (void) opaque;
+    flv_print_header(header);
+    return 0;
 }
-// main processing func
-int flv_parser_run() {
 
-    flv_read_header();
+static int dump_tag(void *opaque, const flv_tag_info_t *tag) {
+    uint32_t *tag_count = (uint32_t *) opaque;
 
-    for (; ;) {
-        flv_tag_t *tag = NULL;
-        tag = flv_read_tag(); // read the tag
-        if (!tag) {
-            return 0;
-        }
-        flv_free_tag(tag);    // and free it
-        tag = NULL;
+    printf("\n");
+    printf("PreviousTagSize%u: %lu\n", *tag_count, (unsigned long) tag->prev_tag_size);
+
+    ++*tag_count;
+    printf("Tag%u\n", *tag_count);
+    printf("Tag type: %u - ", tag->tag_type);
+    switch (tag->tag_type) {
+        case TAGTYPE_AUDIODATA:
+            printf("Audio data\n");
+            print_general_tag_info(tag);
+            print_audio_tag(tag);
+            break;
+        case TAGTYPE_VIDEODATA:
+            printf("Video data\n");
+            print_general_tag_info(tag);
+            print_video_tag(tag);
+            break;
+        case TAGTYPE_SCRIPTDATAOBJECT:
+            printf("Script data object\n");
+            print_general_tag_info(tag);                     // Parse the metadata info
+            print_scriptdata_tag(tag);
+            break;
+        default:
+            printf("Unknown tag type!\n");
+            return FLV_ERR_MALFORMED;
     }
+    return 0;
 }
 
-void flv_free_tag(flv_tag_t *tag) {
-    assert(tag != NULL); 
-    if (tag->tag_type == TAGTYPE_VIDEODATA) {
-        video_tag_t *video_tag;
-        video_tag = (video_tag_t *) tag->data;
-        if (video_tag->codec_id == FLV_CODEC_ID_AVC) {
-            avc_video_tag_t *avc_video_tag;
-            avc_video_tag = (avc_video_tag_t *) video_tag->data;
-            free(avc_video_tag->data);
-            free(video_tag->data);
-            free(tag->data);
-            free(tag);
-        } else {
-            free(video_tag->data);
-            free(tag->data);
-            free(tag);
-        }
-    } else if (tag->tag_type == TAGTYPE_AUDIODATA) {
-        audio_tag_t *audio_tag;
-        audio_tag = (audio_tag_t *) tag->data;
-        free(audio_tag->data);
-        free(tag->data);
-        free(tag);
-    } else {
-        // free(tag->data);
-        free(tag);
-    }
+static void dump_end(void *opaque, uint32_t prev_tag_size) {
+    uint32_t *tag_count = (uint32_t *) opaque;
+
+    printf("\n");
+    printf("PreviousTagSize%u: %lu\n", *tag_count, (unsigned long) prev_tag_size);
 }
-void init_flv_header_t(flv_header_t * flv_header)
-{
-    if (!flv_header)
-    {
-        printf("line: %d, the parameter flv_header is NULL!", __LINE__);
-        return;
-    }
-    int i = 0;
-    for (; i < 3; i++)
-        flv_header->signature[i] = 0;
-    flv_header->version = 1;           // For FLV version 1, this value is 1.
-    flv_header->type_flags = 0;
-    flv_header->data_offset = 0;
+
+void flv_parser_init(FILE *in_file) {
+    g_infile = in_file;
+    flv_reader_init_file(&g_reader, g_infile);
 }
-int flv_read_header(void) {
-    size_t count = 0;
-    int i = 0;
-    flv_header_t *flv_header = NULL;
 
-    flv_header = malloc(sizeof(flv_header_t));
-    if (!flv_header)
-    {
-        printf("line: %d, malloc error in function: %s", __LINE__, __FUNCTION__);
-        exit(2);
+// main processing func
+int flv_parser_run(void) {
+    flv_header_t header;
+    flv_tag_info_t tag;
+    uint32_t tag_count = 0;
+    int ret = 0;
+
+    ret = flv_reader_read_header(&g_reader, &header);
+    if (ret == FLV_OK)
+        ret = dump_header(NULL, &header);
+
+    while (ret == FLV_OK) {
+        ret = flv_reader_next_tag(&g_reader, &tag); // read the tag
+        if (ret == FLV_OK)
+            ret = dump_tag(&tag_count, &tag);
+        else if (ret == FLV_EOF)
+            dump_end(&tag_count, tag.prev_tag_size);
     }
-    init_flv_header_t(flv_header);
 
-    count = fread(flv_header, sizeof(flv_header_t), 1, g_infile);
-    
-    if (!feof(g_infile) && count != 1)
-    {
-        printf("line: %d,reading file error in function: %s", __LINE__, __FUNCTION__);
-        exit(3);
-    }
+    flv_reader_destroy(&g_reader);
+    return ret == FLV_EOF ? FLV_OK : ret;
+}
 
-    for (i = 0; i < strlen(flv_signature); i++) {
-        assert(flv_header->signature[i] == flv_signature[i]);
-    }
-    // FLV files shall store multi-byte numbers in big-endian byte order
-    flv_header->data_offset = ntohl(flv_header->data_offset);
+/*
+ * @brief script data collected by the chunked mode; other bodies are not
+ * needed for the dump and are dropped chunk by chunk
+ */
+typedef struct chunk_dump {
+    uint8_t *script;
+    size_t capacity;
+} chunk_dump_t;
 
-    flv_print_header(flv_header);
+static int dump_chunk(void *opaque, const flv_tag_info_t *tag, const uint8_t *chunk, size_t size, uint32_t pos) {
+    chunk_dump_t *dump = (chunk_dump_t *) opaque;
 
-    free(flv_header);
+    if (tag->tag_type == TAGTYPE_SCRIPTDATAOBJECT && tag->data_size <= dump->capacity)
+        memcpy(dump->script + pos, chunk, size);
     return 0;
-
 }
 
-void print_general_tag_info(flv_tag_t *tag) {
-    assert(NULL != tag);
-    printf("  Data size: %lu\n", (unsigned long) tag->data_size);
-    printf("  Timestamp: %lu\n", (unsigned long) tag->timestamp);
-    printf("  Timestamp extended: %u\n", tag->timestamp_ext);
-    printf("  StreamID: %lu\n", (unsigned long) tag->stream_id);
+/*
+ * @brief same output as flv_parser_run, but tag bodies are read in chunks
+ * of at most `max_buffer` bytes. Script data larger than that is not
+ * printed, and oversized tags never allocate more than one chunk.
+ */
+int flv_parser_run_chunked(size_t max_buffer) {
+    chunk_dump_t dump;
+    flv_header_t header;
+    flv_tag_info_t tag;
+    uint32_t tag_count = 0;
+    int ret = 0;
+
+    flv_reader_set_max_buffer(&g_reader, max_buffer);
+    dump.capacity = g_reader.max_buffer;
+    dump.script = malloc(dump.capacity);
+    if (!dump.script)
+        return FLV_ERR_NOMEM;
+
+    ret = flv_reader_read_header(&g_reader, &header);
+    if (ret == FLV_OK)
+        ret = dump_header(NULL, &header);
+
+    while (ret == FLV_OK) {
+        ret = flv_reader_next_tag_chunked(&g_reader, &tag, dump_chunk, &dump);
+        if (ret == FLV_OK) {
+            if (tag.tag_type == TAGTYPE_SCRIPTDATAOBJECT && tag.data_size <= dump.capacity)
+                tag.data = dump.script;
+            ret = dump_tag(&tag_count, &tag);
+        } else if (ret == FLV_EOF) {
+            dump_end(&tag_count, tag.prev_tag_size);
+        }
+    }
 
-    return;
+    free(dump.script);
+    flv_reader_destroy(&g_reader);
+    return ret == FLV_EOF ? FLV_OK : ret;
 }
-void init_flv_tag(flv_tag_t *tag)
-{
-   assert(tag != NULL);
-   tag->filter = 0;
-   tag->tag_type = 0;
-   tag->data_size = 0;
-   tag->timestamp = 0;
-   tag->timestamp_ext = 0;
-   tag->stream_id = 0;
-   tag->data = NULL;
+
+/*
+ * @brief same output as flv_parser_run, but reading, parsing and printing
+ * run on separate threads
+ */
+int flv_parser_run_pipeline(void) {
+    uint32_t tag_count = 0;
+    flv_pipeline_handler_t handler = {dump_header, dump_tag, dump_end, &tag_count};
+
+    return flv_pipeline_run_file(g_infile, NULL, &handler);
 }
-// FLV File Body
-// PreviousTagSize0   UI32    (Always 0)
-// Tag1               FLVTAG
-// PreviousTagSize1   UI32
-// Tag2               FLVTAG
-// ...
-// PreviousTagSizeN-1 UI32
-// TagN               FLVTAG
-// PreviousTagSizeN   UI32
-flv_tag_t *flv_read_tag(void) {
-    uint32_t prev_tag_size = 0;
-    flv_tag_t *tag = NULL;
-    uint8_t first_byte = 0;
-
-    tag = malloc(sizeof(flv_tag_t));
-    if (!tag)
-    {
-        printf("line: %d, malloc error in function: %s", __LINE__, __FUNCTION__);
-        return NULL;
+
+/*
+ * @brief print the per-GOP and per-file content digests instead of the dump
+ */
+int flv_parser_run_digest(void) {
+    flv_digest_t digest;
+    flv_header_t header;
+    flv_tag_info_t tag;
+    int ret = 0;
+
+    flv_reader_set_hash(&g_reader, 1);
+    ret = flv_reader_read_header(&g_reader, &header);
+    flv_digest_init(&digest, ret == FLV_OK ? &header : NULL);
+    while (ret == FLV_OK) {
+        ret = flv_reader_next_tag(&g_reader, &tag);
+        if (ret == FLV_OK)
+            ret = flv_digest_update(&digest, &tag, 1);
+    }
+    if (ret == FLV_EOF)
+        ret = flv_digest_final(&digest);
+
+    if (ret == FLV_OK) {
+        for (size_t i = 0; i < digest.gop_count; ++i) {
+            const flv_gop_digest_t *gop = &digest.gops[i];
+
+            printf("GOP%lu: offset %llu, timestamp %u, duration %u, tags %u, bytes %llu, hash %016llx\n",
+                   (unsigned long) i, (unsigned long long) gop->offset, gop->timestamp, gop->duration,
+                   gop->tag_count, (unsigned long long) gop->bytes, (unsigned long long) gop->hash);
+        }
+        printf("File: tags %llu, GOPs %lu, hash %016llx\n", (unsigned long long) digest.tag_count,
+               (unsigned long) digest.gop_count, (unsigned long long) digest.file_hash);
     }
 
-    init_flv_tag(tag);
+    flv_digest_destroy(&digest);
+    flv_reader_destroy(&g_reader);
+    return ret;
+}
 
-    fread_4(&prev_tag_size);
+/*
+ * @brief print the audio analysis: codec parameters, sample-clock
+ * duration and how far the timestamps drift from it
+ */
+int flv_parser_run_audio(void) {
+    flv_audio_t audio;
+    flv_tag_info_t tag;
+    uint32_t first_video = 0;
+    uint32_t last_video = 0;
+    uint64_t video_tags = 0;
+    int ret = 0;
+
+    flv_audio_init(&audio);
+    while ((ret = flv_reader_next_tag(&g_reader, &tag)) == FLV_OK) {
+        if (tag.tag_type == TAGTYPE_VIDEODATA) {
+            if (video_tags++ == 0)
+                first_video = flv_tag_timestamp(&tag);
+            last_video = flv_tag_timestamp(&tag);
+        }
+        ret = flv_audio_update(&audio, &tag);
+        if (ret != FLV_OK)
+            break;
+    }
+    flv_reader_destroy(&g_reader);
+    if (ret != FLV_EOF)
+        return ret;
 
+    if (audio.tags == 0) {
+        printf("No audio tags\n");
+        return FLV_OK;
+    }
+    printf("SoundFormat: %u - %s\n", audio.sound_format, sound_formats[audio.sound_format & 0x0F]);
+    if (audio.has_aac_config)
+        printf("AudioSpecificConfig: object type %u%s, %u Hz, %u channels, %u samples per frame\n",
+               audio.aac.object_type, audio.aac.extension_type ? " with SBR" : "", audio.aac.sample_rate,
+               audio.aac.channel_config, audio.aac.frame_length);
+    printf("Audio tags: %llu, frames: %llu, samples: %llu, sample rate: %u Hz, channels: %u\n",
+           (unsigned long long) audio.tags, (unsigned long long) audio.frames,
+           (unsigned long long) audio.samples, audio.sample_rate, audio.channels);
+    if (audio.skipped_bytes)
+        printf("Bytes outside MP3 frames: %llu\n", (unsigned long long) audio.skipped_bytes);
+    if (audio.samples == 0) {
+        printf("Sample count unknown for this SoundFormat\n");
+        return FLV_OK;
+    }
+    printf("Duration by samples: %.3f s\n", audio.duration);
+    printf("Duration by timestamps: audio %.3f s", (audio.last_timestamp - audio.first_timestamp) / 1000.0);
+    if (video_tags)
+        printf(", video %.3f s", (last_video - first_video) / 1000.0);
     printf("\n");
-    printf("PreviousTagSize%u: %lu\n", tag_count, (unsigned long) prev_tag_size);
+    printf("Timestamp drift against the sample clock: final %+lld ms, range %+lld to %+lld ms\n",
+           (long long) audio.drift, (long long) audio.min_drift, (long long) audio.max_drift);
+    return FLV_OK;
+}
 
-    size_t count = 0;
-    // Start reading next tag
-    count = fread_1(&first_byte); 
-    if (count == 0) 
-    {
-        free(tag);
-        return NULL;
+static void print_range(const char *name, const flv_estimate_range_t *range, double scale, const char *unit) {
+    if (range->count == 0) {
+        printf("%s: unknown\n", name);
+        return;
     }
-    
-    tag->filter = (first_byte & (1 << 4)); // Filter == 1, other process need to add 
-    tag->tag_type = (first_byte & 0x1F);   
-    // count = fread_1(&(tag->tag_type));
-    fread_3(&(tag->data_size));
-    fread_3(&(tag->timestamp));
-    fread_1(&(tag->timestamp_ext));
-    fread_3(&(tag->stream_id));
-
-    tag_count++;
-    
-    printf("Tag%u\n",tag_count);
-    printf("Tag type: %u - ", tag->tag_type);
-    switch (tag->tag_type) {
-        case TAGTYPE_AUDIODATA:
-            printf("Audio data\n");
-            print_general_tag_info(tag);
-            tag->data = (void *) read_audio_tag(tag);
-            break;
-        case TAGTYPE_VIDEODATA:
-            printf("Video data\n");
-            print_general_tag_info(tag);
-            tag->data = (void *) read_video_tag(tag);
-            break;
-        case TAGTYPE_SCRIPTDATAOBJECT:
-            printf("Script data object\n");
-            print_general_tag_info(tag);                     // Parse the metadata info  
-            read_scriptdata_tag();
-            break;
-        default:
-            printf("Unknown tag type!\n");
-            die();
+    if (range->count == 1) {
+        printf("%s: %.2f%s (1 sample, no interval)\n", name, range->mean * scale, unit);
+        return;
+    }
+    printf("%s: %.2f%s (95%% interval %.2f - %.2f, %u samples)\n", name, range->mean * scale, unit,
+           range->low * scale, range->high * scale, range->count);
+}
+
+/*
+ * @brief characterize the file from `samples` windows spread over it
+ * instead of reading all of it. The input must be a regular file.
+ */
+int flv_parser_run_estimate(uint32_t samples) {
+    flv_estimate_config_t config = {samples, 0};
+    flv_estimate_t estimate;
+    int ret = 0;
+
+    ret = flv_estimate_fd(fileno(g_infile), &config, &estimate);
+    flv_reader_destroy(&g_reader);
+    if (ret != FLV_OK)
+        return ret;
+
+    printf("File size: %llu bytes, read %llu bytes in %u windows, %u measured\n",
+           (unsigned long long) estimate.file_size, (unsigned long long) estimate.bytes_read,
+           estimate.windows, estimate.synced);
+    if (estimate.video_codec != 0xFF)
+        printf("Video codec: %u - %s\n", estimate.video_codec,
+               table_name(codec_ids, TABLE_SIZE(codec_ids), estimate.video_codec));
+    if (estimate.audio_codec != 0xFF)
+        printf("Sound format: %u - %s\n", estimate.audio_codec, sound_formats[estimate.audio_codec & 0x0F]);
+    printf("Duration: %.3f s (%s)\n", estimate.duration,
+           estimate.exact_duration ? "first and last tag" : "extrapolated from the bitrate");
+    print_range("Bitrate", &estimate.bitrate, 1, " kbps");
+    print_range("Frame rate", &estimate.frame_rate, 1, " fps");
+    print_range("Keyframe interval", &estimate.keyframe_interval, 1, " s");
+    print_range("Video share of bytes", &estimate.video_share, 100, "%");
+    return FLV_OK;
+}
+
+/*
+ * @brief print the summary, index and onMetaData of the file, served from
+ * `cache_dir` while the file is unchanged. The input must be a regular file.
+ */
+int flv_parser_run_cached(const char *cache_dir) {
+    static const char *sources[] = {"", "hit", "miss", "stale entry replaced"};
+    flv_cache_result_t result;
+    const flv_summary_t *s = NULL;
+    uint32_t keyframes = 0;
+    int ret = 0;
+
+    ret = flv_cache_get(cache_dir, fileno(g_infile), &result);
+    flv_reader_destroy(&g_reader);
+    if (ret != FLV_OK)
+        return ret;
+    s = &result.header->summary;
+
+    printf("Cache: %s\n", sources[result.source]);
+    if (result.store_status != FLV_OK)
+        fprintf(stderr, "Cache entry not stored: %s\n", flv_strerror(result.store_status));
+    printf("Version: %u, TypeFlags: 0x%02x\n", s->version, s->type_flags);
+    if (s->video_codec != FLV_SUMMARY_NO_CODEC)
+        printf("Video codec: %u - %s\n", s->video_codec, table_name(codec_ids, TABLE_SIZE(codec_ids), s->video_codec));
+    if (s->audio_codec != FLV_SUMMARY_NO_CODEC)
+        printf("Sound format: %u - %s\n", s->audio_codec, sound_formats[s->audio_codec & 0x0F]);
+    printf("Tags: %u (video %u, audio %u, script %u), keyframes %u, longest keyframe interval %u ms\n",
+           s->tag_count, s->video_tags, s->audio_tags, s->script_tags, s->keyframes, s->max_keyframe_interval);
+    printf("Duration: %.3f s (timestamps %u - %u), bitrate %u kbps\n", s->duration / 1000.0,
+           s->first_timestamp, s->last_timestamp, s->bitrate);
+    printf("Content hash: %016llx\n", (unsigned long long) s->content_hash);
+    for (size_t i = 0; i < result.entry_count; ++i) {
+        if (result.entries[i].flags & FLV_INDEX_KEYFRAME)
+            keyframes++;
+    }
+    printf("Index: %lu tags, %u seek points, ends at byte %llu%s\n", (unsigned long) result.entry_count,
+           keyframes, (unsigned long long) result.header->index_end,
+           result.header->index_status == FLV_OK ? "" : " (incomplete last tag)");
+    if (result.metadata) {
+        printf("onMetaData:\n");
+        flv_parse_script_data(result.metadata, result.metadata_size, print_script_property, NULL);
     }
-    return tag;
+    ret = result.header->status;
+    flv_cache_release(&result);
+    return ret;
 }
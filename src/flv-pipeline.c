@@ -0,0 +1,464 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "flv-hash.h"
+#include "flv-pipeline.h"
+#include "flv-ring.h"
+
+// PreviousTagSize followed by the tag header
+#define RECORD_HEADER_SIZE (FLV_PREV_TAG_SIZE_SIZE + FLV_TAG_HEADER_SIZE)
+
+typedef struct pipeline_block {
+    uint8_t *data;
+    size_t size;               // Valid bytes in data
+    int status;                // FLV_OK, or FLV_EOF / an error for the last block
+} pipeline_block_t;
+
+/*
+ * @brief the tags of one block. The batch owns its block until the output
+ * stage is done with it, and `spill` holds the tag that started in the
+ * previous block, if any.
+ */
+typedef struct pipeline_batch {
+    pipeline_block_t *block;
+    flv_tag_info_t *tags;
+    size_t count;
+    size_t capacity;
+    uint8_t *spill;
+    size_t spill_size;
+    int has_header;
+    flv_header_t header;
+    uint32_t prev_tag_size;    // Trailing PreviousTagSize, with status FLV_EOF
+    int status;                // FLV_OK, or FLV_EOF / an error for the last batch
+} pipeline_batch_t;
+
+typedef struct pipeline {
+    flv_read_fn read;
+    void *read_opaque;
+    size_t block_size;
+    size_t depth;
+    int hash_payloads;
+    size_t max_tag_size;
+    pipeline_block_t *blocks;
+    pipeline_batch_t *batches;
+    flv_ring_t free_blocks;    // output -> reader
+    flv_ring_t filled_blocks;  // reader -> parser
+    flv_ring_t free_batches;   // output -> parser
+    flv_ring_t parsed_batches; // parser -> output
+    atomic_int stop;           // Set once the output stage is finished
+} pipeline_t;
+
+// Parser stage state, carried across blocks
+typedef struct pipeline_parser {
+    uint8_t header[FLV_HEADER_SIZE];
+    size_t header_len;
+    uint64_t header_skip;      // Remaining bytes of an extended FLV header
+    int header_done;
+    uint8_t *carry;            // Record that straddles a block boundary
+    size_t carry_len;
+    size_t carry_size;
+    uint64_t carry_offset;
+    uint64_t offset;           // Stream offset of the current block
+    size_t max_tag_size;       // Bounds the carry buffer, 0 = unlimited
+} pipeline_parser_t;
+
+/*
+ * @brief wait politely: spin briefly, then yield, then sleep
+ */
+static void pipeline_backoff(unsigned int *spins) {
+    struct timespec ts = {0, 50000};
+
+    ++*spins;
+    if (*spins < 64)
+        return;
+    if (*spins < 1024)
+        sched_yield();
+    else
+        nanosleep(&ts, NULL);
+}
+
+static void *pipeline_take(pipeline_t *pl, flv_ring_t *ring, int check_stop) {
+    unsigned int spins = 0;
+    void *item = NULL;
+
+    while (!(item = flv_ring_pop(ring))) {
+        if (check_stop && atomic_load_explicit(&pl->stop, memory_order_acquire))
+            return NULL;
+        pipeline_backoff(&spins);
+    }
+    return item;
+}
+
+static void pipeline_give(flv_ring_t *ring, void *item) {
+    unsigned int spins = 0;
+
+    // Every ring can hold all objects of its kind, so this never waits long
+    while (flv_ring_push(ring, item) != 0)
+        pipeline_backoff(&spins);
+}
+
+/*
+ * @brief reader stage: fill blocks with as much data as they hold
+ */
+static void *pipeline_reader(void *arg) {
+    pipeline_t *pl = (pipeline_t *) arg;
+
+    for (; ;) {
+        pipeline_block_t *block = pipeline_take(pl, &pl->free_blocks, 1);
+
+        if (!block)
+            return NULL;
+        block->size = 0;
+        block->status = FLV_OK;
+        while (block->size < pl->block_size) {
+            long count = pl->read(pl->read_opaque, block->data + block->size,
+                                  pl->block_size - block->size);
+            if (count <= 0) {
+                block->status = count < 0 ? FLV_ERR_IO : FLV_EOF;
+                break;
+            }
+            block->size += (size_t) count;
+        }
+        // Data and end of stream travel separately, so the last block is empty
+        if (block->status != FLV_OK && block->size > 0) {
+            int status = block->status;
+
+            block->status = FLV_OK;
+            pipeline_give(&pl->filled_blocks, block);
+            block = pipeline_take(pl, &pl->free_blocks, 1);
+            if (!block)
+                return NULL;
+            block->size = 0;
+            block->status = status;
+        }
+        pipeline_give(&pl->filled_blocks, block);
+        if (block->status != FLV_OK)
+            return NULL;
+    }
+}
+
+static int batch_add_tag(pipeline_t *pl, pipeline_batch_t *batch, const uint8_t *record, uint64_t offset) {
+    flv_tag_info_t *tag = NULL;
+    int ret = 0;
+
+    if (batch->count == batch->capacity) {
+        size_t capacity = batch->capacity ? batch->capacity * 2 : 256;
+        flv_tag_info_t *tags = realloc(batch->tags, capacity * sizeof(*tags));
+
+        if (!tags)
+            return FLV_ERR_NOMEM;
+        batch->tags = tags;
+        batch->capacity = capacity;
+    }
+    tag = &batch->tags[batch->count];
+    flv_decode_tag_header(record + FLV_PREV_TAG_SIZE_SIZE, FLV_TAG_HEADER_SIZE, tag);
+    tag->prev_tag_size = flv_get_ui32(record);
+    tag->offset = offset + FLV_PREV_TAG_SIZE_SIZE;
+    if (pl->max_tag_size && tag->data_size > pl->max_tag_size)
+        return FLV_ERR_LIMIT;
+    ret = flv_decode_tag_body(tag, record + RECORD_HEADER_SIZE, tag->data_size);
+    if (ret != FLV_OK)
+        return ret;
+    if (pl->hash_payloads)
+        tag->hash = flv_hash64(tag->data, tag->data_size, 0);
+    batch->count++;
+    return FLV_OK;
+}
+
+/*
+ * @brief total size of the record (PreviousTagSize + tag) starting at p
+ */
+static size_t record_size(const uint8_t *p) {
+    return RECORD_HEADER_SIZE + flv_get_ui24(p + FLV_PREV_TAG_SIZE_SIZE + 1);
+}
+
+/*
+ * @brief move bytes into the carry buffer until the carried record is
+ * complete or the block runs out. Returns 1 once the record is complete.
+ */
+static int parser_fill_carry(pipeline_parser_t *ps, const uint8_t **pp, const uint8_t *end, int *ret) {
+    const uint8_t *p = *pp;
+
+    for (; ;) {
+        size_t want = RECORD_HEADER_SIZE;
+        size_t count = 0;
+
+        if (ps->carry_len >= RECORD_HEADER_SIZE)
+            want = record_size(ps->carry);
+        if (ps->max_tag_size && want - RECORD_HEADER_SIZE > ps->max_tag_size) {
+            *ret = FLV_ERR_LIMIT;
+            return 0;
+        }
+        if (want > ps->carry_size) {
+            uint8_t *carry = realloc(ps->carry, want);
+
+            if (!carry) {
+                *ret = FLV_ERR_NOMEM;
+                return 0;
+            }
+            ps->carry = carry;
+            ps->carry_size = want;
+        }
+        count = want - ps->carry_len;
+        if (count > (size_t) (end - p))
+            count = (size_t) (end - p);
+        memcpy(ps->carry + ps->carry_len, p, count);
+        ps->carry_len += count;
+        p += count;
+        *pp = p;
+        if (ps->carry_len < want)
+            return 0;
+        // Only the record header was complete, go on with the tag body
+        if (want == RECORD_HEADER_SIZE && record_size(ps->carry) > RECORD_HEADER_SIZE)
+            continue;
+        return 1;
+    }
+}
+
+/*
+ * @brief consume the FLV header, which may itself straddle blocks
+ */
+static int parser_read_header(pipeline_parser_t *ps, pipeline_batch_t *batch,
+                              const uint8_t **pp, const uint8_t *end) {
+    const uint8_t *p = *pp;
+    int ret = 0;
+
+    if (ps->header_len < FLV_HEADER_SIZE) {
+        size_t count = FLV_HEADER_SIZE - ps->header_len;
+
+        if (count > (size_t) (end - p))
+            count = (size_t) (end - p);
+        memcpy(ps->header + ps->header_len, p, count);
+        ps->header_len += count;
+        p += count;
+        if (ps->header_len == FLV_HEADER_SIZE) {
+            ret = flv_decode_header(ps->header, FLV_HEADER_SIZE, &batch->header);
+            if (ret != FLV_OK)
+                return ret;
+            batch->has_header = 1;
+            ps->header_skip = batch->header.data_offset - FLV_HEADER_SIZE;
+        }
+    }
+    if (ps->header_len == FLV_HEADER_SIZE) {
+        size_t count = (size_t) (end - p);
+
+        if (count > ps->header_skip)
+            count = (size_t) ps->header_skip;
+        ps->header_skip -= count;
+        p += count;
+        ps->header_done = (ps->header_skip == 0);
+    }
+    *pp = p;
+    return FLV_OK;
+}
+
+static int parser_parse_block(pipeline_t *pl, pipeline_parser_t *ps, pipeline_batch_t *batch) {
+    pipeline_block_t *block = batch->block;
+    const uint8_t *start = block->data;
+    const uint8_t *p = start;
+    const uint8_t *end = start + block->size;
+    int ret = FLV_OK;
+
+    if (!ps->header_done) {
+        ret = parser_read_header(ps, batch, &p, end);
+        if (ret != FLV_OK)
+            return ret;
+    }
+
+    if (ps->carry_len > 0) {
+        if (!parser_fill_carry(ps, &p, end, &ret))
+            goto done;
+        // The completed record moves to the batch instead of being copied
+        uint8_t *spill = batch->spill;
+        size_t spill_size = batch->spill_size;
+
+        batch->spill = ps->carry;
+        batch->spill_size = ps->carry_size;
+        ps->carry = spill;
+        ps->carry_size = spill_size;
+        ps->carry_len = 0;
+        ret = batch_add_tag(pl, batch, batch->spill, ps->carry_offset);
+        if (ret != FLV_OK)
+            goto done;
+    }
+
+    while (ps->header_done && p < end) {
+        size_t avail = (size_t) (end - p);
+
+        if (avail < RECORD_HEADER_SIZE || avail < record_size(p)) {
+            ps->carry_offset = ps->offset + (uint64_t) (p - start);
+            parser_fill_carry(ps, &p, end, &ret);
+            break;
+        }
+        ret = batch_add_tag(pl, batch, p, ps->offset + (uint64_t) (p - start));
+        if (ret != FLV_OK)
+            break;
+        p += record_size(p);
+    }
+
+done:
+    ps->offset += block->size;
+    return ret;
+}
+
+/*
+ * @brief parser stage: turn each filled block into a batch of tags
+ */
+static void *pipeline_parser(void *arg) {
+    pipeline_t *pl = (pipeline_t *) arg;
+    pipeline_parser_t ps;
+
+    memset(&ps, 0, sizeof(ps));
+    ps.max_tag_size = pl->max_tag_size;
+    for (; ;) {
+        pipeline_block_t *block = pipeline_take(pl, &pl->filled_blocks, 1);
+        pipeline_batch_t *batch = NULL;
+
+        if (!block)
+            break;
+        batch = pipeline_take(pl, &pl->free_batches, 1);
+        if (!batch)
+            break;
+        batch->block = block;
+        batch->count = 0;
+        batch->has_header = 0;
+        batch->prev_tag_size = 0;
+        batch->status = block->status;
+
+        if (block->status == FLV_OK) {
+            batch->status = parser_parse_block(pl, &ps, batch);
+        } else if (block->status == FLV_EOF) {
+            // Only the trailing PreviousTagSize may be left over
+            if (!ps.header_done || (ps.carry_len != 0 && ps.carry_len != FLV_PREV_TAG_SIZE_SIZE))
+                batch->status = FLV_ERR_TRUNCATED;
+            else if (ps.carry_len == FLV_PREV_TAG_SIZE_SIZE)
+                batch->prev_tag_size = flv_get_ui32(ps.carry);
+        }
+        pipeline_give(&pl->parsed_batches, batch);
+        if (batch->status != FLV_OK)
+            break;
+    }
+    free(ps.carry);
+    return NULL;
+}
+
+/*
+ * @brief output stage, runs on the caller's thread
+ */
+static int pipeline_output(pipeline_t *pl, const flv_pipeline_handler_t *handler) {
+    int ret = FLV_OK;
+
+    while (ret == FLV_OK) {
+        pipeline_batch_t *batch = pipeline_take(pl, &pl->parsed_batches, 0);
+
+        if (batch->has_header && handler->header)
+            ret = handler->header(handler->opaque, &batch->header);
+        for (size_t i = 0; i < batch->count && ret == FLV_OK; ++i) {
+            if (handler->tag)
+                ret = handler->tag(handler->opaque, &batch->tags[i]);
+        }
+        if (ret == FLV_OK && batch->status != FLV_OK) {
+            ret = batch->status;
+            if (ret == FLV_EOF && handler->end)
+                handler->end(handler->opaque, batch->prev_tag_size);
+        }
+        pipeline_give(&pl->free_blocks, batch->block);
+        pipeline_give(&pl->free_batches, batch);
+    }
+    atomic_store_explicit(&pl->stop, 1, memory_order_release);
+    return ret == FLV_EOF ? FLV_OK : ret;
+}
+
+static void pipeline_destroy(pipeline_t *pl) {
+    if (pl->blocks) {
+        for (size_t i = 0; i < pl->depth; ++i)
+            free(pl->blocks[i].data);
+    }
+    if (pl->batches) {
+        for (size_t i = 0; i < pl->depth; ++i) {
+            free(pl->batches[i].tags);
+            free(pl->batches[i].spill);
+        }
+    }
+    free(pl->blocks);
+    free(pl->batches);
+    flv_ring_destroy(&pl->free_blocks);
+    flv_ring_destroy(&pl->filled_blocks);
+    flv_ring_destroy(&pl->free_batches);
+    flv_ring_destroy(&pl->parsed_batches);
+}
+
+static int pipeline_create(pipeline_t *pl, const flv_pipeline_config_t *config) {
+    int ret = FLV_OK;
+
+    pl->block_size = (config && config->block_size) ? config->block_size : FLV_PIPELINE_BLOCK_SIZE;
+    pl->depth = (config && config->queue_depth) ? config->queue_depth : FLV_PIPELINE_QUEUE_DEPTH;
+    pl->hash_payloads = config ? config->hash_payloads : 0;
+    pl->max_tag_size = config ? config->max_tag_size : 0;
+    atomic_init(&pl->stop, 0);
+
+    if ((ret = flv_ring_init(&pl->free_blocks, pl->depth)) != FLV_OK ||
+        (ret = flv_ring_init(&pl->filled_blocks, pl->depth)) != FLV_OK ||
+        (ret = flv_ring_init(&pl->free_batches, pl->depth)) != FLV_OK ||
+        (ret = flv_ring_init(&pl->parsed_batches, pl->depth)) != FLV_OK)
+        return ret;
+
+    pl->blocks = calloc(pl->depth, sizeof(pipeline_block_t));
+    pl->batches = calloc(pl->depth, sizeof(pipeline_batch_t));
+    if (!pl->blocks || !pl->batches)
+        return FLV_ERR_NOMEM;
+    for (size_t i = 0; i < pl->depth; ++i) {
+        pl->blocks[i].data = malloc(pl->block_size);
+        if (!pl->blocks[i].data)
+            return FLV_ERR_NOMEM;
+        flv_ring_push(&pl->free_blocks, &pl->blocks[i]);
+        flv_ring_push(&pl->free_batches, &pl->batches[i]);
+    }
+    return FLV_OK;
+}
+
+int flv_pipeline_run(flv_read_fn read, void *read_opaque, const flv_pipeline_config_t *config,
+                     const flv_pipeline_handler_t *handler) {
+    pipeline_t pl;
+    pthread_t reader_thread;
+    pthread_t parser_thread;
+    int ret = 0;
+
+    if (!read || !handler)
+        return FLV_ERR_INVALID_ARG;
+
+    memset(&pl, 0, sizeof(pl));
+    pl.read = read;
+    pl.read_opaque = read_opaque;
+    ret = pipeline_create(&pl, config);
+    if (ret != FLV_OK)
+        goto out;
+
+    if (pthread_create(&reader_thread, NULL, pipeline_reader, &pl) != 0) {
+        ret = FLV_ERR_NOMEM;
+        goto out;
+    }
+    if (pthread_create(&parser_thread, NULL, pipeline_parser, &pl) != 0) {
+        atomic_store(&pl.stop, 1);
+        pthread_join(reader_thread, NULL);
+        ret = FLV_ERR_NOMEM;
+        goto out;
+    }
+
+    ret = pipeline_output(&pl, handler);
+
+    pthread_join(reader_thread, NULL);
+    pthread_join(parser_thread, NULL);
+out:
+    pipeline_destroy(&pl);
+    return ret;
+}
+
+int flv_pipeline_run_file(FILE *file, const flv_pipeline_config_t *config,
+                          const flv_pipeline_handler_t *handler) {
+    if (!file)
+        return FLV_ERR_INVALID_ARG;
+    return flv_pipeline_run(flv_file_read, file, config, handler);
+}
@@ -0,0 +1,58 @@
+#ifndef FLV_PIPELINE_H_
+#define FLV_PIPELINE_H_
+
+/*
+ * Pipelined parsing of one stream. A reader thread fills large blocks, a
+ * parser thread splits them into tags and the calling thread hands the
+ * tags to the handler. The stages are joined by lock-free SPSC rings that
+ * pass block ownership along; tag data is never copied, except for the one
+ * tag per block that straddles a block boundary.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "flv-core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FLV_PIPELINE_BLOCK_SIZE  (1 << 20)
+#define FLV_PIPELINE_QUEUE_DEPTH (8)
+
+typedef struct flv_pipeline_config {
+    size_t block_size;      // Bytes per read block, 0 = FLV_PIPELINE_BLOCK_SIZE
+    size_t queue_depth;     // Blocks in flight, 0 = FLV_PIPELINE_QUEUE_DEPTH
+    int hash_payloads;      // Fill tag->hash on the parser thread
+    size_t max_tag_size;    // Fail with FLV_ERR_LIMIT on larger tag bodies, 0 = unlimited
+} flv_pipeline_config_t;
+
+/*
+ * @brief output stage callbacks, all called on the thread running
+ * flv_pipeline_run. A non-zero return from header or tag stops the
+ * pipeline and is returned by flv_pipeline_run. Tag memory is only valid
+ * during the call. Any callback may be NULL.
+ */
+typedef struct flv_pipeline_handler {
+    int (*header)(void *opaque, const flv_header_t *header);
+    int (*tag)(void *opaque, const flv_tag_info_t *tag);
+    void (*end)(void *opaque, uint32_t prev_tag_size);   // Clean end, with the trailing PreviousTagSize
+    void *opaque;
+} flv_pipeline_handler_t;
+
+/*
+ * @brief parse the stream produced by `read` through the pipeline.
+ * `config` may be NULL. Returns FLV_OK after a clean end of stream, a
+ * negative flv_status, or the value a handler callback stopped with.
+ */
+int flv_pipeline_run(flv_read_fn read, void *read_opaque, const flv_pipeline_config_t *config,
+                     const flv_pipeline_handler_t *handler);
+
+int flv_pipeline_run_file(FILE *file, const flv_pipeline_config_t *config,
+                          const flv_pipeline_handler_t *handler);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FLV_PIPELINE_H_
@@ -0,0 +1,614 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+#include "flv-gop-cache.h"
+#include "flv-relay.h"
+#include "flv-tagbuf.h"
+
+// Buffers handed to one sendmsg call
+#define RELAY_IOV_MAX (64)
+// Longest HTTP request we are willing to buffer
+#define RELAY_REQUEST_MAX (4096)
+// How long the listener rests after accept() ran out of descriptors
+#define RELAY_ACCEPT_BACKOFF_MS (250)
+
+static const char http_response[] =
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Type: video/x-flv\r\n"
+    "Cache-Control: no-cache\r\n"
+    "Connection: close\r\n"
+    "\r\n";
+
+enum subscriber_state {
+    SUB_READING_REQUEST,       // HTTP request not complete yet
+    SUB_WAITING_HEADER,        // Stream header not known yet
+    SUB_STREAMING,
+    SUB_CLOSED
+};
+
+typedef struct relay_subscriber {
+    int fd;
+    int state;
+    int http;
+    char request[RELAY_REQUEST_MAX];
+    size_t request_len;
+    flv_tag_buf_t **queue;     // Circular queue of shared buffers
+    size_t queue_size;
+    size_t queue_head;
+    size_t queue_count;
+    size_t head_offset;        // Bytes of the head buffer already sent
+    size_t queued_bytes;
+    int waiting_sync;          // Dropping until the next sync point
+    uint32_t missed_syncs;     // Sync points dropped in a row for lack of room
+    uint32_t stall_timestamp;  // Timestamp of the first of them
+} relay_subscriber_t;
+
+struct flv_relay {
+    flv_relay_config_t config;
+    int listen_fd;
+    int64_t accept_resume_ms;  // Listener left out of poll() until then
+    relay_subscriber_t **subs;
+    size_t sub_count;
+    size_t sub_size;
+    struct pollfd *pollfds;
+    size_t pollfd_size;
+    flv_tag_buf_t *http_response;
+    flv_tag_buf_t *preamble;   // FLV header and PreviousTagSize0
+    flv_gop_cache_t *gop;      // Metadata, sequence headers and the current GOP
+    int has_video;
+    flv_relay_stats_t stats;
+};
+
+static int64_t now_ms(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+        return FLV_ERR_IO;
+    return FLV_OK;
+}
+
+static int subscriber_enqueue(relay_subscriber_t *sub, flv_tag_buf_t *buf) {
+    if (sub->queue_count == sub->queue_size) {
+        size_t size = sub->queue_size ? sub->queue_size * 2 : 64;
+        flv_tag_buf_t **queue = malloc(size * sizeof(*queue));
+
+        if (!queue)
+            return FLV_ERR_NOMEM;
+        // Unwrap the circular queue into the new array
+        for (size_t i = 0; i < sub->queue_count; ++i)
+            queue[i] = sub->queue[(sub->queue_head + i) % sub->queue_size];
+        free(sub->queue);
+        sub->queue = queue;
+        sub->queue_size = size;
+        sub->queue_head = 0;
+    }
+    sub->queue[(sub->queue_head + sub->queue_count) % sub->queue_size] = flv_tag_buf_ref(buf);
+    sub->queue_count++;
+    sub->queued_bytes += buf->size;
+    return FLV_OK;
+}
+
+static void subscriber_dequeue(relay_subscriber_t *sub) {
+    flv_tag_buf_t *buf = sub->queue[sub->queue_head];
+
+    sub->queued_bytes -= buf->size;
+    sub->queue_head = (sub->queue_head + 1) % sub->queue_size;
+    sub->queue_count--;
+    sub->head_offset = 0;
+    flv_tag_buf_unref(buf);
+}
+
+static void subscriber_close(flv_relay_t *relay, relay_subscriber_t *sub, int failed) {
+    if (sub->state == SUB_CLOSED)
+        return;
+    while (sub->queue_count > 0)
+        subscriber_dequeue(sub);
+    close(sub->fd);
+    sub->fd = -1;
+    sub->state = SUB_CLOSED;
+    // A descriptor is free again, so a paused listener can retry at once
+    relay->accept_resume_ms = 0;
+    if (failed)
+        relay->stats.disconnects++;
+}
+
+/*
+ * @brief write as much of the queue as the socket takes without blocking
+ */
+static void subscriber_write(flv_relay_t *relay, relay_subscriber_t *sub) {
+    while (sub->state == SUB_STREAMING && sub->queue_count > 0) {
+        struct iovec iov[RELAY_IOV_MAX];
+        struct msghdr msg;
+        size_t count = sub->queue_count < RELAY_IOV_MAX ? sub->queue_count : RELAY_IOV_MAX;
+        ssize_t sent = 0;
+
+        for (size_t i = 0; i < count; ++i) {
+            flv_tag_buf_t *buf = sub->queue[(sub->queue_head + i) % sub->queue_size];
+            size_t skip = i == 0 ? sub->head_offset : 0;
+
+            iov[i].iov_base = buf->data + skip;
+            iov[i].iov_len = buf->size - skip;
+        }
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        // sendmsg is writev for sockets, but without the SIGPIPE
+        sent = sendmsg(sub->fd, &msg, MSG_NOSIGNAL);
+        if (sent < 0 && errno == ENOTSOCK)
+            sent = writev(sub->fd, iov, (int) count);
+        if (sent < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                subscriber_close(relay, sub, 1);
+            return;
+        }
+        relay->stats.bytes_sent += (uint64_t) sent;
+        while (sent > 0) {
+            flv_tag_buf_t *buf = sub->queue[sub->queue_head];
+            size_t left = buf->size - sub->head_offset;
+
+            if ((size_t) sent < left) {
+                sub->head_offset += (size_t) sent;
+                return;   // Short write, the socket buffer is full
+            }
+            sent -= (ssize_t) left;
+            subscriber_dequeue(sub);
+        }
+    }
+}
+
+/*
+ * @brief a joining subscriber gets the header, the current metadata and
+ * codec configuration and, if it fits the queue, the cached GOP so that
+ * playback starts at once. Otherwise it waits for the next sync point.
+ */
+static int subscriber_start(flv_relay_t *relay, relay_subscriber_t *sub) {
+    flv_gop_snapshot_t snap;
+    int ret = FLV_OK;
+
+    if (!relay->preamble) {
+        sub->state = SUB_WAITING_HEADER;
+        return FLV_OK;
+    }
+    ret = flv_gop_cache_snapshot(relay->gop, &snap);
+    if (ret != FLV_OK)
+        return ret;
+
+    flv_tag_buf_t *bufs[] = {relay->preamble, snap.metadata, snap.video_config, snap.audio_config};
+
+    for (size_t i = 0; i < sizeof(bufs) / sizeof(bufs[0]) && ret == FLV_OK; ++i) {
+        if (bufs[i])
+            ret = subscriber_enqueue(sub, bufs[i]);
+    }
+    sub->waiting_sync = 1;
+    if (snap.count > 0 && sub->queued_bytes + snap.bytes <= relay->config.max_queue_bytes) {
+        for (size_t i = 0; i < snap.count && ret == FLV_OK; ++i)
+            ret = subscriber_enqueue(sub, snap.tags[i]);
+        sub->waiting_sync = 0;
+    }
+    flv_gop_snapshot_release(&snap);
+    sub->state = SUB_STREAMING;
+    return ret;
+}
+
+static int relay_is_sync_point(const flv_relay_t *relay, const flv_tag_buf_t *buf) {
+    if (buf->tag_type == TAGTYPE_VIDEODATA)
+        return (buf->flags & FLV_TAG_BUF_KEYFRAME) != 0;
+    // Audio-only streams can resume at any audio frame
+    return buf->tag_type == TAGTYPE_AUDIODATA && !relay->has_video;
+}
+
+/*
+ * @brief note a sync point the subscriber had no room for. Returns non-zero
+ * once such misses span max_stall_ms of stream time: the client has stopped
+ * reading, and dropping alone would hold its queue and descriptor forever.
+ */
+static int subscriber_missed_sync(const flv_relay_t *relay, relay_subscriber_t *sub,
+                                  const flv_tag_buf_t *buf) {
+    // A timestamp going backwards restarts the clock rather than wrapping
+    if (sub->missed_syncs++ == 0 || buf->timestamp < sub->stall_timestamp)
+        sub->stall_timestamp = buf->timestamp;
+    return buf->timestamp - sub->stall_timestamp >= relay->config.max_stall_ms;
+}
+
+/*
+ * @brief queue one tag on a subscriber, applying the backpressure policy
+ */
+static void subscriber_offer(flv_relay_t *relay, relay_subscriber_t *sub, flv_tag_buf_t *buf) {
+    // Metadata and codec configuration are never dropped
+    if (!(buf->flags & (FLV_TAG_BUF_METADATA | FLV_TAG_BUF_SEQUENCE_HEADER))) {
+        int room = sub->queued_bytes + buf->size <= relay->config.max_queue_bytes;
+
+        if (sub->waiting_sync || !room) {
+            int sync = relay_is_sync_point(relay, buf);
+
+            if (!room || !sync) {
+                sub->waiting_sync = 1;
+                relay->stats.tags_dropped++;
+                if (sync && !room && subscriber_missed_sync(relay, sub, buf))
+                    subscriber_close(relay, sub, 1);
+                return;
+            }
+            sub->waiting_sync = 0;
+            sub->missed_syncs = 0;
+        }
+    }
+    if (subscriber_enqueue(sub, buf) != FLV_OK || sub->queued_bytes > relay->config.max_backlog_bytes)
+        subscriber_close(relay, sub, 1);
+}
+
+/*
+ * @brief read the HTTP request; the stream starts after the blank line
+ */
+static void subscriber_read_request(flv_relay_t *relay, relay_subscriber_t *sub) {
+    for (; ;) {
+        ssize_t count = read(sub->fd, sub->request + sub->request_len,
+                             sizeof(sub->request) - 1 - sub->request_len);
+
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return;
+        if (count <= 0) {
+            subscriber_close(relay, sub, count < 0);
+            return;
+        }
+        sub->request_len += (size_t) count;
+        sub->request[sub->request_len] = '\0';
+        if (strstr(sub->request, "\r\n\r\n") || strstr(sub->request, "\n\n"))
+            break;
+        if (sub->request_len == sizeof(sub->request) - 1) {
+            subscriber_close(relay, sub, 1);
+            return;
+        }
+    }
+    if (strncmp(sub->request, "GET ", 4) != 0) {
+        subscriber_close(relay, sub, 1);
+        return;
+    }
+    if (subscriber_enqueue(sub, relay->http_response) != FLV_OK ||
+        subscriber_start(relay, sub) != FLV_OK)
+        subscriber_close(relay, sub, 1);
+}
+
+/*
+ * @brief streaming subscribers send nothing; read only to notice hang-ups
+ */
+static void subscriber_drain_input(flv_relay_t *relay, relay_subscriber_t *sub) {
+    char scratch[512];
+
+    for (; ;) {
+        ssize_t count = read(sub->fd, scratch, sizeof(scratch));
+
+        if (count > 0)
+            continue;
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+            subscriber_close(relay, sub, count < 0);
+        return;
+    }
+}
+
+/*
+ * @brief drop closed subscribers from the table
+ */
+static void relay_reap(flv_relay_t *relay) {
+    size_t kept = 0;
+
+    for (size_t i = 0; i < relay->sub_count; ++i) {
+        relay_subscriber_t *sub = relay->subs[i];
+
+        if (sub->state == SUB_CLOSED) {
+            free(sub->queue);
+            free(sub);
+        } else {
+            relay->subs[kept++] = sub;
+        }
+    }
+    relay->sub_count = kept;
+    relay->stats.subscribers = (uint32_t) kept;
+}
+
+flv_relay_t *flv_relay_create(const flv_relay_config_t *config) {
+    flv_relay_t *relay = calloc(1, sizeof(flv_relay_t));
+    flv_gop_cache_config_t gop_config;
+
+    if (!relay)
+        return NULL;
+    if (config)
+        relay->config = *config;
+    if (!relay->config.max_queue_bytes)
+        relay->config.max_queue_bytes = FLV_RELAY_MAX_QUEUE_BYTES;
+    if (!relay->config.max_backlog_bytes)
+        relay->config.max_backlog_bytes = FLV_RELAY_MAX_BACKLOG_BYTES;
+    if (relay->config.max_backlog_bytes < relay->config.max_queue_bytes)
+        relay->config.max_backlog_bytes = relay->config.max_queue_bytes;
+    if (!relay->config.max_stall_ms)
+        relay->config.max_stall_ms = FLV_RELAY_MAX_STALL_MS;
+    relay->listen_fd = -1;
+    relay->http_response = flv_tag_buf_new_raw(http_response, sizeof(http_response) - 1);
+    memset(&gop_config, 0, sizeof(gop_config));
+    gop_config.max_bytes = relay->config.max_queue_bytes / 2;
+    // Without the GOP cache, metadata and sequence headers are still tracked
+    gop_config.disabled = relay->config.disable_gop_cache;
+    relay->gop = flv_gop_cache_create(&gop_config);
+    if (!relay->http_response || !relay->gop) {
+        flv_tag_buf_unref(relay->http_response);
+        flv_gop_cache_destroy(relay->gop);
+        free(relay);
+        return NULL;
+    }
+    return relay;
+}
+
+void flv_relay_destroy(flv_relay_t *relay) {
+    if (!relay)
+        return;
+    for (size_t i = 0; i < relay->sub_count; ++i)
+        subscriber_close(relay, relay->subs[i], 0);
+    relay_reap(relay);
+    if (relay->listen_fd >= 0)
+        close(relay->listen_fd);
+    flv_tag_buf_unref(relay->http_response);
+    flv_tag_buf_unref(relay->preamble);
+    flv_gop_cache_destroy(relay->gop);
+    free(relay->subs);
+    free(relay->pollfds);
+    free(relay);
+}
+
+int flv_relay_listen(flv_relay_t *relay, const char *address, uint16_t port) {
+    struct sockaddr_in addr;
+    int fd = -1;
+    int one = 1;
+
+    if (!relay || relay->listen_fd >= 0)
+        return FLV_ERR_INVALID_ARG;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (address && inet_pton(AF_INET, address, &addr.sin_addr) != 1)
+        return FLV_ERR_INVALID_ARG;
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return FLV_ERR_IO;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 || listen(fd, 128) < 0 ||
+        set_nonblocking(fd) != FLV_OK) {
+        close(fd);
+        return FLV_ERR_IO;
+    }
+    relay->listen_fd = fd;
+    return FLV_OK;
+}
+
+int flv_relay_port(const flv_relay_t *relay) {
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+
+    if (!relay || relay->listen_fd < 0)
+        return FLV_ERR_INVALID_ARG;
+    if (getsockname(relay->listen_fd, (struct sockaddr *) &addr, &len) < 0)
+        return FLV_ERR_IO;
+    return ntohs(addr.sin_port);
+}
+
+int flv_relay_add_subscriber(flv_relay_t *relay, int fd, int http) {
+    relay_subscriber_t *sub = NULL;
+
+    if (!relay || fd < 0) {
+        if (fd >= 0)
+            close(fd);
+        return FLV_ERR_INVALID_ARG;
+    }
+    if (set_nonblocking(fd) != FLV_OK) {
+        close(fd);
+        return FLV_ERR_IO;
+    }
+    if (relay->sub_count == relay->sub_size) {
+        size_t size = relay->sub_size ? relay->sub_size * 2 : 16;
+        relay_subscriber_t **subs = realloc(relay->subs, size * sizeof(*subs));
+
+        if (!subs) {
+            close(fd);
+            return FLV_ERR_NOMEM;
+        }
+        relay->subs = subs;
+        relay->sub_size = size;
+    }
+    sub = calloc(1, sizeof(relay_subscriber_t));
+    if (!sub) {
+        close(fd);
+        return FLV_ERR_NOMEM;
+    }
+    sub->fd = fd;
+    sub->http = http;
+    sub->state = SUB_READING_REQUEST;
+    relay->subs[relay->sub_count++] = sub;
+    relay->stats.subscribers = (uint32_t) relay->sub_count;
+
+    if (!http && subscriber_start(relay, sub) != FLV_OK) {
+        subscriber_close(relay, sub, 1);
+        return FLV_ERR_NOMEM;
+    }
+    return FLV_OK;
+}
+
+int flv_relay_set_header(flv_relay_t *relay, const flv_header_t *header) {
+    uint8_t bytes[FLV_HEADER_SIZE + FLV_PREV_TAG_SIZE_SIZE];
+
+    if (!relay || !header)
+        return FLV_ERR_INVALID_ARG;
+
+    // Always send a plain 9-byte header, whatever DataOffset the source had
+    memcpy(bytes, header->signature, 3);
+    bytes[3] = header->version;
+    bytes[4] = header->type_flags;
+    flv_put_ui32(bytes + 5, FLV_HEADER_SIZE);
+    flv_put_ui32(bytes + FLV_HEADER_SIZE, 0);
+
+    flv_tag_buf_unref(relay->preamble);
+    relay->preamble = flv_tag_buf_new_raw(bytes, sizeof(bytes));
+    if (!relay->preamble)
+        return FLV_ERR_NOMEM;
+    relay->has_video = (header->type_flags & (1 << FLV_HEADER_VIDEO_BIT)) != 0;
+
+    for (size_t i = 0; i < relay->sub_count; ++i) {
+        relay_subscriber_t *sub = relay->subs[i];
+
+        if (sub->state == SUB_WAITING_HEADER && subscriber_start(relay, sub) != FLV_OK)
+            subscriber_close(relay, sub, 1);
+    }
+    return FLV_OK;
+}
+
+int flv_relay_publish(flv_relay_t *relay, const flv_tag_info_t *tag) {
+    flv_tag_buf_t *buf = NULL;
+
+    if (!relay || !tag)
+        return FLV_ERR_INVALID_ARG;
+
+    // The one and only copy of this tag
+    buf = flv_tag_buf_new(tag);
+    if (!buf)
+        return FLV_ERR_NOMEM;
+
+    if (buf->tag_type == TAGTYPE_VIDEODATA)
+        relay->has_video = 1;
+    if (flv_gop_cache_push(relay->gop, buf) != FLV_OK) {
+        flv_tag_buf_unref(buf);
+        return FLV_ERR_NOMEM;
+    }
+
+    for (size_t i = 0; i < relay->sub_count; ++i) {
+        relay_subscriber_t *sub = relay->subs[i];
+
+        if (sub->state != SUB_STREAMING)
+            continue;
+        subscriber_offer(relay, sub, buf);
+        subscriber_write(relay, sub);
+    }
+    relay->stats.tags_published++;
+    flv_tag_buf_unref(buf);
+    relay_reap(relay);
+    return FLV_OK;
+}
+
+static void relay_accept(flv_relay_t *relay) {
+    for (; ;) {
+        int fd = accept(relay->listen_fd, NULL, NULL);
+
+        if (fd < 0) {
+            // The pending connection stays queued and the listener readable,
+            // so keep it out of poll() for a while rather than spin
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM)
+                relay->accept_resume_ms = now_ms() + RELAY_ACCEPT_BACKOFF_MS;
+            return;
+        }
+        // The relay owns fd now, and closes it if it cannot be added
+        flv_relay_add_subscriber(relay, fd, 1);
+    }
+}
+
+int flv_relay_poll(flv_relay_t *relay, int timeout_ms) {
+    size_t nfds = 0;
+    int listening = 0;
+    int accept_ready = 0;
+
+    if (!relay)
+        return FLV_ERR_INVALID_ARG;
+
+    if (relay->pollfd_size < relay->sub_count + 1) {
+        struct pollfd *fds = realloc(relay->pollfds, (relay->sub_count + 1) * sizeof(*fds));
+
+        if (!fds)
+            return FLV_ERR_NOMEM;
+        relay->pollfds = fds;
+        relay->pollfd_size = relay->sub_count + 1;
+    }
+    for (size_t i = 0; i < relay->sub_count; ++i) {
+        relay_subscriber_t *sub = relay->subs[i];
+
+        relay->pollfds[i].fd = sub->fd;
+        relay->pollfds[i].events = POLLIN;
+        if (sub->state == SUB_STREAMING && sub->queue_count > 0)
+            relay->pollfds[i].events |= POLLOUT;
+        relay->pollfds[i].revents = 0;
+    }
+    nfds = relay->sub_count;
+    if (relay->listen_fd >= 0) {
+        int64_t wait = relay->accept_resume_ms ? relay->accept_resume_ms - now_ms() : 0;
+
+        listening = wait <= 0;
+        if (listening) {
+            relay->accept_resume_ms = 0;
+            relay->pollfds[nfds].fd = relay->listen_fd;
+            relay->pollfds[nfds].events = POLLIN;
+            relay->pollfds[nfds].revents = 0;
+            nfds++;
+        } else if (timeout_ms < 0 || timeout_ms > wait) {
+            timeout_ms = (int) wait;
+        }
+    }
+
+    if (poll(relay->pollfds, nfds, timeout_ms) < 0 && errno != EINTR)
+        return FLV_ERR_IO;
+    if (listening)
+        accept_ready = (relay->pollfds[nfds - 1].revents & POLLIN) != 0;
+
+    for (size_t i = 0; i < relay->sub_count; ++i) {
+        relay_subscriber_t *sub = relay->subs[i];
+        short revents = relay->pollfds[i].revents;
+
+        if (revents & (POLLERR | POLLNVAL)) {
+            subscriber_close(relay, sub, 1);
+            continue;
+        }
+        if (revents & (POLLIN | POLLHUP)) {
+            if (sub->state == SUB_READING_REQUEST)
+                subscriber_read_request(relay, sub);
+            else
+                subscriber_drain_input(relay, sub);
+        }
+        if (sub->state == SUB_STREAMING && sub->queue_count > 0)
+            subscriber_write(relay, sub);
+    }
+    relay_reap(relay);
+
+    if (accept_ready)
+        relay_accept(relay);
+    return (int) relay->sub_count;
+}
+
+size_t flv_relay_pending(const flv_relay_t *relay) {
+    size_t pending = 0;
+
+    for (size_t i = 0; relay && i < relay->sub_count; ++i)
+        pending += relay->subs[i]->queued_bytes;
+    return pending;
+}
+
+void flv_relay_get_stats(const flv_relay_t *relay, flv_relay_stats_t *stats) {
+    if (relay && stats)
+        *stats = relay->stats;
+}
@@ -0,0 +1,102 @@
+#ifndef FLV_RELAY_H_
+#define FLV_RELAY_H_
+
+/*
+ * HTTP-FLV fan-out relay. The incoming stream is parsed once; every tag is
+ * wrapped in one shared flv_tag_buf_t and queued by reference on each
+ * subscriber, then written out with scatter/gather I/O. A subscriber whose
+ * queue grows past max_queue_bytes loses droppable tags until the next
+ * keyframe; one that reaches max_backlog_bytes, or that has no room for
+ * any keyframe over max_stall_ms of stream time, is disconnected. New
+ * subscribers start from the GOP cache (flv-gop-cache.h).
+ *
+ * The relay is single threaded and non-blocking: publish tags and call
+ * flv_relay_poll from the same thread.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "flv-core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FLV_RELAY_MAX_QUEUE_BYTES   (2 << 20)
+#define FLV_RELAY_MAX_BACKLOG_BYTES (16 << 20)
+#define FLV_RELAY_MAX_STALL_MS      (10000)
+
+typedef struct flv_relay_config {
+    size_t max_queue_bytes;    // Start dropping above this, 0 = FLV_RELAY_MAX_QUEUE_BYTES
+    size_t max_backlog_bytes;  // Disconnect above this, 0 = FLV_RELAY_MAX_BACKLOG_BYTES
+    int disable_gop_cache;     // Make joiners wait for the next keyframe
+    uint32_t max_stall_ms;     // Disconnect after missing keyframes this long, 0 = FLV_RELAY_MAX_STALL_MS
+} flv_relay_config_t;
+
+typedef struct flv_relay_stats {
+    uint32_t subscribers;      // Currently connected
+    uint64_t tags_published;
+    uint64_t tags_dropped;     // Summed over all subscribers
+    uint64_t bytes_sent;
+    uint64_t disconnects;      // Subscribers closed for errors or backlog
+} flv_relay_stats_t;
+
+typedef struct flv_relay flv_relay_t;
+
+/*
+ * @brief `config` may be NULL. Returns NULL if out of memory.
+ */
+flv_relay_t *flv_relay_create(const flv_relay_config_t *config);
+
+/*
+ * @brief close all subscribers and the listening socket
+ */
+void flv_relay_destroy(flv_relay_t *relay);
+
+/*
+ * @brief accept HTTP clients on `address`:`port` (address NULL = any).
+ * Every GET request is answered with the live stream.
+ */
+int flv_relay_listen(flv_relay_t *relay, const char *address, uint16_t port);
+
+/*
+ * @brief the bound port, useful after listening on port 0
+ */
+int flv_relay_port(const flv_relay_t *relay);
+
+/*
+ * @brief hand an already connected descriptor to the relay, which takes
+ * ownership: it is closed on failure too. With `http` set the request is
+ * read and answered first.
+ */
+int flv_relay_add_subscriber(flv_relay_t *relay, int fd, int http);
+
+/*
+ * @brief the stream header; subscribers are started once it is known
+ */
+int flv_relay_set_header(flv_relay_t *relay, const flv_header_t *header);
+
+/*
+ * @brief fan one tag out to every subscriber
+ */
+int flv_relay_publish(flv_relay_t *relay, const flv_tag_info_t *tag);
+
+/*
+ * @brief wait up to `timeout_ms` for socket activity, then accept, read
+ * requests and write queued data. Returns the number of subscribers or a
+ * negative flv_status.
+ */
+int flv_relay_poll(flv_relay_t *relay, int timeout_ms);
+
+/*
+ * @brief bytes still queued across all subscribers
+ */
+size_t flv_relay_pending(const flv_relay_t *relay);
+
+void flv_relay_get_stats(const flv_relay_t *relay, flv_relay_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FLV_RELAY_H_
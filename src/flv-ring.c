@@ -0,0 +1,57 @@
+#include <stdlib.h>
+#include "flv-core.h"
+#include "flv-ring.h"
+
+int flv_ring_init(flv_ring_t *ring, size_t capacity) {
+    size_t size = 1;
+
+    if (!ring || capacity == 0)
+        return FLV_ERR_INVALID_ARG;
+    while (size < capacity)
+        size <<= 1;
+
+    ring->slots = calloc(size, sizeof(void *));
+    if (!ring->slots)
+        return FLV_ERR_NOMEM;
+    ring->mask = size - 1;
+    ring->cached_head = 0;
+    ring->cached_tail = 0;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    return FLV_OK;
+}
+
+void flv_ring_destroy(flv_ring_t *ring) {
+    if (!ring)
+        return;
+    free(ring->slots);
+    ring->slots = NULL;
+}
+
+int flv_ring_push(flv_ring_t *ring, void *item) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+    if (tail - ring->cached_head > ring->mask) {
+        ring->cached_head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if (tail - ring->cached_head > ring->mask)
+            return -1;
+    }
+    ring->slots[tail & ring->mask] = item;
+    // Publish the slot before the new tail becomes visible to the consumer
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return 0;
+}
+
+void *flv_ring_pop(flv_ring_t *ring) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    void *item = NULL;
+
+    if (head == ring->cached_tail) {
+        ring->cached_tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        if (head == ring->cached_tail)
+            return NULL;
+    }
+    item = ring->slots[head & ring->mask];
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return item;
+}
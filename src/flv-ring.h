@@ -0,0 +1,40 @@
+#ifndef FLV_RING_H_
+#define FLV_RING_H_
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+#define FLV_CACHE_LINE (64)
+
+/*
+ * @brief bounded lock-free single-producer/single-consumer ring of
+ * pointers. Exactly one thread may push and one other thread may pop;
+ * pushing a pointer hands the object it points to over to the consumer.
+ */
+typedef struct flv_ring {
+    _Alignas(FLV_CACHE_LINE) atomic_size_t head;   // Next slot to pop, written by the consumer
+    size_t cached_tail;                            // Consumer's last view of tail
+    _Alignas(FLV_CACHE_LINE) atomic_size_t tail;   // Next slot to push, written by the producer
+    size_t cached_head;                            // Producer's last view of head
+    _Alignas(FLV_CACHE_LINE) size_t mask;
+    void **slots;
+} flv_ring_t;
+
+/*
+ * @brief `capacity` is rounded up to a power of two
+ */
+int flv_ring_init(flv_ring_t *ring, size_t capacity);
+
+void flv_ring_destroy(flv_ring_t *ring);
+
+/*
+ * @brief returns 0 on success, -1 if the ring is full
+ */
+int flv_ring_push(flv_ring_t *ring, void *item);
+
+/*
+ * @brief returns NULL if the ring is empty
+ */
+void *flv_ring_pop(flv_ring_t *ring);
+
+#endif // FLV_RING_H_
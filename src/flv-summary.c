@@ -0,0 +1,187 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include "flv-summary.h"
+
+_Static_assert(sizeof(flv_summary_t) == 160, "flv_summary_t is a stored format");
+
+typedef struct meta_field {
+    const char *name;
+    uint32_t flag;
+    size_t offset;
+} meta_field_t;
+
+static const meta_field_t meta_fields[] = {
+    {"duration",        FLV_META_DURATION,        offsetof(flv_summary_t, meta_duration)},
+    {"width",           FLV_META_WIDTH,           offsetof(flv_summary_t, meta_width)},
+    {"height",          FLV_META_HEIGHT,          offsetof(flv_summary_t, meta_height)},
+    {"framerate",       FLV_META_FRAMERATE,       offsetof(flv_summary_t, meta_framerate)},
+    {"videodatarate",   FLV_META_VIDEODATARATE,   offsetof(flv_summary_t, meta_videodatarate)},
+    {"audiodatarate",   FLV_META_AUDIODATARATE,   offsetof(flv_summary_t, meta_audiodatarate)},
+    {"filesize",        FLV_META_FILESIZE,        offsetof(flv_summary_t, meta_filesize)},
+    {"audiosamplerate", FLV_META_AUDIOSAMPLERATE, offsetof(flv_summary_t, meta_audiosamplerate)},
+    {"videocodecid",    FLV_META_VIDEOCODECID,    offsetof(flv_summary_t, meta_videocodecid)},
+    {"audiocodecid",    FLV_META_AUDIOCODECID,    offsetof(flv_summary_t, meta_audiocodecid)}
+};
+
+static int summary_meta_property(void *opaque, const char *name, size_t name_len,
+                                 const flv_amf_value_t *value) {
+    flv_summary_t *summary = (flv_summary_t *) opaque;
+
+    if (value->type != AMF_TYPE_NUMBER)
+        return 0;
+    for (size_t i = 0; i < sizeof(meta_fields) / sizeof(meta_fields[0]); ++i) {
+        const meta_field_t *field = &meta_fields[i];
+
+        if (strlen(field->name) == name_len && memcmp(field->name, name, name_len) == 0) {
+            memcpy((uint8_t *) summary + field->offset, &value->number, sizeof(double));
+            summary->meta_flags |= field->flag;
+            break;
+        }
+    }
+    return 0;
+}
+
+void flv_summary_begin(flv_summary_builder_t *builder, const flv_header_t *header) {
+    memset(builder, 0, sizeof(*builder));
+    flv_hash64_reset(&builder->hash_state, 0);
+    builder->summary.video_codec = FLV_SUMMARY_NO_CODEC;
+    builder->summary.audio_codec = FLV_SUMMARY_NO_CODEC;
+    if (header) {
+        builder->summary.version = header->version;
+        builder->summary.type_flags = header->type_flags;
+    }
+}
+
+void flv_summary_update(flv_summary_builder_t *builder, const flv_tag_info_t *tag, int hashed) {
+    flv_summary_t *summary = &builder->summary;
+    uint32_t timestamp = flv_tag_timestamp(tag);
+    uint64_t hash = hashed ? tag->hash : flv_hash64(tag->data, tag->data_size, 0);
+    uint8_t bytes[8];
+
+    // Same fold as the flv_digest file hash
+    flv_put_ui32(bytes, (uint32_t) (hash >> 32));
+    flv_put_ui32(bytes + 4, (uint32_t) hash);
+    flv_hash64_update(&builder->hash_state, bytes, sizeof(bytes));
+
+    // Script tags are often stamped 0 whatever the media starts at
+    if (tag->tag_type == TAGTYPE_AUDIODATA || tag->tag_type == TAGTYPE_VIDEODATA) {
+        if (summary->audio_tags + summary->video_tags == 0 || timestamp < summary->first_timestamp)
+            summary->first_timestamp = timestamp;
+        if (summary->audio_tags + summary->video_tags == 0 || timestamp > summary->last_timestamp)
+            summary->last_timestamp = timestamp;
+    }
+    summary->tag_count++;
+
+    switch (tag->tag_type) {
+        case TAGTYPE_AUDIODATA:
+            if (summary->audio_tags++ == 0) {
+                summary->audio_codec = tag->sound_format;
+                summary->sound_rate = tag->sound_rate;
+                summary->sound_size = tag->sound_size;
+                summary->sound_type = tag->sound_type;
+            }
+            summary->audio_bytes += tag->data_size;
+            break;
+        case TAGTYPE_VIDEODATA:
+            if (summary->video_tags++ == 0)
+                summary->video_codec = tag->codec_id;
+            summary->video_bytes += tag->data_size;
+            if (tag->frame_type == FLV_FRAME_TYPE_KEY) {
+                // AVC sequence headers are flagged as keyframes but are not frames
+                if (tag->codec_id == FLV_CODEC_ID_AVC && tag->avc_packet_type != FLV_AVC_NALU)
+                    break;
+                if (builder->seen_keyframe && timestamp - builder->last_keyframe > summary->max_keyframe_interval)
+                    summary->max_keyframe_interval = timestamp - builder->last_keyframe;
+                builder->last_keyframe = timestamp;
+                builder->seen_keyframe = 1;
+                summary->keyframes++;
+            }
+            break;
+        case TAGTYPE_SCRIPTDATAOBJECT:
+            // onMetaData is the first script tag
+            if (summary->script_tags++ == 0)
+                flv_parse_script_data(tag->data, tag->data_size, summary_meta_property, summary);
+            break;
+        default:
+            break;
+    }
+}
+
+void flv_summary_end(flv_summary_builder_t *builder, uint64_t file_size, flv_summary_t *summary) {
+    flv_summary_t *s = &builder->summary;
+
+    s->duration = s->last_timestamp - s->first_timestamp;
+    if (s->duration > 0)
+        s->bitrate = (uint32_t) (file_size * 8 / s->duration);   // bits per ms == kbit/s
+    s->content_hash = flv_hash64_digest(&builder->hash_state);
+    if (summary)
+        *summary = *s;
+}
+
+int flv_summarize_memory(const void *data, size_t size, flv_summary_t *summary) {
+    flv_summary_builder_t builder;
+    flv_reader_t reader;
+    flv_header_t header;
+    flv_tag_info_t tag;
+    int ret = 0;
+
+    if (!data || !summary)
+        return FLV_ERR_INVALID_ARG;
+
+    flv_reader_init_memory(&reader, data, size);
+    flv_reader_set_hash(&reader, 1);
+    ret = flv_reader_read_header(&reader, &header);
+    // A damaged file still gets an empty summary, with no codecs
+    flv_summary_begin(&builder, ret == FLV_OK ? &header : NULL);
+    while (ret == FLV_OK && (ret = flv_reader_next_tag(&reader, &tag)) == FLV_OK)
+        flv_summary_update(&builder, &tag, 1);
+    // A damaged tail still leaves a useful summary of what came before
+    flv_summary_end(&builder, size, summary);
+    flv_reader_destroy(&reader);
+    return ret == FLV_EOF ? FLV_OK : ret;
+}
+
+typedef struct fd_source {
+    int fd;
+    uint64_t pos;
+    uint64_t end;              // Size the caller took the file to be
+} fd_source_t;
+
+static long fd_source_read(void *opaque, void *buf, size_t size) {
+    fd_source_t *source = (fd_source_t *) opaque;
+    ssize_t count = 0;
+
+    if (size > source->end - source->pos)
+        size = (size_t) (source->end - source->pos);
+    if (size == 0)
+        return 0;
+    do
+        count = pread(source->fd, buf, size, (off_t) source->pos);
+    while (count < 0 && errno == EINTR);
+    if (count > 0)
+        source->pos += (uint64_t) count;
+    return (long) count;
+}
+
+int flv_summarize_fd(int fd, uint64_t size, flv_summary_t *summary) {
+    fd_source_t source = {fd, 0, size};
+    flv_summary_builder_t builder;
+    flv_reader_t reader;
+    flv_header_t header;
+    flv_tag_info_t tag;
+    int ret = 0;
+
+    if (fd < 0 || !summary)
+        return FLV_ERR_INVALID_ARG;
+
+    flv_reader_init(&reader, fd_source_read, &source);
+    flv_reader_set_hash(&reader, 1);
+    ret = flv_reader_read_header(&reader, &header);
+    flv_summary_begin(&builder, ret == FLV_OK ? &header : NULL);
+    while (ret == FLV_OK && (ret = flv_reader_next_tag(&reader, &tag)) == FLV_OK)
+        flv_summary_update(&builder, &tag, 1);
+    flv_summary_end(&builder, size, summary);
+    flv_reader_destroy(&reader);
+    return ret == FLV_EOF ? FLV_OK : ret;
+}
@@ -0,0 +1,109 @@
+#ifndef FLV_SUMMARY_H_
+#define FLV_SUMMARY_H_
+
+/*
+ * Whole-file summary: header flags, codecs, measured duration and bitrate,
+ * keyframe statistics and the interesting onMetaData values. The struct
+ * has a fixed layout, with no pointers or implicit padding, so that it can
+ * be stored as is in catalogs and caches. Fields are in host byte order;
+ * the files holding them record a byte_order marker and refuse to load on
+ * a host that reads it differently.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "flv-core.h"
+#include "flv-hash.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// flv_summary_t.meta_flags: which metadata values were present
+#define FLV_META_DURATION          (1 << 0)
+#define FLV_META_WIDTH             (1 << 1)
+#define FLV_META_HEIGHT            (1 << 2)
+#define FLV_META_FRAMERATE         (1 << 3)
+#define FLV_META_VIDEODATARATE     (1 << 4)
+#define FLV_META_AUDIODATARATE     (1 << 5)
+#define FLV_META_FILESIZE          (1 << 6)
+#define FLV_META_AUDIOSAMPLERATE   (1 << 7)
+#define FLV_META_VIDEOCODECID      (1 << 8)
+#define FLV_META_AUDIOCODECID      (1 << 9)
+
+// flv_summary_t.video_codec / audio_codec when the track is absent
+#define FLV_SUMMARY_NO_CODEC       (0xFF)
+
+typedef struct flv_summary {
+    uint8_t version;               // FLV header version
+    uint8_t type_flags;            // FLV header TypeFlags
+    uint8_t video_codec;           // CodecID of the first video tag
+    uint8_t audio_codec;           // SoundFormat of the first audio tag
+    uint8_t sound_rate;
+    uint8_t sound_size;
+    uint8_t sound_type;
+    uint8_t reserved0;
+    uint32_t tag_count;
+    uint32_t video_tags;
+    uint32_t audio_tags;
+    uint32_t script_tags;
+    uint32_t keyframes;
+    uint32_t max_keyframe_interval;  // Milliseconds
+    uint32_t first_timestamp;        // Milliseconds, over the audio and video tags
+    uint32_t last_timestamp;
+    uint32_t duration;               // Milliseconds, last - first timestamp
+    uint32_t bitrate;                // Kilobits per second over the measured duration
+    uint64_t video_bytes;            // Tag body bytes per track
+    uint64_t audio_bytes;
+    uint64_t content_hash;           // flv_digest file hash
+    uint32_t meta_flags;             // FLV_META_*
+    uint32_t reserved1;
+    double meta_duration;            // Seconds
+    double meta_width;
+    double meta_height;
+    double meta_framerate;
+    double meta_videodatarate;       // Kilobits per second
+    double meta_audiodatarate;
+    double meta_filesize;
+    double meta_audiosamplerate;
+    double meta_videocodecid;
+    double meta_audiocodecid;
+} flv_summary_t;
+
+/*
+ * @brief running state while a summary is being built
+ */
+typedef struct flv_summary_builder {
+    flv_summary_t summary;
+    flv_hash64_state_t hash_state;
+    uint32_t last_keyframe;
+    int seen_keyframe;
+} flv_summary_builder_t;
+
+void flv_summary_begin(flv_summary_builder_t *builder, const flv_header_t *header);
+
+/*
+ * @brief add a tag; uses tag->hash if `hashed`, otherwise hashes the body
+ */
+void flv_summary_update(flv_summary_builder_t *builder, const flv_tag_info_t *tag, int hashed);
+
+void flv_summary_end(flv_summary_builder_t *builder, uint64_t file_size, flv_summary_t *summary);
+
+/*
+ * @brief summarize a whole file held in memory (e.g. mmap()ed). `summary`
+ * is filled in even when an error is returned, covering the tags read.
+ */
+int flv_summarize_memory(const void *data, size_t size, flv_summary_t *summary);
+
+/*
+ * @brief the same for the first `size` bytes of the file open on `fd`, read
+ * with pread(). Unlike a mapping, a file that shrinks meanwhile only ends
+ * the walk early instead of raising SIGBUS.
+ */
+int flv_summarize_fd(int fd, uint64_t size, flv_summary_t *summary);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FLV_SUMMARY_H_
@@ -0,0 +1,69 @@
+#include <stdlib.h>
+#include <string.h>
+#include "flv-tagbuf.h"
+
+static flv_tag_buf_t *tag_buf_alloc(size_t size) {
+    flv_tag_buf_t *buf = malloc(sizeof(flv_tag_buf_t) + size);
+
+    if (!buf)
+        return NULL;
+    atomic_init(&buf->refs, 1);
+    buf->tag_type = 0;
+    buf->flags = 0;
+    buf->timestamp = 0;
+    buf->size = size;
+    return buf;
+}
+
+flv_tag_buf_t *flv_tag_buf_new(const flv_tag_info_t *tag) {
+    flv_tag_buf_t *buf = NULL;
+    size_t tag_size = FLV_TAG_HEADER_SIZE + (size_t) tag->data_size;
+
+    buf = tag_buf_alloc(tag_size + FLV_PREV_TAG_SIZE_SIZE);
+    if (!buf)
+        return NULL;
+
+    flv_encode_tag_header(buf->data, tag);
+    if (tag->data_size)
+        memcpy(buf->data + FLV_TAG_HEADER_SIZE, tag->data, tag->data_size);
+    flv_put_ui32(buf->data + tag_size, (uint32_t) tag_size);
+
+    buf->tag_type = tag->tag_type;
+    buf->timestamp = flv_tag_timestamp(tag);
+    if (tag->tag_type == TAGTYPE_SCRIPTDATAOBJECT)
+        buf->flags |= FLV_TAG_BUF_METADATA;
+    if (tag->tag_type == TAGTYPE_VIDEODATA) {
+        if (tag->frame_type == FLV_FRAME_TYPE_KEY)
+            buf->flags |= FLV_TAG_BUF_KEYFRAME;
+        if (tag->codec_id == FLV_CODEC_ID_AVC && tag->frame_type != FLV_FRAME_TYPE_COMMAND &&
+            tag->avc_packet_type == FLV_AVC_SEQUENCE_HEADER)
+            buf->flags |= FLV_TAG_BUF_SEQUENCE_HEADER;
+    }
+    if (tag->tag_type == TAGTYPE_AUDIODATA && tag->sound_format == FLV_SOUND_FORMAT_AAC &&
+        tag->aac_packet_type == FLV_AAC_SEQUENCE_HEADER)
+        buf->flags |= FLV_TAG_BUF_SEQUENCE_HEADER;
+    return buf;
+}
+
+flv_tag_buf_t *flv_tag_buf_new_raw(const void *data, size_t size) {
+    flv_tag_buf_t *buf = tag_buf_alloc(size);
+
+    if (!buf)
+        return NULL;
+    memcpy(buf->data, data, size);
+    return buf;
+}
+
+flv_tag_buf_t *flv_tag_buf_ref(flv_tag_buf_t *buf) {
+    if (buf)
+        atomic_fetch_add_explicit(&buf->refs, 1, memory_order_relaxed);
+    return buf;
+}
+
+void flv_tag_buf_unref(flv_tag_buf_t *buf) {
+    if (!buf)
+        return;
+    // The last owner must see every write made through the other references
+    if (atomic_fetch_sub_explicit(&buf->refs, 1, memory_order_acq_rel) == 1)
+        free(buf);
+}
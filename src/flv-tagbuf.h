@@ -0,0 +1,50 @@
+#ifndef FLV_TAGBUF_H_
+#define FLV_TAGBUF_H_
+
+/*
+ * Reference-counted, immutable wire copies of FLV tags. One buffer is made
+ * per incoming tag and then shared by every consumer (subscribers, caches)
+ * until the last reference goes away.
+ */
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "flv-core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FLV_TAG_BUF_KEYFRAME         (1 << 0)  // Video keyframe
+#define FLV_TAG_BUF_SEQUENCE_HEADER  (1 << 1)  // AVC or AAC sequence header
+#define FLV_TAG_BUF_METADATA         (1 << 2)  // Script data tag
+
+typedef struct flv_tag_buf {
+    atomic_int refs;
+    uint8_t tag_type;
+    uint8_t flags;             // FLV_TAG_BUF_*
+    uint32_t timestamp;        // Full 32-bit timestamp
+    size_t size;               // Bytes in data
+    uint8_t data[];            // Tag header, body and trailing PreviousTagSize
+} flv_tag_buf_t;
+
+/*
+ * @brief copy `tag` into a new buffer holding one reference
+ */
+flv_tag_buf_t *flv_tag_buf_new(const flv_tag_info_t *tag);
+
+/*
+ * @brief wrap arbitrary bytes (e.g. a stream preamble) in a buffer
+ */
+flv_tag_buf_t *flv_tag_buf_new_raw(const void *data, size_t size);
+
+flv_tag_buf_t *flv_tag_buf_ref(flv_tag_buf_t *buf);
+
+void flv_tag_buf_unref(flv_tag_buf_t *buf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FLV_TAGBUF_H_
@@ -0,0 +1,295 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "flv-validate.h"
+
+// FLV header TypeFlags
+#define TYPE_FLAG_AUDIO    (0x04)
+#define TYPE_FLAG_VIDEO    (0x01)
+#define TYPE_FLAG_RESERVED (0xFA)
+
+// PreviousTagSize followed by the tag header
+#define RECORD_HEADER_SIZE (FLV_PREV_TAG_SIZE_SIZE + FLV_TAG_HEADER_SIZE)
+
+/*
+ * @brief where the headers come from: memory, or a file read through a
+ * small window so that the bodies in between are never read
+ */
+typedef struct validator {
+    const uint8_t *base;
+    int fd;
+    uint8_t *window;
+    uint64_t window_pos;
+    size_t window_len;
+    uint64_t size;
+    flv_issue_fn fn;
+    void *opaque;
+    flv_validate_stats_t stats;
+} validator_t;
+
+/*
+ * @brief `len` bytes at `pos`, which the caller has checked to be inside
+ * the file. NULL on a read error.
+ */
+static const uint8_t *fetch(validator_t *v, uint64_t pos, size_t len) {
+    size_t done = 0;
+
+    if (v->base)
+        return v->base + pos;
+    if (pos >= v->window_pos && pos + len <= v->window_pos + v->window_len)
+        return v->window + (pos - v->window_pos);
+
+    v->window_pos = pos;
+    v->window_len = 0;
+    while (done < len) {
+        ssize_t count = pread(v->fd, v->window + done, FLV_VALIDATE_WINDOW - done, (off_t) (pos + done));
+
+        if (count <= 0)
+            return NULL;
+        done += (size_t) count;
+    }
+    v->window_len = done;
+    return v->window;
+}
+
+static int report(validator_t *v, int code, uint64_t offset, uint32_t tag_index,
+                  uint64_t expected, uint64_t actual) {
+    flv_issue_t issue;
+
+    v->stats.issues++;
+    if (!v->fn)
+        return 0;
+    issue.code = code;
+    issue.offset = offset;
+    issue.tag_index = tag_index;
+    issue.expected = expected;
+    issue.actual = actual;
+    return v->fn(v->opaque, &issue);
+}
+
+const char *flv_issue_name(int code) {
+    switch (code) {
+        case FLV_ISSUE_SIGNATURE:
+            return "bad signature";
+        case FLV_ISSUE_VERSION:
+            return "unexpected header version";
+        case FLV_ISSUE_HEADER_RESERVED:
+            return "reserved TypeFlags bits set";
+        case FLV_ISSUE_DATA_OFFSET:
+            return "DataOffset smaller than the header";
+        case FLV_ISSUE_PREV_TAG_SIZE:
+            return "PreviousTagSize mismatch";
+        case FLV_ISSUE_TAG_RESERVED:
+            return "reserved tag header bits set";
+        case FLV_ISSUE_TAG_TYPE:
+            return "unknown tag type";
+        case FLV_ISSUE_STREAM_ID:
+            return "StreamID not 0";
+        case FLV_ISSUE_EMPTY_TAG:
+            return "empty audio/video tag";
+        case FLV_ISSUE_TIMESTAMP:
+            return "timestamp goes backwards";
+        case FLV_ISSUE_AUDIO_FLAG:
+            return "TypeFlagsAudio does not match the tags";
+        case FLV_ISSUE_VIDEO_FLAG:
+            return "TypeFlagsVideo does not match the tags";
+        case FLV_ISSUE_TRUNCATED:
+            return "file ends inside a tag";
+        default:
+            return "unknown issue";
+    }
+}
+
+#define REPORT(code, offset, index, expected, actual) \
+    do { \
+        if ((ret = report(v, code, offset, index, expected, actual)) != 0) \
+            goto done; \
+    } while (0)
+
+/*
+ * @brief follow the tag chain of v->size bytes
+ */
+static int validate(validator_t *v) {
+    const uint8_t *p = NULL;
+    flv_header_t header;
+    uint64_t size = v->size;
+    uint64_t pos = 0;
+    uint64_t first_audio = 0;      // Offset of the first tag of each track
+    uint64_t first_video = 0;
+    uint32_t first_audio_index = 0;
+    uint32_t first_video_index = 0;
+    uint32_t expected_prev = 0;    // PreviousTagSize0 is always 0
+    uint32_t last_audio_ts = 0;
+    uint32_t last_video_ts = 0;
+    int ret = 0;
+
+    if (size < FLV_HEADER_SIZE) {
+        ret = report(v, FLV_ISSUE_TRUNCATED, size, 0, FLV_HEADER_SIZE, size);
+        goto done;
+    }
+    if (!(p = fetch(v, 0, FLV_HEADER_SIZE))) {
+        ret = FLV_ERR_IO;
+        goto done;
+    }
+    ret = flv_decode_header(p, FLV_HEADER_SIZE, &header);
+    if (ret == FLV_ERR_SIGNATURE) {
+        ret = report(v, FLV_ISSUE_SIGNATURE, 0, 0, 0, 0);
+        goto done;
+    }
+    // A DataOffset below 9 is reported below; the fields are decoded anyway
+    ret = 0;
+    if (header.version != 1)
+        REPORT(FLV_ISSUE_VERSION, 3, 0, 1, header.version);
+    if (header.type_flags & TYPE_FLAG_RESERVED)
+        REPORT(FLV_ISSUE_HEADER_RESERVED, 4, 0, 0, header.type_flags & TYPE_FLAG_RESERVED);
+    pos = header.data_offset;
+    if (pos < FLV_HEADER_SIZE) {
+        REPORT(FLV_ISSUE_DATA_OFFSET, 5, 0, FLV_HEADER_SIZE, pos);
+        pos = FLV_HEADER_SIZE;
+    }
+    if (pos > size) {
+        REPORT(FLV_ISSUE_TRUNCATED, size, 0, pos, size);
+        goto done;
+    }
+
+    for (; ;) {
+        uint32_t index = v->stats.tags + 1;
+        uint32_t prev_tag_size = 0;
+        uint32_t data_size = 0;
+        uint32_t timestamp = 0;
+        uint32_t stream_id = 0;
+        uint8_t tag_type = 0;
+
+        if (size - pos < FLV_PREV_TAG_SIZE_SIZE) {
+            REPORT(FLV_ISSUE_TRUNCATED, pos, index, FLV_PREV_TAG_SIZE_SIZE, size - pos);
+            break;
+        }
+        // PreviousTagSize and the tag header are fetched together
+        p = fetch(v, pos, size - pos < RECORD_HEADER_SIZE ? FLV_PREV_TAG_SIZE_SIZE : RECORD_HEADER_SIZE);
+        if (!p) {
+            ret = FLV_ERR_IO;
+            goto done;
+        }
+        prev_tag_size = flv_get_ui32(p);
+        if (prev_tag_size != expected_prev)
+            REPORT(FLV_ISSUE_PREV_TAG_SIZE, pos, index - 1, expected_prev, prev_tag_size);
+        pos += FLV_PREV_TAG_SIZE_SIZE;
+        p += FLV_PREV_TAG_SIZE_SIZE;
+        if (pos == size)
+            break;
+
+        // Only the 11-byte tag header is looked at, bodies are skipped
+        if (size - pos < FLV_TAG_HEADER_SIZE) {
+            REPORT(FLV_ISSUE_TRUNCATED, pos, index, FLV_TAG_HEADER_SIZE, size - pos);
+            break;
+        }
+        tag_type = p[0] & 0x1F;
+        data_size = flv_get_ui24(p + 1);
+        timestamp = flv_get_ui24(p + 4) | ((uint32_t) p[7] << 24);
+        stream_id = flv_get_ui24(p + 8);
+        v->stats.tags++;
+
+        if (p[0] & 0xC0)
+            REPORT(FLV_ISSUE_TAG_RESERVED, pos, index, 0, p[0] & 0xC0);
+        if (stream_id != 0)
+            REPORT(FLV_ISSUE_STREAM_ID, pos + 8, index, 0, stream_id);
+        switch (tag_type) {
+            case TAGTYPE_AUDIODATA:
+                if (v->stats.audio_tags++ == 0) {
+                    first_audio = pos;
+                    first_audio_index = index;
+                } else if (timestamp < last_audio_ts)
+                    REPORT(FLV_ISSUE_TIMESTAMP, pos + 4, index, last_audio_ts, timestamp);
+                last_audio_ts = timestamp;
+                if (data_size == 0)
+                    REPORT(FLV_ISSUE_EMPTY_TAG, pos + 1, index, 1, 0);
+                break;
+            case TAGTYPE_VIDEODATA:
+                if (v->stats.video_tags++ == 0) {
+                    first_video = pos;
+                    first_video_index = index;
+                } else if (timestamp < last_video_ts)
+                    REPORT(FLV_ISSUE_TIMESTAMP, pos + 4, index, last_video_ts, timestamp);
+                last_video_ts = timestamp;
+                if (data_size == 0)
+                    REPORT(FLV_ISSUE_EMPTY_TAG, pos + 1, index, 1, 0);
+                break;
+            case TAGTYPE_SCRIPTDATAOBJECT:
+                break;
+            default:
+                REPORT(FLV_ISSUE_TAG_TYPE, pos, index, 0, tag_type);
+                break;
+        }
+
+        if (size - pos - FLV_TAG_HEADER_SIZE < data_size) {
+            REPORT(FLV_ISSUE_TRUNCATED, pos + FLV_TAG_HEADER_SIZE, index, data_size,
+                   size - pos - FLV_TAG_HEADER_SIZE);
+            break;
+        }
+        pos += FLV_TAG_HEADER_SIZE + data_size;
+        expected_prev = FLV_TAG_HEADER_SIZE + data_size;
+    }
+
+    // The header flags must announce exactly the tracks present
+    if (!(header.type_flags & TYPE_FLAG_AUDIO) != !v->stats.audio_tags)
+        REPORT(FLV_ISSUE_AUDIO_FLAG, v->stats.audio_tags ? first_audio : 4, first_audio_index,
+               !!v->stats.audio_tags, !!(header.type_flags & TYPE_FLAG_AUDIO));
+    if (!(header.type_flags & TYPE_FLAG_VIDEO) != !v->stats.video_tags)
+        REPORT(FLV_ISSUE_VIDEO_FLAG, v->stats.video_tags ? first_video : 4, first_video_index,
+               !!v->stats.video_tags, !!(header.type_flags & TYPE_FLAG_VIDEO));
+
+done:
+    v->stats.bytes = pos < size ? pos : size;
+    return ret;
+}
+
+int flv_validate_memory(const void *data, size_t size, flv_issue_fn fn, void *opaque,
+                        flv_validate_stats_t *stats) {
+    validator_t v;
+    int ret = 0;
+
+    if (!data && size)
+        return FLV_ERR_INVALID_ARG;
+    memset(&v, 0, sizeof(v));
+    v.base = (const uint8_t *) data;
+    v.size = size;
+    v.fn = fn;
+    v.opaque = opaque;
+    ret = validate(&v);
+    if (stats)
+        *stats = v.stats;
+    return ret;
+}
+
+int flv_validate_file(const char *path, flv_issue_fn fn, void *opaque, flv_validate_stats_t *stats) {
+    validator_t v;
+    struct stat st;
+    int ret = 0;
+
+    if (!path)
+        return FLV_ERR_INVALID_ARG;
+    memset(&v, 0, sizeof(v));
+    v.fd = open(path, O_RDONLY);
+    if (v.fd < 0)
+        return FLV_ERR_IO;
+    v.window = malloc(FLV_VALIDATE_WINDOW);
+    if (!v.window) {
+        close(v.fd);
+        return FLV_ERR_NOMEM;
+    }
+    if (fstat(v.fd, &st) != 0) {
+        ret = FLV_ERR_IO;
+    } else {
+        v.size = (uint64_t) st.st_size;
+        v.fn = fn;
+        v.opaque = opaque;
+        ret = validate(&v);
+    }
+    if (stats)
+        *stats = v.stats;
+    free(v.window);
+    close(v.fd);
+    return ret;
+}
@@ -0,0 +1,85 @@
+#ifndef FLV_VALIDATE_H_
+#define FLV_VALIDATE_H_
+
+/*
+ * Structural conformance checks. The validator walks the chain of tag
+ * headers only and jumps over the bodies, so a file is read a small window
+ * at a time and tag bodies larger than the window are never read at all.
+ * Every problem is reported with its byte offset and the walk goes on;
+ * only a chain that can no longer be followed (bad signature, a tag
+ * running past the end of the file) stops it.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "flv-core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Read size of flv_validate_file; consecutive small tags share one read
+#define FLV_VALIDATE_WINDOW (16 << 10)
+
+enum flv_issue_code {
+    FLV_ISSUE_SIGNATURE = 1,       // File does not start with "FLV"
+    FLV_ISSUE_VERSION,             // Header version is not 1
+    FLV_ISSUE_HEADER_RESERVED,     // Reserved TypeFlags bits are set
+    FLV_ISSUE_DATA_OFFSET,         // DataOffset is smaller than the header
+    FLV_ISSUE_PREV_TAG_SIZE,       // PreviousTagSize != 11 + DataSize of the previous tag
+    FLV_ISSUE_TAG_RESERVED,        // Reserved tag header bits are set
+    FLV_ISSUE_TAG_TYPE,            // TagType is not audio, video or script data
+    FLV_ISSUE_STREAM_ID,           // StreamID is not 0
+    FLV_ISSUE_EMPTY_TAG,           // Audio or video tag with no body
+    FLV_ISSUE_TIMESTAMP,           // Timestamp goes backwards within a track
+    FLV_ISSUE_AUDIO_FLAG,          // TypeFlagsAudio does not match the audio tags present
+    FLV_ISSUE_VIDEO_FLAG,          // TypeFlagsVideo does not match the video tags present
+    FLV_ISSUE_TRUNCATED            // File ends inside a tag or PreviousTagSize
+};
+
+typedef struct flv_issue {
+    int code;                  // enum flv_issue_code
+    uint64_t offset;           // Byte offset of the offending field
+    uint32_t tag_index;        // 1-based tag number, 0 for the file header
+    uint64_t expected;         // Meaning depends on the code, see flv_issue_describe
+    uint64_t actual;
+} flv_issue_t;
+
+/*
+ * @brief called for every issue found. Returning non-zero stops the walk
+ * and that value is handed back by the validator.
+ */
+typedef int (*flv_issue_fn)(void *opaque, const flv_issue_t *issue);
+
+typedef struct flv_validate_stats {
+    uint32_t tags;
+    uint32_t audio_tags;
+    uint32_t video_tags;
+    uint32_t issues;
+    uint64_t bytes;            // Bytes covered by the walk
+} flv_validate_stats_t;
+
+/*
+ * @brief one line description of an issue code
+ */
+const char *flv_issue_name(int code);
+
+/*
+ * @brief check a whole file held in memory. `fn` and `stats` may be NULL.
+ * Returns FLV_OK once the walk is complete (whether or not issues were
+ * found) or the value `fn` stopped with.
+ */
+int flv_validate_memory(const void *data, size_t size, flv_issue_fn fn, void *opaque,
+                        flv_validate_stats_t *stats);
+
+/*
+ * @brief validate the file at `path`, reading only around the tag headers.
+ * Returns FLV_ERR_IO if the file cannot be read.
+ */
+int flv_validate_file(const char *path, flv_issue_fn fn, void *opaque, flv_validate_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FLV_VALIDATE_H_
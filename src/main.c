@@ -1,20 +1,59 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "flv-parser.h"
 
 void usage(char *program_name) {
-    printf("Usage: %s [input.flv]\n", program_name);
+    printf("Usage: %s [-p | -d | -a | -m bytes | -s samples | -c cache_dir] [input.flv]\n", program_name);
+    printf("  -p          pipeline mode: read, parse and print on separate threads\n");
+    printf("  -d          print per-GOP and per-file content digests instead of the tags\n");
+    printf("  -a          analyze the audio frames: exact duration and timestamp drift\n");
+    printf("  -m bytes    read tag bodies in chunks of at most this size, bounding memory\n");
+    printf("  -s samples  estimate bitrate, frame rate and GOP length from this many windows\n");
+    printf("  -c dir      print the summary, index and metadata, cached in dir for unchanged files\n");
     exit(-1);
 }
 
 int main(int argc, char **argv) {
 
     FILE *infile = NULL;
+    int pipeline = 0;
+    int digest = 0;
+    int audio = 0;
+    size_t max_buffer = 0;
+    uint32_t samples = 0;
+    const char *cache_dir = NULL;
+    int argi = 1;
+    int ret = 0;
 
-    if (argc == 1) {
+    if (argi < argc && strcmp(argv[argi], "-p") == 0) {
+        pipeline = 1;
+        argi++;
+    } else if (argi < argc && strcmp(argv[argi], "-d") == 0) {
+        digest = 1;
+        argi++;
+    } else if (argi < argc && strcmp(argv[argi], "-a") == 0) {
+        audio = 1;
+        argi++;
+    } else if (argi + 1 < argc && strcmp(argv[argi], "-m") == 0) {
+        max_buffer = (size_t) strtoul(argv[argi + 1], NULL, 10);
+        if (max_buffer == 0)
+            usage(argv[0]);
+        argi += 2;
+    } else if (argi + 1 < argc && strcmp(argv[argi], "-s") == 0) {
+        samples = (uint32_t) strtoul(argv[argi + 1], NULL, 10);
+        if (samples == 0)
+            usage(argv[0]);
+        argi += 2;
+    } else if (argi + 1 < argc && strcmp(argv[argi], "-c") == 0) {
+        cache_dir = argv[argi + 1];
+        argi += 2;
+    }
+
+    if (argi == argc) {
         infile = stdin;
     } else {
-        infile = fopen(argv[1], "rb");
+        infile = fopen(argv[argi], "rb");
         if (!infile) {
             usage(argv[0]);
         }
@@ -22,12 +61,29 @@ int main(int argc, char **argv) {
 
     flv_parser_init(infile);
 
-    flv_parser_run();
+    if (cache_dir)
+        ret = flv_parser_run_cached(cache_dir);
+    else if (digest)
+        ret = flv_parser_run_digest();
+    else if (samples)
+        ret = flv_parser_run_estimate(samples);
+    else if (audio)
+        ret = flv_parser_run_audio();
+    else if (max_buffer)
+        ret = flv_parser_run_chunked(max_buffer);
+    else
+        ret = pipeline ? flv_parser_run_pipeline() : flv_parser_run();
     
     // MUST CLOSE the OPEND FILE 
     fclose(infile);
 
-    printf("\nFinished analyzing\n");
+    if (ret != FLV_OK) {
+        fprintf(stderr, "Error: %s\n", flv_strerror(ret));
+        return 1;
+    }
+
+    if (!digest && !audio && !samples && !cache_dir)
+        printf("\nFinished analyzing\n");
 
     return 0;
 }
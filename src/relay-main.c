@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "flv-relay.h"
+
+// How long to keep flushing queued data after the input ended
+#define DRAIN_TIMEOUT_MS (5000)
+
+void usage(char *program_name) {
+    printf("Usage: %s [-l port] [-a address] [-r] [-w count] [input.flv]\n", program_name);
+    printf("  -l port     listen for HTTP-FLV clients on this port (default 8080)\n");
+    printf("  -a address  bind address (default any)\n");
+    printf("  -r          pace the input by its timestamps, for relaying a file as live\n");
+    printf("  -w count    wait for this many subscribers before reading the input\n");
+    exit(-1);
+}
+
+static int64_t now_ms(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int main(int argc, char **argv) {
+    FILE *infile = stdin;
+    const char *address = NULL;
+    int port = 8080;
+    int realtime = 0;
+    int wait_count = 0;
+    flv_relay_t *relay = NULL;
+    flv_reader_t reader;
+    flv_header_t header;
+    flv_tag_info_t tag;
+    flv_relay_stats_t stats;
+    int64_t start = 0;
+    int64_t deadline = 0;
+    int first = 1;
+    uint32_t first_ts = 0;
+    int ret = 0;
+    int i = 1;
+
+    for (; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; ++i) {
+        if (strcmp(argv[i], "-r") == 0)
+            realtime = 1;
+        else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc)
+            port = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc)
+            address = argv[++i];
+        else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+            wait_count = atoi(argv[++i]);
+        else
+            usage(argv[0]);
+    }
+    if (i < argc) {
+        infile = fopen(argv[i], "rb");
+        if (!infile)
+            usage(argv[0]);
+    }
+
+    relay = flv_relay_create(NULL);
+    if (!relay) {
+        fprintf(stderr, "Error: %s\n", flv_strerror(FLV_ERR_NOMEM));
+        return 1;
+    }
+    ret = flv_relay_listen(relay, address, (uint16_t) port);
+    if (ret != FLV_OK) {
+        fprintf(stderr, "Error: cannot listen on port %d: %s\n", port, flv_strerror(ret));
+        flv_relay_destroy(relay);
+        return 1;
+    }
+    fprintf(stderr, "Relaying on port %d\n", flv_relay_port(relay));
+
+    while (ret >= 0 && ret < wait_count)
+        ret = flv_relay_poll(relay, 100);
+
+    flv_reader_init_file(&reader, infile);
+    ret = flv_reader_read_header(&reader, &header);
+    if (ret == FLV_OK)
+        ret = flv_relay_set_header(relay, &header);
+
+    while (ret == FLV_OK) {
+        ret = flv_reader_next_tag(&reader, &tag);
+        if (ret != FLV_OK)
+            break;
+        if (realtime) {
+            int64_t due = 0;
+
+            if (first) {
+                start = now_ms();
+                first_ts = flv_tag_timestamp(&tag);
+                first = 0;
+            }
+            due = start + (int64_t) (flv_tag_timestamp(&tag) - first_ts);
+            while (now_ms() < due)
+                flv_relay_poll(relay, (int) (due - now_ms()));
+        } else {
+            flv_relay_poll(relay, 0);
+        }
+        ret = flv_relay_publish(relay, &tag);
+    }
+
+    // Let the subscribers receive what is still queued
+    deadline = now_ms() + DRAIN_TIMEOUT_MS;
+    while (flv_relay_pending(relay) > 0 && now_ms() < deadline)
+        flv_relay_poll(relay, 100);
+
+    flv_relay_get_stats(relay, &stats);
+    fprintf(stderr, "Published %llu tags, sent %llu bytes, dropped %llu tags, %llu disconnects\n",
+            (unsigned long long) stats.tags_published, (unsigned long long) stats.bytes_sent,
+            (unsigned long long) stats.tags_dropped, (unsigned long long) stats.disconnects);
+
+    flv_reader_destroy(&reader);
+    flv_relay_destroy(relay);
+    if (infile != stdin)
+        fclose(infile);
+
+    if (ret != FLV_EOF) {
+        fprintf(stderr, "Error: %s\n", flv_strerror(ret));
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,202 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "flv-validate.h"
+
+// Issues printed per file before the rest are only counted
+#define DEFAULT_MAX_ISSUES (100)
+
+void usage(char *program_name) {
+    printf("Usage: %s [-j threads] [-n max_issues] [-q] [input.flv ...]\n", program_name);
+    printf("  checks the structure of every file and reports each issue with its byte offset\n");
+    printf("  the file list is read from stdin, one per line, when none is given\n");
+    printf("  -j threads     files validated in parallel (default: number of CPUs)\n");
+    printf("  -n max_issues  issues printed per file (default %d)\n", DEFAULT_MAX_ISSUES);
+    printf("  -q             print only the names of files with issues\n");
+    exit(-1);
+}
+
+typedef struct job_list {
+    char **paths;
+    size_t count;
+    atomic_size_t next;        // Next path to hand out
+    uint32_t max_issues;
+    int quiet;
+    pthread_mutex_t output;    // Keeps the lines of one file together
+    atomic_uint bad_files;
+    atomic_uint failed_files;
+} job_list_t;
+
+/*
+ * @brief output of one file, printed in one go once it is complete
+ */
+typedef struct report_buf {
+    const char *path;
+    char *text;
+    size_t len;
+    size_t capacity;
+    uint32_t printed;
+    uint32_t max_issues;
+} report_buf_t;
+
+static void report_append(report_buf_t *buf, const char *line, size_t len) {
+    if (buf->len + len > buf->capacity) {
+        size_t capacity = buf->capacity ? buf->capacity * 2 : 1024;
+        char *text = NULL;
+
+        while (capacity < buf->len + len)
+            capacity *= 2;
+        text = realloc(buf->text, capacity);
+        if (!text)
+            return;
+        buf->text = text;
+        buf->capacity = capacity;
+    }
+    memcpy(buf->text + buf->len, line, len);
+    buf->len += len;
+}
+
+static int collect_issue(void *opaque, const flv_issue_t *issue) {
+    report_buf_t *buf = (report_buf_t *) opaque;
+    char line[1024];
+    int len = 0;
+
+    if (buf->printed++ >= buf->max_issues)
+        return 0;
+    len = snprintf(line, sizeof(line), "%s:%llu: tag %u: %s (expected %llu, found %llu)\n", buf->path,
+                   (unsigned long long) issue->offset, issue->tag_index, flv_issue_name(issue->code),
+                   (unsigned long long) issue->expected, (unsigned long long) issue->actual);
+    if (len > 0)
+        report_append(buf, line, (size_t) len < sizeof(line) ? (size_t) len : sizeof(line) - 1);
+    return 0;
+}
+
+static void *validate_worker(void *arg) {
+    job_list_t *jobs = (job_list_t *) arg;
+
+    for (; ;) {
+        size_t i = atomic_fetch_add_explicit(&jobs->next, 1, memory_order_relaxed);
+        flv_validate_stats_t stats;
+        report_buf_t buf;
+        int ret = 0;
+
+        if (i >= jobs->count)
+            return NULL;
+        memset(&buf, 0, sizeof(buf));
+        buf.path = jobs->paths[i];
+        buf.max_issues = jobs->quiet ? 0 : jobs->max_issues;
+        ret = flv_validate_file(buf.path, collect_issue, &buf, &stats);
+
+        pthread_mutex_lock(&jobs->output);
+        if (ret != FLV_OK) {
+            atomic_fetch_add(&jobs->failed_files, 1);
+            fprintf(stderr, "%s: %s\n", buf.path, flv_strerror(ret));
+        } else if (stats.issues > 0) {
+            atomic_fetch_add(&jobs->bad_files, 1);
+            if (jobs->quiet) {
+                printf("%s\n", buf.path);
+            } else {
+                fwrite(buf.text, 1, buf.len, stdout);
+                if (stats.issues > jobs->max_issues)
+                    printf("%s: %u more issues\n", buf.path, stats.issues - jobs->max_issues);
+            }
+        }
+        pthread_mutex_unlock(&jobs->output);
+        free(buf.text);
+    }
+}
+
+/*
+ * @brief read the file list from stdin
+ */
+static char **read_paths(size_t *count) {
+    char **paths = NULL;
+    size_t capacity = 0;
+    char line[4096];
+
+    *count = 0;
+    while (fgets(line, sizeof(line), stdin)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0')
+            continue;
+        if (*count == capacity) {
+            char **grown = realloc(paths, (capacity ? capacity * 2 : 256) * sizeof(char *));
+
+            if (!grown)
+                break;
+            paths = grown;
+            capacity = capacity ? capacity * 2 : 256;
+        }
+        paths[*count] = strdup(line);
+        if (!paths[*count])
+            break;
+        ++*count;
+    }
+    return paths;
+}
+
+int main(int argc, char **argv) {
+    job_list_t jobs;
+    pthread_t *threads = NULL;
+    long thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+    long started = 1;
+    int from_stdin = 0;
+    int i = 1;
+
+    memset(&jobs, 0, sizeof(jobs));
+    jobs.max_issues = DEFAULT_MAX_ISSUES;
+    for (; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; ++i) {
+        if (strcmp(argv[i], "-q") == 0)
+            jobs.quiet = 1;
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            thread_count = atol(argv[++i]);
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            jobs.max_issues = (uint32_t) atol(argv[++i]);
+        else
+            usage(argv[0]);
+    }
+    if (i < argc) {
+        jobs.paths = argv + i;
+        jobs.count = (size_t) (argc - i);
+    } else {
+        jobs.paths = read_paths(&jobs.count);
+        from_stdin = 1;
+    }
+    if (thread_count < 1)
+        thread_count = 1;
+    if ((size_t) thread_count > jobs.count)
+        thread_count = jobs.count ? (long) jobs.count : 1;
+
+    atomic_init(&jobs.next, 0);
+    atomic_init(&jobs.bad_files, 0);
+    atomic_init(&jobs.failed_files, 0);
+    pthread_mutex_init(&jobs.output, NULL);
+    threads = calloc((size_t) thread_count, sizeof(pthread_t));
+    if (!threads) {
+        fprintf(stderr, "Error: %s\n", flv_strerror(FLV_ERR_NOMEM));
+        return 1;
+    }
+    // The main thread takes a share of the work too
+    for (; started < thread_count; ++started) {
+        if (pthread_create(&threads[started], NULL, validate_worker, &jobs) != 0)
+            break;
+    }
+    validate_worker(&jobs);
+    for (long t = 1; t < started; ++t)
+        pthread_join(threads[t], NULL);
+
+    fprintf(stderr, "%lu files, %u with issues, %u unreadable\n", (unsigned long) jobs.count,
+            atomic_load(&jobs.bad_files), atomic_load(&jobs.failed_files));
+
+    pthread_mutex_destroy(&jobs.output);
+    free(threads);
+    if (from_stdin) {
+        for (size_t j = 0; j < jobs.count; ++j)
+            free(jobs.paths[j]);
+        free(jobs.paths);
+    }
+    return (atomic_load(&jobs.bad_files) || atomic_load(&jobs.failed_files)) ? 1 : 0;
+}
@@ -0,0 +1,41 @@
+# Run flv_parser -c three times on a copy of INPUT: the first run builds the
+# entry, the second must hit it, and after touching the copy the third must
+# replace the stale entry. Apart from the Cache: line the output must agree.
+#   cmake -DPARSER=... -DINPUT=... -DWORK_DIR=... -P cache-hit.cmake
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR})
+get_filename_component(name ${INPUT} NAME)
+set(copy ${WORK_DIR}/${name})
+file(COPY ${INPUT} DESTINATION ${WORK_DIR})
+
+function(run_cached expected output_var)
+    execute_process(COMMAND ${PARSER} -c ${WORK_DIR}/cache ${copy}
+                    OUTPUT_VARIABLE output ERROR_VARIABLE error RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "flv_parser -c ${copy} exited with ${result}: ${error}")
+    endif()
+    if(NOT error STREQUAL "")
+        message(FATAL_ERROR "flv_parser -c ${copy}: ${error}")
+    endif()
+    string(FIND "${output}" "Cache: ${expected}\n" found)
+    if(found EQUAL -1)
+        message(FATAL_ERROR "flv_parser -c ${copy}: expected \"Cache: ${expected}\" in\n${output}")
+    endif()
+    string(REPLACE "Cache: ${expected}\n" "" output "${output}")
+    set(${output_var} "${output}" PARENT_SCOPE)
+endfunction()
+
+run_cached("miss" miss)
+run_cached("hit" hit)
+# Let the clock move past the copy's mtime before touching it
+execute_process(COMMAND ${CMAKE_COMMAND} -E sleep 1)
+execute_process(COMMAND ${CMAKE_COMMAND} -E touch ${copy})
+run_cached("stale entry replaced" stale)
+if(NOT hit STREQUAL miss OR NOT stale STREQUAL miss)
+    message(FATAL_ERROR "flv_parser -c ${copy}: a cached run differs from the first")
+endif()
+file(GLOB entries ${WORK_DIR}/cache/*)
+list(LENGTH entries count)
+if(NOT count EQUAL 1)
+    message(FATAL_ERROR "flv_parser -c ${copy}: ${count} files in the cache, expected 1")
+endif()
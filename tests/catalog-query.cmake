@@ -0,0 +1,38 @@
+# Index the samples and a missing file into a catalog with flv_catalog,
+# then check how many records each query condition matches.
+#   cmake -DCATALOG=... -DSAMPLE_DIR=... -DOUTPUT=... -P catalog-query.cmake
+file(REMOVE ${OUTPUT})
+execute_process(COMMAND ${CATALOG} index ${OUTPUT} ${SAMPLE_DIR}/sample1.flv ${SAMPLE_DIR}/barsandtone.flv
+                        ${OUTPUT}.missing.flv
+                RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "flv_catalog index exited with ${result}")
+endif()
+
+# Conditions (space separated) and the records they must match, of the
+# 3 indexed: sample1 (24.97 s, 661 kbit/s, 2 s GOPs, onMetaData within
+# 0.1%), barsandtone (6.06 s, 117 kbit/s, 6 s GOP, onMetaData 1% short)
+# and the missing file (no codecs, no metadata, all zero)
+set(queries
+    "|3"
+    "video=4|2" "video=7|0" "audio=2|2" "audio=none|1"
+    "min-duration=10|1" "max-duration=10|2"
+    "min-bitrate=500|1" "max-bitrate=200|2"
+    "max-gop=3000|2"
+    "meta-mismatch=0.5|2" "meta-mismatch=2|1"
+    "errors|1"
+    "video=4 min-duration=5 max-bitrate=200|1")
+foreach(query ${queries})
+    string(REGEX MATCH "^(.*)\\|([0-9]+)$" query "${query}")
+    set(conditions "${CMAKE_MATCH_1}")
+    set(expected ${CMAKE_MATCH_2})
+    string(REPLACE " " ";" args "${conditions}")
+    execute_process(COMMAND ${CATALOG} query ${OUTPUT} ${args}
+                    OUTPUT_VARIABLE output ERROR_VARIABLE error RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "flv_catalog query ${conditions} exited with ${result}")
+    endif()
+    if(NOT error MATCHES "(^|\n)${expected} of 3 files matched\n$")
+        message(FATAL_ERROR "flv_catalog query ${conditions}: expected ${expected} of 3, got\n${error}")
+    endif()
+endforeach()
@@ -0,0 +1,12 @@
+# Run flv_parser with ARGS on INPUT and compare the MD5 of its output with
+# EXPECTED, recorded from a known-good parser.
+#   cmake -DPARSER=... -DARGS="-p" -DINPUT=... -DOUTPUT=... -DEXPECTED=... -P dump-md5.cmake
+string(REPLACE " " ";" args "${ARGS}")
+execute_process(COMMAND ${PARSER} ${args} ${INPUT} OUTPUT_FILE ${OUTPUT} RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "flv_parser ${ARGS} ${INPUT} exited with ${result}")
+endif()
+file(MD5 ${OUTPUT} md5)
+if(NOT md5 STREQUAL EXPECTED)
+    message(FATAL_ERROR "flv_parser ${ARGS} ${INPUT}: dump ${md5} differs from the baseline ${EXPECTED}")
+endif()
@@ -0,0 +1,14 @@
+# Run flv_edit with ARGS, writing OUTPUT from INPUTS, then check OUTPUT
+# with flv_validate. ARGS and INPUTS are space separated.
+#   cmake -DEDIT=... -DVALIDATE=... -DARGS="filter -a" -DOUTPUT=... -DINPUTS="a.flv b.flv" -P edit-validate.cmake
+string(REPLACE " " ";" args "${ARGS}")
+string(REPLACE " " ";" inputs "${INPUTS}")
+file(REMOVE ${OUTPUT})
+execute_process(COMMAND ${EDIT} ${args} ${OUTPUT} ${inputs} RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "flv_edit ${ARGS} exited with ${result}")
+endif()
+execute_process(COMMAND ${VALIDATE} ${OUTPUT} RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "flv_edit ${ARGS}: flv_validate found issues in ${OUTPUT}")
+endif()
@@ -0,0 +1,170 @@
+#include <math.h>
+#include "flv-audio.h"
+#include "test-util.h"
+
+#define MP3_FRAME_SIZE (417)   // MPEG-1 layer 3, 128 kbit/s, 44.1 kHz, no padding
+
+static void check_aac(const uint8_t *data, size_t size, int object_type, int extension_type,
+                      int channels, uint32_t sample_rate, uint32_t output_rate, int frame_length) {
+    flv_aac_config_t config;
+
+    CHECK(flv_aac_parse_config(data, size, &config) == FLV_OK);
+    CHECK(config.object_type == object_type && config.extension_type == extension_type);
+    CHECK(config.channel_config == channels);
+    CHECK(config.sample_rate == sample_rate && config.output_rate == output_rate);
+    CHECK(config.frame_length == frame_length);
+}
+
+static void test_aac_config(void) {
+    // LC, 44.1 kHz, stereo
+    static const uint8_t lc[] = {0x12, 0x10};
+    // LC, 48 kHz, stereo, frameLengthFlag set
+    static const uint8_t lc_960[] = {0x11, 0x94};
+    // Explicit SBR: 24 kHz LC core, 48 kHz output
+    static const uint8_t he_aac[] = {0x2B, 0x11, 0x88};
+    // Object type 31 escape to 42, sampling index 15 with 44000 Hz, mono
+    static const uint8_t escapes[] = {0xF9, 0x5E, 0x01, 0x57, 0xC0, 0x20};
+    // Sampling index 13 is reserved
+    static const uint8_t reserved_rate[] = {0x16, 0x90};
+    flv_aac_config_t config;
+
+    check_aac(lc, sizeof(lc), FLV_AAC_OBJECT_LC, 0, 2, 44100, 44100, 1024);
+    check_aac(lc_960, sizeof(lc_960), FLV_AAC_OBJECT_LC, 0, 2, 48000, 48000, 960);
+    check_aac(he_aac, sizeof(he_aac), FLV_AAC_OBJECT_LC, FLV_AAC_OBJECT_SBR, 2, 24000, 48000, 1024);
+    check_aac(escapes, sizeof(escapes), 42, 0, 1, 44000, 44000, 1024);
+    CHECK(flv_aac_parse_config(reserved_rate, sizeof(reserved_rate), &config) == FLV_ERR_MALFORMED);
+    CHECK(flv_aac_parse_config(lc, 1, &config) == FLV_ERR_TRUNCATED);
+    CHECK(flv_aac_parse_config(escapes, 3, &config) == FLV_ERR_TRUNCATED);
+}
+
+/*
+ * @brief a frame header; version_bits 3 = MPEG-1, 2 = MPEG-2, 0 = MPEG-2.5
+ * and layer_bits 3 = layer 1 ... 1 = layer 3, as coded
+ */
+static void mp3_header(uint8_t *p, int version_bits, int layer_bits, int bitrate_index, int rate_index,
+                       int padding, int mono) {
+    p[0] = 0xFF;
+    p[1] = (uint8_t) (0xE0 | version_bits << 3 | layer_bits << 1 | 1);
+    p[2] = (uint8_t) (bitrate_index << 4 | rate_index << 2 | padding << 1);
+    p[3] = mono ? 0xC0 : 0x00;
+}
+
+static void test_mp3_header(void) {
+    static const struct {
+        int version_bits, layer_bits, bitrate_index, rate_index, padding;
+        uint8_t version, layer;
+        uint32_t bitrate, sample_rate, samples, frame_size;
+    } cases[] = {
+        {3, 1, 9, 0, 0, 1, 3, 128, 44100, 1152, 417},
+        {3, 1, 9, 0, 1, 1, 3, 128, 44100, 1152, 418},
+        {3, 2, 10, 1, 0, 1, 2, 192, 48000, 1152, 576},
+        {3, 3, 8, 2, 0, 1, 1, 256, 32000, 384, 384},
+        {3, 3, 8, 2, 1, 1, 1, 256, 32000, 384, 388},
+        {2, 1, 8, 0, 0, 2, 3, 64, 22050, 576, 208},
+        {2, 2, 8, 1, 0, 2, 2, 64, 24000, 1152, 384},
+        {2, 3, 4, 2, 0, 2, 1, 64, 16000, 384, 192},
+        {0, 1, 8, 2, 0, 3, 3, 64, 8000, 576, 576},
+    };
+    // Free format, bad bitrate, reserved rate, reserved version, reserved layer
+    static const int rejected[][4] = {{3, 1, 0, 0}, {3, 1, 15, 0}, {3, 1, 9, 3}, {1, 1, 9, 0}, {3, 0, 9, 0}};
+    flv_mp3_frame_t frame;
+    uint8_t p[4];
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+        mp3_header(p, cases[i].version_bits, cases[i].layer_bits, cases[i].bitrate_index,
+                   cases[i].rate_index, cases[i].padding, (int) i & 1);
+        CHECK(flv_mp3_parse_header(p, sizeof(p), &frame) == FLV_OK);
+        CHECK(frame.version == cases[i].version && frame.layer == cases[i].layer);
+        CHECK(frame.bitrate == cases[i].bitrate && frame.sample_rate == cases[i].sample_rate);
+        CHECK(frame.samples == cases[i].samples && frame.frame_size == cases[i].frame_size);
+        CHECK(frame.padding == cases[i].padding && frame.channels == ((i & 1) ? 1 : 2));
+    }
+    for (size_t i = 0; i < sizeof(rejected) / sizeof(rejected[0]); ++i) {
+        mp3_header(p, rejected[i][0], rejected[i][1], rejected[i][2], rejected[i][3], 0, 0);
+        CHECK(flv_mp3_parse_header(p, sizeof(p), &frame) == FLV_ERR_MALFORMED);
+    }
+    mp3_header(p, 3, 1, 9, 0, 0, 0);
+    CHECK(flv_mp3_parse_header(p, 3, &frame) == FLV_ERR_TRUNCATED);
+    p[1] = 0x1F;
+    CHECK(flv_mp3_parse_header(p, sizeof(p), &frame) == FLV_ERR_MALFORMED);
+}
+
+static void update(flv_audio_t *audio, const uint8_t *body, uint32_t size, uint32_t timestamp) {
+    flv_tag_info_t tag;
+
+    memset(&tag, 0, sizeof(tag));
+    tag.tag_type = TAGTYPE_AUDIODATA;
+    tag.data_size = size;
+    tag.timestamp = timestamp;
+    CHECK(flv_decode_tag_body(&tag, body, size) == FLV_OK);
+    CHECK(flv_audio_update(audio, &tag) == FLV_OK);
+}
+
+/*
+ * Three frames over two tags, the second split between them, with junk
+ * before the first: every frame is counted once and only the junk skipped.
+ */
+static void test_mp3_split_frame(void) {
+    static const uint8_t junk[] = {0x00, 0xFF, 0x12, 0x34};
+    static uint8_t stream[sizeof(junk) + 3 * MP3_FRAME_SIZE];
+    uint8_t body[1 + sizeof(stream)];
+    size_t split = sizeof(junk) + MP3_FRAME_SIZE + 200;
+    flv_audio_t audio;
+
+    memcpy(stream, junk, sizeof(junk));
+    for (int i = 0; i < 3; ++i)
+        mp3_header(stream + sizeof(junk) + i * MP3_FRAME_SIZE, 3, 1, 9, 0, 0, 0);
+    flv_audio_init(&audio);
+    body[0] = 0x2F;            // MP3, 44 kHz, 16 bit, stereo
+    memcpy(body + 1, stream, split);
+    update(&audio, body, (uint32_t) (1 + split), 0);
+    CHECK(audio.frames == 2 && audio.mp3_pending == MP3_FRAME_SIZE - 200);
+    memcpy(body + 1, stream + split, sizeof(stream) - split);
+    update(&audio, body, (uint32_t) (1 + sizeof(stream) - split), 26);
+    CHECK(audio.frames == 3 && audio.mp3_pending == 0);
+    CHECK(audio.samples == 3 * 1152 && audio.skipped_bytes == sizeof(junk));
+    CHECK(audio.sample_rate == 44100 && audio.channels == 2 && audio.sound_format == FLV_SOUND_FORMAT_MP3);
+}
+
+/*
+ * AAC frames of 1024 samples at 44.1 kHz last 23.22 ms. Stamped every
+ * 23 ms the timestamps fall behind the sample clock, every 24 ms they run
+ * ahead; the drift is where the tag starts by its timestamp minus where it
+ * starts by the samples before it.
+ */
+static void test_aac_drift(void) {
+    static const uint8_t config[] = {0xAF, 0, 0x12, 0x10};
+    static const uint8_t frame[] = {0xAF, 1, 0x21, 0x10, 0x04};
+    static const uint32_t steps[] = {23, 24};
+
+    for (size_t k = 0; k < sizeof(steps) / sizeof(steps[0]); ++k) {
+        const uint32_t start = 1000;
+        const uint32_t count = 101;
+        flv_audio_t audio;
+
+        flv_audio_init(&audio);
+        update(&audio, config, sizeof(config), 0);
+        CHECK(audio.has_aac_config && audio.channels == 2 && !audio.has_timestamp);
+        for (uint32_t i = 0; i < count; ++i)
+            update(&audio, frame, sizeof(frame), start + i * steps[k]);
+        CHECK(audio.frames == count && audio.samples == count * 1024);
+        CHECK(audio.first_timestamp == start && audio.last_timestamp == start + (count - 1) * steps[k]);
+        CHECK(fabs(audio.duration - count * 1024 / 44100.0) < 1e-9);
+
+        // The last tag starts after 100 frames: 2321.995 ms of samples
+        CHECK(audio.drift == (int64_t) (count - 1) * steps[k] - 2322);
+        if (steps[k] == 23) {
+            CHECK(audio.min_drift == audio.drift && audio.max_drift == 0);
+        } else {
+            CHECK(audio.max_drift == audio.drift && audio.min_drift == 0);
+        }
+    }
+}
+
+int main(void) {
+    test_aac_config();
+    test_mp3_header();
+    test_mp3_split_frame();
+    test_aac_drift();
+    return 0;
+}
@@ -0,0 +1,179 @@
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "flv-catalog.h"
+#include "test-util.h"
+
+#define MAX_SAMPLES (8)
+
+/*
+ * Known results for the samples in res/, found by name
+ */
+static const struct {
+    const char *name;
+    uint32_t duration;
+    uint32_t keyframes;
+    uint32_t max_keyframe_interval;
+} expected[] = {
+    {"sample1.flv", 24973, 21, 2000},
+    {"barsandtone.flv", 6060, 2, 6000},
+};
+
+static uint8_t *read_file(const char *path, size_t *size) {
+    struct stat st;
+    uint8_t *data = NULL;
+    int fd = open(path, O_RDONLY);
+
+    CHECK(fd >= 0 && fstat(fd, &st) == 0);
+    data = malloc((size_t) st.st_size);
+    CHECK(data != NULL);
+    CHECK(pread(fd, data, (size_t) st.st_size, 0) == st.st_size);
+    close(fd);
+    *size = (size_t) st.st_size;
+    return data;
+}
+
+/*
+ * The in-memory and the pread() summaries agree and are right; a size cut
+ * short, as for a file that shrank, gives a truncated summary of the start.
+ */
+static void test_summarize(const char *path, flv_summary_t *summary) {
+    flv_summary_t fd_summary;
+    flv_summary_t short_summary;
+    size_t size = 0;
+    uint8_t *data = read_file(path, &size);
+    int fd = open(path, O_RDONLY);
+    int found = 0;
+
+    CHECK(fd >= 0);
+    CHECK(flv_summarize_memory(data, size, summary) == FLV_OK);
+    CHECK(flv_summarize_fd(fd, size, &fd_summary) == FLV_OK);
+    CHECK(memcmp(summary, &fd_summary, sizeof(*summary)) == 0);
+    CHECK(summary->tag_count == summary->video_tags + summary->audio_tags + summary->script_tags);
+    CHECK(summary->video_codec == FLV_CODEC_ID_VP6 && summary->audio_codec == FLV_SOUND_FORMAT_MP3);
+    CHECK(summary->meta_flags & FLV_META_DURATION);
+    CHECK(summary->bitrate == (uint32_t) (size * 8 / summary->duration));
+    for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); ++i) {
+        if (!strstr(path, expected[i].name))
+            continue;
+        CHECK(summary->duration == expected[i].duration && summary->keyframes == expected[i].keyframes);
+        CHECK(summary->max_keyframe_interval == expected[i].max_keyframe_interval);
+        found = 1;
+    }
+    CHECK(found);
+
+    CHECK(flv_summarize_fd(fd, size / 2, &short_summary) == FLV_ERR_TRUNCATED);
+    CHECK(flv_summarize_memory(data, size / 2, &fd_summary) == FLV_ERR_TRUNCATED);
+    CHECK(memcmp(&short_summary, &fd_summary, sizeof(short_summary)) == 0);
+    CHECK(short_summary.tag_count > 0 && short_summary.tag_count < summary->tag_count);
+    close(fd);
+    free(data);
+}
+
+/*
+ * Records, paths and summaries come back as written, including the record
+ * of a file that could not be read.
+ */
+static void test_write_reopen(const char *catalog_path, char **paths, const flv_summary_t *summaries,
+                              int count) {
+    static const char missing[] = "/nonexistent.flv";
+    flv_catalog_writer_t writer;
+    flv_catalog_t catalog;
+    flv_summary_t none;
+    const char *path = NULL;
+    size_t len = 0;
+
+    memset(&none, 0, sizeof(none));
+    none.video_codec = FLV_SUMMARY_NO_CODEC;
+    none.audio_codec = FLV_SUMMARY_NO_CODEC;
+    CHECK(flv_catalog_writer_open(&writer, catalog_path) == FLV_OK);
+    for (int i = 0; i < count; ++i)
+        CHECK(flv_catalog_writer_add(&writer, paths[i], FLV_OK, 1000 + i, 2000 + i, &summaries[i]) == FLV_OK);
+    CHECK(flv_catalog_writer_add(&writer, missing, FLV_ERR_IO, 0, 0, &none) == FLV_OK);
+    CHECK(flv_catalog_writer_close(&writer) == FLV_OK);
+
+    CHECK(flv_catalog_open(&catalog, catalog_path) == FLV_OK);
+    CHECK(catalog.record_count == (uint64_t) count + 1);
+    for (int i = 0; i <= count; ++i) {
+        const flv_catalog_record_t *record = &catalog.records[i];
+        const char *name = i < count ? paths[i] : missing;
+
+        path = flv_catalog_record_path(&catalog, record, &len);
+        CHECK(len == strlen(name) && memcmp(path, name, len) == 0);
+        CHECK(record->status == (i < count ? FLV_OK : FLV_ERR_IO));
+        CHECK(record->file_size == (i < count ? 1000u + i : 0) && record->mtime == (i < count ? 2000 + i : 0));
+        CHECK(memcmp(&record->summary, i < count ? &summaries[i] : &none, sizeof(none)) == 0);
+    }
+    flv_catalog_close(&catalog);
+}
+
+static void patch_catalog(const char *path, size_t offset, const void *bytes, size_t len) {
+    int fd = open(path, O_WRONLY);
+
+    CHECK(fd >= 0);
+    CHECK(pwrite(fd, bytes, len, (off_t) offset) == (ssize_t) len);
+    close(fd);
+}
+
+static void write_copy(const char *path, const uint8_t *data, size_t size) {
+    FILE *file = fopen(path, "wb");
+
+    CHECK(file != NULL && fwrite(data, 1, size, file) == size);
+    fclose(file);
+}
+
+/*
+ * A catalog of another version, record layout or byte order, or one cut
+ * short, is refused.
+ */
+static void test_rejection(const char *catalog_path) {
+    static const struct {
+        size_t offset;
+        uint32_t value;
+        int status;
+    } patches[] = {
+        {offsetof(flv_catalog_header_t, magic), 0x58585858, FLV_ERR_SIGNATURE},
+        {offsetof(flv_catalog_header_t, version), FLV_CATALOG_VERSION + 1, FLV_ERR_VERSION},
+        {offsetof(flv_catalog_header_t, byte_order), 0x04030201, FLV_ERR_VERSION},
+        {offsetof(flv_catalog_header_t, record_size), sizeof(flv_catalog_record_t) + 8, FLV_ERR_VERSION},
+        {offsetof(flv_catalog_header_t, record_count), 1000, FLV_ERR_TRUNCATED},
+    };
+    static const char copy_suffix[] = ".bad";
+    flv_catalog_t catalog;
+    char *copy = malloc(strlen(catalog_path) + sizeof(copy_suffix));
+    size_t size = 0;
+    uint8_t *data = read_file(catalog_path, &size);
+
+    CHECK(copy != NULL);
+    sprintf(copy, "%s%s", catalog_path, copy_suffix);
+    for (size_t i = 0; i < sizeof(patches) / sizeof(patches[0]); ++i) {
+        write_copy(copy, data, size);
+        patch_catalog(copy, patches[i].offset, &patches[i].value, sizeof(patches[i].value));
+        CHECK(flv_catalog_open(&catalog, copy) == patches[i].status);
+    }
+    // Strings cut short, and a file smaller than the header
+    write_copy(copy, data, size - 1);
+    CHECK(flv_catalog_open(&catalog, copy) == FLV_ERR_TRUNCATED);
+    write_copy(copy, data, sizeof(flv_catalog_header_t) - 1);
+    CHECK(flv_catalog_open(&catalog, copy) == FLV_ERR_TRUNCATED);
+
+    unlink(copy);
+    free(copy);
+    free(data);
+}
+
+int main(int argc, char **argv) {
+    char catalog_path[] = "/tmp/test-catalog-XXXXXX";
+    flv_summary_t summaries[MAX_SAMPLES];
+    int fd = mkstemp(catalog_path);
+    int count = argc - 1;
+
+    CHECK(fd >= 0 && count <= MAX_SAMPLES);
+    close(fd);
+    for (int i = 0; i < count; ++i)
+        test_summarize(argv[i + 1], &summaries[i]);
+    test_write_reopen(catalog_path, argv + 1, summaries, count);
+    test_rejection(catalog_path);
+    unlink(catalog_path);
+    return 0;
+}
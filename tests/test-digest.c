@@ -0,0 +1,131 @@
+#include "flv-digest.h"
+#include "test-util.h"
+
+#define GOP_FRAMES (3)
+#define FRAME_SIZE (64)
+
+/*
+ * @brief append one GOP: a keyframe, interframes and an audio frame after
+ * each. The bodies depend on `seed` only, not on `timestamp`. Returns the
+ * offset of the second video frame's tag.
+ */
+static size_t add_gop(test_flv_t *flv, uint8_t seed, uint32_t timestamp) {
+    uint8_t video[FRAME_SIZE];
+    uint8_t audio[] = {0x2F, seed, 1, 2};
+    size_t second = 0;
+
+    for (int i = 0; i < GOP_FRAMES; ++i) {
+        video[0] = i == 0 ? 0x17 : 0x27;
+        video[1] = 1;
+        video[2] = video[3] = video[4] = 0;
+        for (size_t k = 5; k < sizeof(video); ++k)
+            video[k] = (uint8_t) (seed * 31 + i * 7 + k);
+        if (i == 1)
+            second = flv->size;
+        test_flv_tag(flv, TAGTYPE_VIDEODATA, timestamp + i * 40, video, sizeof(video));
+        test_flv_tag(flv, TAGTYPE_AUDIODATA, timestamp + i * 40 + 20, audio, sizeof(audio));
+    }
+    return second;
+}
+
+static void digest_of(const test_flv_t *flv, flv_digest_t *digest, int hashed) {
+    flv_reader_t reader;
+    flv_header_t header;
+    flv_tag_info_t tag;
+    int ret = 0;
+
+    flv_reader_init_memory(&reader, flv->data, flv->size);
+    flv_reader_set_hash(&reader, hashed);
+    CHECK(flv_reader_read_header(&reader, &header) == FLV_OK);
+    flv_digest_init(digest, &header);
+    while ((ret = flv_reader_next_tag(&reader, &tag)) == FLV_OK)
+        CHECK(flv_digest_update(digest, &tag, hashed) == FLV_OK);
+    CHECK(ret == FLV_EOF);
+    CHECK(flv_digest_final(digest) == FLV_OK);
+    flv_reader_destroy(&reader);
+}
+
+static void check_same_gop(const flv_gop_digest_t *a, const flv_gop_digest_t *b) {
+    CHECK(a->hash == b->hash && a->tag_count == b->tag_count && a->bytes == b->bytes);
+    CHECK(a->duration == b->duration);
+}
+
+/*
+ * A GOP shared by two recordings hashes the same in both, wherever it sits
+ * and whatever its timestamps; the others and the files differ.
+ */
+static void test_shared_gop(void) {
+    static const uint8_t metadata[] = {2, 0, 10, 'o', 'n', 'M', 'e', 't', 'a', 'D', 'a', 't', 'a'};
+    flv_digest_t a;
+    flv_digest_t b;
+    flv_digest_t unhashed;
+    test_flv_t flv_a;
+    test_flv_t flv_b;
+
+    test_flv_begin(&flv_a, 5, FLV_HEADER_SIZE);
+    add_gop(&flv_a, 1, 0);
+    add_gop(&flv_a, 2, 120);
+    add_gop(&flv_a, 3, 240);
+    test_flv_begin(&flv_b, 5, FLV_HEADER_SIZE);
+    test_flv_tag(&flv_b, TAGTYPE_SCRIPTDATAOBJECT, 0, metadata, sizeof(metadata));
+    add_gop(&flv_b, 9, 5000);
+    add_gop(&flv_b, 2, 5120);
+
+    digest_of(&flv_a, &a, 1);
+    digest_of(&flv_b, &b, 1);
+    CHECK(a.gop_count == 3 && b.gop_count == 2);
+    CHECK(a.tag_count == 3 * 2 * GOP_FRAMES && b.tag_count == 2 * 2 * GOP_FRAMES + 1);
+    check_same_gop(&a.gops[1], &b.gops[1]);
+    CHECK(a.gops[1].tag_count == 2 * GOP_FRAMES && a.gops[1].timestamp == 120);
+    CHECK(b.gops[1].timestamp == 5120 && b.gops[1].offset != a.gops[1].offset);
+    CHECK(a.gops[0].hash != b.gops[0].hash && a.gops[0].hash != a.gops[1].hash);
+    CHECK(a.file_hash != b.file_hash);
+
+    // Hashing the bodies in the digest gives what the reader's hashes give
+    digest_of(&flv_a, &unhashed, 0);
+    CHECK(unhashed.gop_count == a.gop_count && unhashed.file_hash == a.file_hash);
+    for (size_t i = 0; i < a.gop_count; ++i)
+        check_same_gop(&unhashed.gops[i], &a.gops[i]);
+
+    flv_digest_destroy(&a);
+    flv_digest_destroy(&b);
+    flv_digest_destroy(&unhashed);
+    test_flv_free(&flv_a);
+    test_flv_free(&flv_b);
+}
+
+/*
+ * One changed payload byte changes its own GOP's digest and the file
+ * digest, and nothing else.
+ */
+static void test_changed_byte(void) {
+    flv_digest_t before;
+    flv_digest_t after;
+    test_flv_t flv;
+    size_t second = 0;
+
+    test_flv_begin(&flv, 5, FLV_HEADER_SIZE);
+    add_gop(&flv, 1, 0);
+    second = add_gop(&flv, 2, 120);
+    add_gop(&flv, 3, 240);
+    digest_of(&flv, &before, 1);
+
+    flv.data[second + FLV_TAG_HEADER_SIZE + FRAME_SIZE / 2] ^= 0x01;
+    digest_of(&flv, &after, 1);
+    CHECK(before.gop_count == 3 && after.gop_count == 3);
+    check_same_gop(&before.gops[0], &after.gops[0]);
+    check_same_gop(&before.gops[2], &after.gops[2]);
+    CHECK(before.gops[1].hash != after.gops[1].hash);
+    CHECK(before.gops[1].bytes == after.gops[1].bytes);
+    CHECK(before.file_hash != after.file_hash);
+
+    flv_digest_destroy(&before);
+    flv_digest_destroy(&after);
+    test_flv_free(&flv);
+}
+
+int main(void) {
+    test_shared_gop();
+    test_changed_byte();
+    return 0;
+}
@@ -0,0 +1,281 @@
+#include <stddef.h>
+#include <unistd.h>
+#include "flv-edit.h"
+#include "flv-validate.h"
+#include "test-util.h"
+
+#define FRAMES (5)
+
+/*
+ * @brief onMetaData with the given numeric properties
+ */
+static void metadata_tag(test_flv_t *flv, const char *const *names, const double *values, size_t count) {
+    static const uint8_t name[] = {AMF_TYPE_STRING, 0, 10, 'o', 'n', 'M', 'e', 't', 'a', 'D', 'a', 't', 'a'};
+    static const uint8_t end[] = {0, 0, AMF_TYPE_OBJECT_END};
+    test_flv_t body;
+    uint8_t bytes[8];
+
+    memset(&body, 0, sizeof(body));
+    test_flv_append(&body, name, sizeof(name));
+    bytes[0] = AMF_TYPE_ECMA_ARRAY;
+    flv_put_ui32(bytes + 1, (uint32_t) count);
+    test_flv_append(&body, bytes, 5);
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t bits = 0;
+
+        bytes[0] = 0;
+        bytes[1] = (uint8_t) strlen(names[i]);
+        test_flv_append(&body, bytes, 2);
+        test_flv_append(&body, names[i], strlen(names[i]));
+        bytes[0] = AMF_TYPE_NUMBER;
+        test_flv_append(&body, bytes, 1);
+        memcpy(&bits, &values[i], sizeof(bits));
+        flv_put_ui32(bytes, (uint32_t) (bits >> 32));
+        flv_put_ui32(bytes + 4, (uint32_t) bits);
+        test_flv_append(&body, bytes, 8);
+    }
+    test_flv_append(&body, end, sizeof(end));
+    test_flv_tag(flv, TAGTYPE_SCRIPTDATAOBJECT, 0, body.data, (uint32_t) body.size);
+    test_flv_free(&body);
+}
+
+/*
+ * @brief an AVC + AAC input starting at `start`: FRAMES video frames 40 ms
+ * apart, the first a keyframe, and as many audio frames 23 ms apart.
+ * `profile` goes into the AVC configuration.
+ */
+static int make_input(uint32_t start, uint8_t profile) {
+    static const char *const names[] = {"duration", "width", "height", "videocodecid", "framerate",
+                                        "audiocodecid", "audiosamplerate", "stereo", "filesize"};
+    static const double values[] = {0.2, 320, 240, 7, 25, 10, 44100, 1, 1234};
+    uint8_t video_config[] = {0x17, 0, 0, 0, 0, 1, profile, 0, 0x1F};
+    static const uint8_t audio_config[] = {0xAF, 0, 0x12, 0x10};
+    static const uint8_t audio[] = {0xAF, 1, 0x21, 0x22};
+    uint8_t video[] = {0x17, 1, 0, 0, 0, 0, 0, 0, 1, 0x65};
+    char path[] = "/tmp/test-edit-XXXXXX";
+    test_flv_t flv;
+    int fd = mkstemp(path);
+
+    CHECK(fd >= 0);
+    unlink(path);
+    test_flv_begin(&flv, 5, FLV_HEADER_SIZE);
+    metadata_tag(&flv, names, values, sizeof(values) / sizeof(values[0]));
+    test_flv_tag(&flv, TAGTYPE_VIDEODATA, start, video_config, sizeof(video_config));
+    test_flv_tag(&flv, TAGTYPE_AUDIODATA, start, audio_config, sizeof(audio_config));
+    for (uint32_t i = 0; i < FRAMES; ++i) {
+        video[0] = i == 0 ? 0x17 : 0x27;
+        test_flv_tag(&flv, TAGTYPE_VIDEODATA, start + i * 40, video, sizeof(video));
+        test_flv_tag(&flv, TAGTYPE_AUDIODATA, start + i * 23, audio, sizeof(audio));
+    }
+    CHECK(write(fd, flv.data, flv.size) == (ssize_t) flv.size);
+    test_flv_free(&flv);
+    return fd;
+}
+
+static int make_output(void) {
+    char path[] = "/tmp/test-edit-out-XXXXXX";
+    int fd = mkstemp(path);
+
+    CHECK(fd >= 0);
+    unlink(path);
+    return fd;
+}
+
+/*
+ * @brief what a written file holds
+ */
+typedef struct output_info {
+    uint8_t type_flags;
+    uint32_t script_tags;
+    uint32_t video_configs;
+    uint32_t audio_configs;
+    uint32_t video_frames;
+    uint32_t audio_frames;
+    uint32_t video_ts[2 * FRAMES];
+    uint32_t audio_ts[2 * FRAMES];
+    uint64_t size;
+    double duration;           // onMetaData values, -1 if missing
+    double filesize;
+    double width;
+    double videocodecid;
+    double audiocodecid;
+    double audiosamplerate;
+} output_info_t;
+
+static int meta_property(void *opaque, const char *name, size_t name_len, const flv_amf_value_t *value) {
+    output_info_t *info = (output_info_t *) opaque;
+    static const struct {
+        const char *name;
+        size_t offset;
+    } fields[] = {
+        {"duration", offsetof(output_info_t, duration)},
+        {"filesize", offsetof(output_info_t, filesize)},
+        {"width", offsetof(output_info_t, width)},
+        {"videocodecid", offsetof(output_info_t, videocodecid)},
+        {"audiocodecid", offsetof(output_info_t, audiocodecid)},
+        {"audiosamplerate", offsetof(output_info_t, audiosamplerate)},
+    };
+
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); ++i) {
+        if (value->type == AMF_TYPE_NUMBER && strlen(fields[i].name) == name_len &&
+            memcmp(fields[i].name, name, name_len) == 0)
+            *(double *) ((uint8_t *) info + fields[i].offset) = value->number;
+    }
+    return 0;
+}
+
+/*
+ * @brief read back the output on `fd`, which must pass flv_validate
+ */
+static void read_output(int fd, output_info_t *info) {
+    flv_validate_stats_t stats;
+    flv_reader_t reader;
+    flv_header_t header;
+    flv_tag_info_t tag;
+    uint8_t *data = NULL;
+    off_t size = lseek(fd, 0, SEEK_END);
+    int ret = 0;
+
+    CHECK(size > 0);
+    data = malloc((size_t) size);
+    CHECK(data != NULL);
+    CHECK(pread(fd, data, (size_t) size, 0) == size);
+    CHECK(flv_validate_memory(data, (size_t) size, NULL, NULL, &stats) == FLV_OK);
+    CHECK(stats.issues == 0);
+
+    memset(info, 0, sizeof(*info));
+    info->size = (uint64_t) size;
+    info->duration = info->filesize = info->width = -1;
+    info->videocodecid = info->audiocodecid = info->audiosamplerate = -1;
+    flv_reader_init_memory(&reader, data, (size_t) size);
+    CHECK(flv_reader_read_header(&reader, &header) == FLV_OK);
+    info->type_flags = header.type_flags;
+    while ((ret = flv_reader_next_tag(&reader, &tag)) == FLV_OK) {
+        if (tag.tag_type == TAGTYPE_SCRIPTDATAOBJECT) {
+            info->script_tags++;
+            CHECK(flv_parse_script_data(tag.data, tag.data_size, meta_property, info) == FLV_OK);
+        } else if (tag.tag_type == TAGTYPE_VIDEODATA && tag.avc_packet_type == FLV_AVC_SEQUENCE_HEADER) {
+            info->video_configs++;
+        } else if (tag.tag_type == TAGTYPE_AUDIODATA && tag.aac_packet_type == FLV_AAC_SEQUENCE_HEADER) {
+            info->audio_configs++;
+        } else if (tag.tag_type == TAGTYPE_VIDEODATA) {
+            CHECK(info->video_frames < 2 * FRAMES);
+            info->video_ts[info->video_frames++] = flv_tag_timestamp(&tag);
+        } else if (tag.tag_type == TAGTYPE_AUDIODATA) {
+            CHECK(info->audio_frames < 2 * FRAMES);
+            info->audio_ts[info->audio_frames++] = flv_tag_timestamp(&tag);
+        }
+    }
+    CHECK(ret == FLV_EOF);
+    flv_reader_destroy(&reader);
+    free(data);
+}
+
+/*
+ * The second input continues one frame after the first ends, its script
+ * tag and repeated sequence headers are left out, and the onMetaData
+ * duration and filesize describe the joined file.
+ */
+static void test_concat(void) {
+    int in_fds[2] = {make_input(0, 0x64), make_input(5000, 0x64)};
+    flv_concat_config_t config = {0, 1};
+    int out_fd = make_output();
+    flv_edit_stats_t stats;
+    output_info_t info;
+
+    CHECK(flv_concat(out_fd, in_fds, 2, NULL, &stats) == FLV_OK);
+    CHECK(stats.failed_input == -1 && stats.truncated_inputs == 0);
+    CHECK(stats.tags_in == 2 * (3 + 2 * FRAMES) && stats.tags_out == 3 + 4 * FRAMES);
+    // Each input lasts four frame gaps plus its last frame
+    CHECK(stats.duration == 2 * FRAMES * 40);
+    read_output(out_fd, &info);
+    CHECK(stats.bytes_out == info.size);
+    CHECK(info.type_flags == 5 && info.script_tags == 1);
+    CHECK(info.video_configs == 1 && info.audio_configs == 1);
+    CHECK(info.video_frames == 2 * FRAMES && info.audio_frames == 2 * FRAMES);
+    for (uint32_t i = 0; i < 2 * FRAMES; ++i) {
+        CHECK(info.video_ts[i] == i * 40);
+        CHECK(info.audio_ts[i] == (i < FRAMES ? i * 23 : FRAMES * 40 + (i - FRAMES) * 23));
+    }
+    CHECK(info.duration == 0.4 && info.filesize == (double) info.size);
+    close(out_fd);
+
+    // keep_metadata leaves the first input's values
+    out_fd = make_output();
+    CHECK(flv_concat(out_fd, in_fds, 2, &config, &stats) == FLV_OK);
+    read_output(out_fd, &info);
+    CHECK(info.duration == 0.2 && info.filesize == 1234);
+    close(out_fd);
+    close(in_fds[0]);
+    close(in_fds[1]);
+}
+
+/*
+ * Another codec configuration is refused unless forced, and then kept.
+ */
+static void test_concat_mismatch(void) {
+    int in_fds[2] = {make_input(0, 0x64), make_input(0, 0x4D)};
+    flv_concat_config_t config = {1, 0};
+    int out_fd = make_output();
+    flv_edit_stats_t stats;
+    output_info_t info;
+
+    CHECK(flv_concat(out_fd, in_fds, 2, NULL, &stats) == FLV_ERR_MISMATCH);
+    CHECK(stats.failed_input == 1);
+    CHECK(flv_concat(out_fd, in_fds, 2, &config, &stats) == FLV_OK);
+    read_output(out_fd, &info);
+    CHECK(info.video_configs == 2 && info.audio_configs == 1);
+    close(out_fd);
+    close(in_fds[0]);
+    close(in_fds[1]);
+}
+
+/*
+ * Filtering keeps the timestamps, recomputes TypeFlags and clears the
+ * onMetaData values of the track that was dropped.
+ */
+static void test_filter(void) {
+    flv_filter_config_t config = {FLV_FILTER_AUDIO, 0, 0};
+    int in_fd = make_input(0, 0x64);
+    int out_fd = make_output();
+    flv_edit_stats_t stats;
+    output_info_t info;
+
+    CHECK(flv_filter(out_fd, in_fd, &config, &stats) == FLV_OK);
+    read_output(out_fd, &info);
+    CHECK(info.type_flags == 1 << FLV_HEADER_AUDIO_BIT && info.script_tags == 1);
+    CHECK(info.video_configs == 0 && info.video_frames == 0);
+    CHECK(info.audio_configs == 1 && info.audio_frames == FRAMES && info.audio_ts[FRAMES - 1] == (FRAMES - 1) * 23);
+    CHECK(info.filesize == (double) info.size && info.duration == 0.2);
+    CHECK(info.width == 0 && info.videocodecid == 0);
+    CHECK(info.audiocodecid == 10 && info.audiosamplerate == 44100);
+    close(out_fd);
+
+    config.mode = FLV_FILTER_VIDEO;
+    out_fd = make_output();
+    CHECK(flv_filter(out_fd, in_fd, &config, &stats) == FLV_OK);
+    read_output(out_fd, &info);
+    CHECK(info.type_flags == 1 << FLV_HEADER_VIDEO_BIT);
+    CHECK(info.video_configs == 1 && info.video_frames == FRAMES && info.audio_frames == 0);
+    CHECK(info.width == 320 && info.videocodecid == 7);
+    CHECK(info.audiocodecid == 0 && info.audiosamplerate == 0);
+    close(out_fd);
+
+    config.mode = FLV_FILTER_KEYFRAMES;
+    config.drop_metadata = 1;
+    out_fd = make_output();
+    CHECK(flv_filter(out_fd, in_fd, &config, &stats) == FLV_OK);
+    read_output(out_fd, &info);
+    CHECK(info.script_tags == 0 && info.video_configs == 1);
+    CHECK(info.video_frames == 1 && info.video_ts[0] == 0);
+    CHECK(stats.tags_out == 2);
+    close(out_fd);
+    close(in_fd);
+}
+
+int main(void) {
+    test_concat();
+    test_concat_mismatch();
+    test_filter();
+    return 0;
+}
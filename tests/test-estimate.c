@@ -0,0 +1,142 @@
+#include <fcntl.h>
+#include <math.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "flv-estimate.h"
+#include "test-util.h"
+
+/*
+ * The windows, the head probe and the tail probe overlap on small files;
+ * the bytes they share are counted once. Every window is one sample.
+ */
+static void test_sample(const char *path) {
+    static const flv_estimate_config_t configs[] = {{0, 0}, {4, 16 << 10}, {64, 4 << 10}};
+    flv_estimate_t estimate;
+    flv_estimate_t mem_estimate;
+    struct stat st;
+    uint8_t *data = NULL;
+    int fd = open(path, O_RDONLY);
+
+    CHECK(fd >= 0 && fstat(fd, &st) == 0);
+    data = malloc((size_t) st.st_size);
+    CHECK(data != NULL);
+    CHECK(pread(fd, data, (size_t) st.st_size, 0) == st.st_size);
+
+    for (size_t i = 0; i < sizeof(configs) / sizeof(configs[0]); ++i) {
+        CHECK(flv_estimate_fd(fd, &configs[i], &estimate) == FLV_OK);
+        CHECK(estimate.file_size == (uint64_t) st.st_size);
+        CHECK(estimate.bytes_read <= estimate.file_size);
+        CHECK(estimate.exact_duration && estimate.duration > 0);
+        CHECK(estimate.bitrate.count > 0 && estimate.bitrate.count <= estimate.synced);
+        CHECK(estimate.synced <= estimate.windows);
+        CHECK(estimate.bitrate.low <= estimate.bitrate.mean && estimate.bitrate.mean <= estimate.bitrate.high);
+
+        CHECK(flv_estimate_memory(data, (size_t) st.st_size, &configs[i], &mem_estimate) == FLV_OK);
+        CHECK(mem_estimate.bytes_read == estimate.bytes_read);
+        CHECK(mem_estimate.bitrate.count == estimate.bitrate.count);
+        CHECK(mem_estimate.bitrate.mean == estimate.bitrate.mean);
+        CHECK(mem_estimate.duration == estimate.duration);
+    }
+    // A file within one default window is read exactly once
+    if (st.st_size <= FLV_ESTIMATE_WINDOW_BYTES) {
+        CHECK(flv_estimate_fd(fd, NULL, &estimate) == FLV_OK);
+        CHECK(estimate.bytes_read == (uint64_t) st.st_size);
+        CHECK(estimate.windows == 1 && estimate.bitrate.count == 1);
+    }
+    free(data);
+    close(fd);
+}
+
+/*
+ * @brief the figures the estimator samples, measured over every tag
+ */
+typedef struct exact {
+    double duration;           // Seconds
+    double bitrate;            // Kilobits per second, whole file
+    double frame_rate;
+    double keyframe_interval;  // Seconds, first to last keyframe
+} exact_t;
+
+static void measure_exact(const uint8_t *data, size_t size, exact_t *exact) {
+    flv_reader_t reader;
+    flv_tag_info_t tag;
+    uint32_t first = 0, last = 0, first_video = 0, last_video = 0, first_key = 0, last_key = 0;
+    uint32_t media = 0, frames = 0, keyframes = 0;
+
+    flv_reader_init_memory(&reader, data, size);
+    CHECK(flv_reader_read_header(&reader, NULL) == FLV_OK);
+    while (flv_reader_next_tag(&reader, &tag) == FLV_OK) {
+        uint32_t timestamp = flv_tag_timestamp(&tag);
+
+        if (tag.tag_type != TAGTYPE_AUDIODATA && tag.tag_type != TAGTYPE_VIDEODATA)
+            continue;
+        if (media++ == 0)
+            first = timestamp;
+        last = timestamp;
+        if (tag.tag_type != TAGTYPE_VIDEODATA)
+            continue;
+        if (frames++ == 0)
+            first_video = timestamp;
+        last_video = timestamp;
+        if (tag.frame_type == FLV_FRAME_TYPE_KEY && keyframes++ == 0)
+            first_key = timestamp;
+        if (tag.frame_type == FLV_FRAME_TYPE_KEY)
+            last_key = timestamp;
+    }
+    flv_reader_destroy(&reader);
+    CHECK(last > first && frames > 1 && keyframes > 1);
+    exact->duration = (last - first) / 1000.0;
+    exact->bitrate = size * 8.0 / (last - first);
+    exact->frame_rate = (frames - 1) * 1000.0 / (last_video - first_video);
+    exact->keyframe_interval = (last_key - first_key) / 1000.0 / (keyframes - 1);
+}
+
+static void check_near(const char *what, double estimate, double exact, double tolerance) {
+    if (fabs(estimate - exact) > tolerance * exact) {
+        fprintf(stderr, "%s: estimated %.4f, exact %.4f, beyond %.0f%%\n", what, estimate, exact, tolerance * 100);
+        exit(1);
+    }
+}
+
+/*
+ * The estimates must be close to what a full pass measures; several
+ * windows must also bracket the exact bitrate and frame rate in their
+ * confidence intervals.
+ */
+static void test_accuracy(const char *path) {
+    static const flv_estimate_config_t sampled = {8, 256 << 10};
+    flv_estimate_t estimate;
+    exact_t exact;
+    struct stat st;
+    uint8_t *data = NULL;
+    int fd = open(path, O_RDONLY);
+
+    CHECK(fd >= 0 && fstat(fd, &st) == 0);
+    data = malloc((size_t) st.st_size);
+    CHECK(data != NULL);
+    CHECK(pread(fd, data, (size_t) st.st_size, 0) == st.st_size);
+    measure_exact(data, (size_t) st.st_size, &exact);
+
+    CHECK(flv_estimate_fd(fd, NULL, &estimate) == FLV_OK);
+    CHECK(estimate.exact_duration && fabs(estimate.duration - exact.duration) < 1e-9);
+    CHECK(estimate.bitrate.count && estimate.frame_rate.count && estimate.keyframe_interval.count);
+    check_near("bitrate", estimate.bitrate.mean, exact.bitrate, 0.10);
+    check_near("frame rate", estimate.frame_rate.mean, exact.frame_rate, 0.01);
+    check_near("keyframe interval", estimate.keyframe_interval.mean, exact.keyframe_interval, 0.10);
+
+    CHECK(flv_estimate_fd(fd, &sampled, &estimate) == FLV_OK);
+    if (estimate.bitrate.count > 1) {
+        CHECK(estimate.bitrate.low <= exact.bitrate && exact.bitrate <= estimate.bitrate.high);
+        CHECK(estimate.frame_rate.low <= exact.frame_rate && exact.frame_rate <= estimate.frame_rate.high);
+    }
+    free(data);
+    close(fd);
+}
+
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; ++i) {
+        test_sample(argv[i]);
+        test_accuracy(argv[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,188 @@
+#include "flv-gop-cache.h"
+#include "test-util.h"
+
+static void push(flv_gop_cache_t *cache, uint8_t tag_type, const uint8_t *body, uint32_t size,
+                 uint32_t timestamp) {
+    flv_tag_info_t tag;
+    flv_tag_buf_t *buf = NULL;
+
+    memset(&tag, 0, sizeof(tag));
+    tag.tag_type = tag_type;
+    tag.data_size = size;
+    tag.timestamp = timestamp;
+    CHECK(flv_decode_tag_body(&tag, body, size) == FLV_OK);
+    buf = flv_tag_buf_new(&tag);
+    CHECK(buf != NULL);
+    CHECK(flv_gop_cache_push(cache, buf) == FLV_OK);
+    flv_tag_buf_unref(buf);
+}
+
+static size_t snapshot_count(flv_gop_cache_t *cache, uint32_t *first_timestamp) {
+    flv_gop_snapshot_t snap;
+    size_t count = 0;
+
+    CHECK(flv_gop_cache_snapshot(cache, &snap) == FLV_OK);
+    count = snap.count;
+    if (count && first_timestamp)
+        *first_timestamp = snap.tags[0]->timestamp;
+    flv_gop_snapshot_release(&snap);
+    return count;
+}
+
+/*
+ * An audio-only GOP runs from the AAC sequence header rather than
+ * restarting at every frame, and starts over at the next sequence header.
+ */
+static void test_audio_only(void) {
+    static const uint8_t config[] = {0xAF, 0, 0x12, 0x10};
+    static const uint8_t frame[] = {0xAF, 1, 1, 2, 3};
+    flv_gop_cache_t *cache = flv_gop_cache_create(NULL);
+    uint32_t first = 0;
+
+    CHECK(cache != NULL);
+    push(cache, TAGTYPE_AUDIODATA, config, sizeof(config), 0);
+    for (uint32_t i = 0; i < 10; ++i)
+        push(cache, TAGTYPE_AUDIODATA, frame, sizeof(frame), i * 23);
+    CHECK(snapshot_count(cache, &first) == 10 && first == 0);
+
+    push(cache, TAGTYPE_AUDIODATA, config, sizeof(config), 230);
+    push(cache, TAGTYPE_AUDIODATA, frame, sizeof(frame), 230);
+    push(cache, TAGTYPE_AUDIODATA, frame, sizeof(frame), 253);
+    CHECK(snapshot_count(cache, &first) == 2 && first == 230);
+
+    // Without another sequence header the GOP starts over every 2 s
+    for (uint32_t i = 2; i < 400; ++i) {
+        uint32_t timestamp = 230 + i * 23;
+
+        push(cache, TAGTYPE_AUDIODATA, frame, sizeof(frame), timestamp);
+        CHECK(snapshot_count(cache, &first) > 0);
+        CHECK(first <= timestamp && timestamp - first < FLV_GOP_CACHE_MAX_AUDIO_MS);
+    }
+    CHECK(snapshot_count(cache, NULL) < FLV_GOP_CACHE_MAX_AUDIO_MS / 23 + 1);
+    flv_gop_cache_destroy(cache);
+}
+
+static const uint8_t keyframe[] = {0x17, 1, 0, 0, 0, 9};
+static const uint8_t interframe[] = {0x27, 1, 0, 0, 0, 9};
+
+/*
+ * Each keyframe starts a new GOP, and later snapshots no longer see the
+ * old one.
+ */
+static void test_keyframes(void) {
+    flv_gop_cache_t *cache = flv_gop_cache_create(NULL);
+    uint32_t first = 0;
+
+    CHECK(cache != NULL);
+    // Nothing is cached before the first keyframe
+    push(cache, TAGTYPE_VIDEODATA, interframe, sizeof(interframe), 0);
+    CHECK(snapshot_count(cache, NULL) == 0);
+    push(cache, TAGTYPE_VIDEODATA, keyframe, sizeof(keyframe), 40);
+    push(cache, TAGTYPE_VIDEODATA, interframe, sizeof(interframe), 80);
+    push(cache, TAGTYPE_VIDEODATA, interframe, sizeof(interframe), 120);
+    CHECK(snapshot_count(cache, &first) == 3 && first == 40);
+    push(cache, TAGTYPE_VIDEODATA, keyframe, sizeof(keyframe), 160);
+    push(cache, TAGTYPE_VIDEODATA, interframe, sizeof(interframe), 200);
+    CHECK(snapshot_count(cache, &first) == 2 && first == 160);
+    flv_gop_cache_destroy(cache);
+}
+
+/*
+ * A snapshot held across the next keyframe keeps its own GOP intact; one
+ * released before it lets the cache recycle the GOP in place.
+ */
+static void test_snapshot_lifetime(void) {
+    flv_gop_cache_t *cache = flv_gop_cache_create(NULL);
+    flv_gop_snapshot_t held;
+    flv_gop_snapshot_t snap;
+    flv_gop_t *recycled = NULL;
+
+    CHECK(cache != NULL);
+    push(cache, TAGTYPE_VIDEODATA, keyframe, sizeof(keyframe), 0);
+    push(cache, TAGTYPE_VIDEODATA, interframe, sizeof(interframe), 40);
+    CHECK(flv_gop_cache_snapshot(cache, &held) == FLV_OK);
+    CHECK(held.count == 2);
+
+    push(cache, TAGTYPE_VIDEODATA, keyframe, sizeof(keyframe), 80);
+    push(cache, TAGTYPE_VIDEODATA, interframe, sizeof(interframe), 120);
+    push(cache, TAGTYPE_VIDEODATA, interframe, sizeof(interframe), 160);
+    CHECK(held.count == 2 && held.bytes == held.tags[0]->size + held.tags[1]->size);
+    CHECK(held.tags[0]->timestamp == 0 && (held.tags[0]->flags & FLV_TAG_BUF_KEYFRAME));
+    CHECK(held.tags[1]->timestamp == 40);
+    CHECK(flv_gop_cache_snapshot(cache, &snap) == FLV_OK);
+    CHECK(snap.gop != held.gop && snap.count == 3 && snap.tags[0]->timestamp == 80);
+    recycled = snap.gop;
+    flv_gop_snapshot_release(&snap);
+    flv_gop_snapshot_release(&held);
+
+    // Only the cache holds the current GOP, so the next one reuses it
+    push(cache, TAGTYPE_VIDEODATA, keyframe, sizeof(keyframe), 200);
+    CHECK(flv_gop_cache_snapshot(cache, &snap) == FLV_OK);
+    CHECK(snap.gop == recycled && snap.count == 1 && snap.tags[0]->timestamp == 200);
+    CHECK(snap.bytes == snap.tags[0]->size);
+    flv_gop_snapshot_release(&snap);
+    flv_gop_cache_destroy(cache);
+}
+
+/*
+ * A GOP past either limit is dropped, and nothing is cached until the next
+ * keyframe.
+ */
+static void test_overflow(void) {
+    flv_gop_cache_config_t tag_limit = {0, 4, 0, 0};
+    flv_gop_cache_config_t byte_limit = {0, 0, 0, 0};
+    flv_gop_cache_config_t *configs[] = {&tag_limit, &byte_limit};
+    uint32_t first = 0;
+
+    // Room for the keyframe and two more tags
+    byte_limit.max_bytes = 3 * (FLV_TAG_HEADER_SIZE + sizeof(keyframe) + FLV_PREV_TAG_SIZE_SIZE);
+    for (size_t i = 0; i < sizeof(configs) / sizeof(configs[0]); ++i) {
+        flv_gop_cache_t *cache = flv_gop_cache_create(configs[i]);
+        size_t fits = configs[i]->max_tags ? configs[i]->max_tags : 3;
+        uint32_t timestamp = 0;
+
+        CHECK(cache != NULL);
+        push(cache, TAGTYPE_VIDEODATA, keyframe, sizeof(keyframe), timestamp);
+        for (size_t k = 1; k < fits; ++k)
+            push(cache, TAGTYPE_VIDEODATA, interframe, sizeof(interframe), timestamp += 40);
+        CHECK(snapshot_count(cache, NULL) == fits);
+        push(cache, TAGTYPE_VIDEODATA, interframe, sizeof(interframe), timestamp += 40);
+        CHECK(snapshot_count(cache, NULL) == 0);
+        push(cache, TAGTYPE_VIDEODATA, interframe, sizeof(interframe), timestamp += 40);
+        CHECK(snapshot_count(cache, NULL) == 0);
+        push(cache, TAGTYPE_VIDEODATA, keyframe, sizeof(keyframe), timestamp += 40);
+        CHECK(snapshot_count(cache, &first) == 1 && first == timestamp);
+        flv_gop_cache_destroy(cache);
+    }
+}
+
+/*
+ * A disabled cache still hands out metadata and codec configuration.
+ */
+static void test_disabled(void) {
+    static const uint8_t video_config[] = {0x17, 0, 0, 0, 0, 1, 0x64, 0, 0x1F};
+    static const uint8_t metadata[] = {2, 0, 10, 'o', 'n', 'M', 'e', 't', 'a', 'D', 'a', 't', 'a'};
+    flv_gop_cache_config_t config = {0, 0, 1, 0};
+    flv_gop_cache_t *cache = flv_gop_cache_create(&config);
+    flv_gop_snapshot_t snap;
+
+    CHECK(cache != NULL);
+    push(cache, TAGTYPE_SCRIPTDATAOBJECT, metadata, sizeof(metadata), 0);
+    push(cache, TAGTYPE_VIDEODATA, video_config, sizeof(video_config), 0);
+    push(cache, TAGTYPE_VIDEODATA, keyframe, sizeof(keyframe), 0);
+    push(cache, TAGTYPE_VIDEODATA, interframe, sizeof(interframe), 40);
+    CHECK(flv_gop_cache_snapshot(cache, &snap) == FLV_OK);
+    CHECK(snap.metadata != NULL && snap.video_config != NULL && snap.audio_config == NULL);
+    CHECK(snap.count == 0 && snap.gop == NULL);
+    flv_gop_snapshot_release(&snap);
+    flv_gop_cache_destroy(cache);
+}
+
+int main(void) {
+    test_audio_only();
+    test_keyframes();
+    test_snapshot_lifetime();
+    test_overflow();
+    test_disabled();
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include "flv-hash.h"
+#include "test-util.h"
+
+/*
+ * Reference XXH64 outputs. The longer inputs cover the 32-byte stripe loop
+ * and each tail length class (8, 4 and 1 byte steps).
+ */
+static const struct {
+    const char *input;
+    uint64_t seed;
+    uint64_t hash;
+} vectors[] = {
+    {"", 0, 0xEF46DB3751D8E999ULL},
+    {"", 2654435761ULL, 0xAC75FDA2929B17EFULL},
+    {"a", 0, 0xD24EC4F1A98C6E5BULL},
+    {"as", 0, 0x1C330FB2D66BE179ULL},
+    {"asd", 0, 0x631C37CE72A97393ULL},
+    {"asdf", 0, 0x415872F599CEA71EULL},
+    {"abc", 0, 0x44BC2CF5AD770999ULL},
+    {"The quick brown fox jumps over the lazy dog", 0, 0x0B242D361FDA71BCULL},
+    {"Call me Ishmael. Some years ago--never mind how long precisely-", 0, 0x02A2E85470D6FD96ULL},
+};
+
+static void test_vectors(void) {
+    for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); ++i) {
+        size_t len = strlen(vectors[i].input);
+
+        if (flv_hash64(vectors[i].input, len, vectors[i].seed) != vectors[i].hash) {
+            fprintf(stderr, "vector %zu (\"%s\") mismatch\n", i, vectors[i].input);
+            exit(1);
+        }
+    }
+}
+
+/*
+ * Streaming in uneven pieces must give the one-shot result for every
+ * length around the stripe and buffer boundaries.
+ */
+static void test_streaming(void) {
+    static const size_t steps[] = {1, 3, 7, 31, 32, 33, 100};
+    uint8_t data[300];
+    uint32_t x = 2654435761U;
+
+    for (size_t i = 0; i < sizeof(data); ++i) {
+        data[i] = (uint8_t) (x >> 24);
+        x *= x;
+    }
+    for (size_t len = 0; len <= sizeof(data); ++len) {
+        uint64_t expected = flv_hash64(data, len, 42);
+
+        for (size_t k = 0; k < sizeof(steps) / sizeof(steps[0]); ++k) {
+            flv_hash64_state_t state;
+
+            flv_hash64_reset(&state, 42);
+            for (size_t pos = 0; pos < len; pos += steps[k])
+                flv_hash64_update(&state, data + pos, len - pos < steps[k] ? len - pos : steps[k]);
+            CHECK(flv_hash64_digest(&state) == expected);
+        }
+    }
+}
+
+int main(void) {
+    test_vectors();
+    test_streaming();
+    return 0;
+}
@@ -0,0 +1,156 @@
+#include <pthread.h>
+#include <sched.h>
+#include "flv-pipeline.h"
+#include "flv-ring.h"
+#include "test-util.h"
+
+#define RING_ITEMS (200000)
+
+static void test_ring_bounds(void) {
+    flv_ring_t ring;
+    int items[4];
+
+    CHECK(flv_ring_init(&ring, 3) == 0);
+    CHECK(flv_ring_pop(&ring) == NULL);
+    for (int i = 0; i < 4; ++i)
+        CHECK(flv_ring_push(&ring, &items[i]) == 0);
+    CHECK(flv_ring_push(&ring, &items[0]) == -1);
+    for (int i = 0; i < 4; ++i)
+        CHECK(flv_ring_pop(&ring) == &items[i]);
+    CHECK(flv_ring_pop(&ring) == NULL);
+    flv_ring_destroy(&ring);
+}
+
+static void *ring_producer(void *opaque) {
+    flv_ring_t *ring = (flv_ring_t *) opaque;
+
+    for (uintptr_t i = 1; i <= RING_ITEMS; ++i) {
+        // Yield so that a single CPU still makes progress
+        while (flv_ring_push(ring, (void *) i) != 0)
+            sched_yield();
+    }
+    return NULL;
+}
+
+/*
+ * @brief items cross threads in order, none lost or repeated
+ */
+static void test_ring_threads(void) {
+    flv_ring_t ring;
+    pthread_t thread;
+    uintptr_t expected = 1;
+
+    CHECK(flv_ring_init(&ring, 8) == 0);
+    CHECK(pthread_create(&thread, NULL, ring_producer, &ring) == 0);
+    while (expected <= RING_ITEMS) {
+        void *item = flv_ring_pop(&ring);
+
+        if (!item) {
+            sched_yield();
+            continue;
+        }
+        CHECK((uintptr_t) item == expected);
+        expected++;
+    }
+    pthread_join(thread, NULL);
+    CHECK(flv_ring_pop(&ring) == NULL);
+    flv_ring_destroy(&ring);
+}
+
+typedef struct tag_record {
+    uint64_t offset;
+    uint64_t hash;
+    uint32_t timestamp;
+    uint32_t data_size;
+    uint8_t tag_type;
+} tag_record_t;
+
+typedef struct tag_list {
+    tag_record_t *tags;
+    size_t count;
+    size_t capacity;
+    uint32_t end_prev_tag_size;
+} tag_list_t;
+
+static int list_tag(void *opaque, const flv_tag_info_t *tag) {
+    tag_list_t *list = (tag_list_t *) opaque;
+    tag_record_t *record = NULL;
+
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 1024;
+        list->tags = realloc(list->tags, list->capacity * sizeof(tag_record_t));
+        CHECK(list->tags != NULL);
+    }
+    record = &list->tags[list->count++];
+    // Compared with memcmp, padding included
+    memset(record, 0, sizeof(*record));
+    record->offset = tag->offset;
+    record->hash = tag->hash;
+    record->timestamp = flv_tag_timestamp(tag);
+    record->data_size = tag->data_size;
+    record->tag_type = tag->tag_type;
+    return 0;
+}
+
+static void list_end(void *opaque, uint32_t prev_tag_size) {
+    ((tag_list_t *) opaque)->end_prev_tag_size = prev_tag_size;
+}
+
+/*
+ * @brief the pipeline must return the same tags as the sequential reader
+ * whatever the block size, including blocks smaller than one tag header,
+ * which force every record through the carry buffer
+ */
+static void test_pipeline_blocks(const char *path) {
+    static const size_t block_sizes[] = {7, 16, 1000, 4096, 0};
+    flv_reader_t reader;
+    flv_tag_info_t tag;
+    tag_list_t expected;
+    test_flv_t flv;
+    FILE *file = fopen(path, "rb");
+    uint8_t buf[65536];
+    size_t count = 0;
+    int ret = 0;
+
+    CHECK(file != NULL);
+    memset(&flv, 0, sizeof(flv));
+    while ((count = fread(buf, 1, sizeof(buf), file)) > 0)
+        test_flv_append(&flv, buf, count);
+    fclose(file);
+
+    memset(&expected, 0, sizeof(expected));
+    flv_reader_init_memory(&reader, flv.data, flv.size);
+    flv_reader_set_hash(&reader, 1);
+    while ((ret = flv_reader_next_tag(&reader, &tag)) == FLV_OK)
+        list_tag(&expected, &tag);
+    CHECK(ret == FLV_EOF && expected.count > 0);
+    expected.end_prev_tag_size = tag.prev_tag_size;
+
+    for (size_t i = 0; i < sizeof(block_sizes) / sizeof(block_sizes[0]); ++i) {
+        flv_pipeline_config_t config = {block_sizes[i], 2, 1, 0};
+        flv_pipeline_handler_t handler;
+        test_source_t source = {flv.data, flv.size, 0};
+        tag_list_t list;
+
+        memset(&list, 0, sizeof(list));
+        memset(&handler, 0, sizeof(handler));
+        handler.tag = list_tag;
+        handler.end = list_end;
+        handler.opaque = &list;
+        CHECK(flv_pipeline_run(test_source_read, &source, &config, &handler) == FLV_OK);
+        CHECK(list.count == expected.count);
+        CHECK(memcmp(list.tags, expected.tags, expected.count * sizeof(tag_record_t)) == 0);
+        CHECK(list.end_prev_tag_size == expected.end_prev_tag_size);
+        free(list.tags);
+    }
+    free(expected.tags);
+    test_flv_free(&flv);
+}
+
+int main(int argc, char **argv) {
+    CHECK(argc == 2);
+    test_ring_bounds();
+    test_ring_threads();
+    test_pipeline_blocks(argv[1]);
+    return 0;
+}
@@ -0,0 +1,90 @@
+#include "test-util.h"
+
+/*
+ * A truncated AVC video tag (shorter than its 5-byte AVCVIDEOPACKET
+ * header) between two good tags: the chunked reader must report it and
+ * stay in step with the stream.
+ */
+static void test_chunked_malformed(void) {
+    static const uint8_t audio[] = {0x2F, 1, 2, 3};
+    static const uint8_t short_video[] = {0x17, 1, 0};
+    static const uint8_t video[] = {0x17, 1, 0, 0, 0, 9, 9, 9, 9};
+    test_source_t source;
+    flv_reader_t reader;
+    flv_tag_info_t tag;
+    test_flv_t flv;
+
+    test_flv_begin(&flv, 5, FLV_HEADER_SIZE);
+    test_flv_tag(&flv, TAGTYPE_AUDIODATA, 0, audio, sizeof(audio));
+    test_flv_tag(&flv, TAGTYPE_VIDEODATA, 10, short_video, sizeof(short_video));
+    test_flv_tag(&flv, TAGTYPE_VIDEODATA, 20, video, sizeof(video));
+
+    memset(&source, 0, sizeof(source));
+    source.data = flv.data;
+    source.size = flv.size;
+    flv_reader_init(&reader, test_source_read, &source);
+    flv_reader_set_max_buffer(&reader, 16);
+    CHECK(flv_reader_read_header(&reader, NULL) == FLV_OK);
+    CHECK(flv_reader_next_tag_chunked(&reader, &tag, NULL, NULL) == FLV_OK);
+    CHECK(tag.tag_type == TAGTYPE_AUDIODATA && tag.sound_format == FLV_SOUND_FORMAT_MP3);
+    CHECK(flv_reader_next_tag_chunked(&reader, &tag, NULL, NULL) == FLV_ERR_MALFORMED);
+    CHECK(flv_reader_next_tag_chunked(&reader, &tag, NULL, NULL) == FLV_OK);
+    CHECK(tag.tag_type == TAGTYPE_VIDEODATA && flv_tag_timestamp(&tag) == 20 && tag.data_size == sizeof(video));
+    CHECK(flv_reader_next_tag_chunked(&reader, &tag, NULL, NULL) == FLV_EOF);
+    CHECK(reader.tag_count == 3);
+    flv_reader_destroy(&reader);
+    test_flv_free(&flv);
+}
+
+/*
+ * DataOffset may point up to 4 GB past the header. The extended header is
+ * skipped in max_buffer chunks rather than buffered whole, so a short file
+ * claiming a huge one ends as truncated without a huge allocation.
+ */
+static void test_huge_data_offset(void) {
+    static const uint8_t audio[] = {0x2F, 1, 2, 3};
+    test_source_t source;
+    flv_reader_t reader;
+    flv_tag_info_t tag;
+    test_flv_t flv;
+
+    test_flv_begin(&flv, 4, FLV_HEADER_SIZE);
+    while (flv.size < 109)
+        test_flv_append(&flv, "", 1);
+    flv_put_ui32(flv.data + 5, 0xF0000000);
+
+    memset(&source, 0, sizeof(source));
+    source.data = flv.data;
+    source.size = flv.size;
+    flv_reader_init(&reader, test_source_read, &source);
+    flv_reader_set_max_buffer(&reader, 4096);
+    CHECK(flv_reader_read_header(&reader, NULL) == FLV_ERR_TRUNCATED);
+    CHECK(reader.buf_size <= 4096);
+    flv_reader_destroy(&reader);
+
+    flv_reader_init_memory(&reader, flv.data, flv.size);
+    CHECK(flv_reader_read_header(&reader, NULL) == FLV_ERR_TRUNCATED);
+    flv_reader_destroy(&reader);
+    test_flv_free(&flv);
+
+    // A modest extended header is skipped and the first tag found behind it
+    test_flv_begin(&flv, 4, 9000);
+    test_flv_tag(&flv, TAGTYPE_AUDIODATA, 0, audio, sizeof(audio));
+    memset(&source, 0, sizeof(source));
+    source.data = flv.data;
+    source.size = flv.size;
+    flv_reader_init(&reader, test_source_read, &source);
+    flv_reader_set_max_buffer(&reader, 4096);
+    CHECK(flv_reader_next_tag_chunked(&reader, &tag, NULL, NULL) == FLV_OK);
+    CHECK(tag.tag_type == TAGTYPE_AUDIODATA && tag.offset == 9000 + FLV_PREV_TAG_SIZE_SIZE);
+    CHECK(reader.buf_size <= 4096);
+    CHECK(flv_reader_next_tag_chunked(&reader, &tag, NULL, NULL) == FLV_EOF);
+    flv_reader_destroy(&reader);
+    test_flv_free(&flv);
+}
+
+int main(void) {
+    test_chunked_malformed();
+    test_huge_data_offset();
+    return 0;
+}
@@ -0,0 +1,298 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "flv-relay.h"
+#include "test-util.h"
+
+#define FRAMES       (240)
+#define GOP_FRAMES   (24)
+#define FRAME_SIZE   (32 * 1024)
+// The slow client starts reading again at this frame
+#define SLOW_RESUME  (120)
+
+typedef struct test_client {
+    int fd;
+    int closed;
+    test_flv_t received;       // HTTP response and stream, as read
+} test_client_t;
+
+/*
+ * @brief connect to the relay and send the request. A small receive
+ * buffer keeps the kernel from absorbing what the relay has to queue.
+ */
+static void client_connect(test_client_t *client, int port, int rcvbuf) {
+    static const char request[] = "GET /live.flv HTTP/1.0\r\n\r\n";
+    struct sockaddr_in addr;
+
+    memset(client, 0, sizeof(*client));
+    client->fd = socket(AF_INET, SOCK_STREAM, 0);
+    CHECK(client->fd >= 0);
+    if (rcvbuf)
+        CHECK(setsockopt(client->fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf)) == 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t) port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    CHECK(connect(client->fd, (struct sockaddr *) &addr, sizeof(addr)) == 0);
+    CHECK(write(client->fd, request, sizeof(request) - 1) == (ssize_t) sizeof(request) - 1);
+    CHECK(fcntl(client->fd, F_SETFL, fcntl(client->fd, F_GETFL, 0) | O_NONBLOCK) == 0);
+}
+
+static void client_read(test_client_t *client) {
+    uint8_t scratch[64 * 1024];
+
+    while (!client->closed) {
+        ssize_t count = read(client->fd, scratch, sizeof(scratch));
+
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return;
+        if (count <= 0)
+            client->closed = 1;
+        else
+            test_flv_append(&client->received, scratch, (size_t) count);
+    }
+}
+
+static void client_close(test_client_t *client) {
+    close(client->fd);
+    test_flv_free(&client->received);
+}
+
+/*
+ * @brief the video frame numbers in a client's stream, checking that it is
+ * a well-formed FLV after the HTTP response. Returns the frame count.
+ */
+static size_t client_frames(const test_client_t *client, uint32_t *frames, uint8_t *frame_types) {
+    static const char end_of_response[] = "\r\n\r\n";
+    const uint8_t *data = client->received.data;
+    size_t size = client->received.size;
+    flv_reader_t reader;
+    flv_tag_info_t tag;
+    size_t count = 0;
+    size_t body = 0;
+    int ret = 0;
+
+    for (; body + 4 <= size && memcmp(data + body, end_of_response, 4) != 0; ++body)
+        ;
+    CHECK(body + 4 <= size && memcmp(data, "HTTP/1.1 200 OK", 15) == 0);
+    body += 4;
+
+    flv_reader_init_memory(&reader, data + body, size - body);
+    CHECK(flv_reader_read_header(&reader, NULL) == FLV_OK);
+    while ((ret = flv_reader_next_tag(&reader, &tag)) == FLV_OK) {
+        if (tag.tag_type != TAGTYPE_VIDEODATA || tag.avc_packet_type != FLV_AVC_NALU)
+            continue;
+        CHECK(count < FRAMES);
+        frames[count] = flv_tag_timestamp(&tag) / 40;
+        frame_types[count] = tag.frame_type;
+        count++;
+    }
+    CHECK(ret == FLV_EOF);
+    flv_reader_destroy(&reader);
+    return count;
+}
+
+static void publish_video(flv_relay_t *relay, uint8_t *body, uint32_t size, uint32_t timestamp,
+                          int key, int packet_type) {
+    flv_tag_info_t tag;
+
+    memset(&tag, 0, sizeof(tag));
+    body[0] = key ? 0x17 : 0x27;
+    body[1] = (uint8_t) packet_type;
+    body[2] = body[3] = body[4] = 0;
+    tag.tag_type = TAGTYPE_VIDEODATA;
+    tag.data_size = size;
+    tag.timestamp = timestamp;
+    CHECK(flv_decode_tag_body(&tag, body, size) == FLV_OK);
+    CHECK(flv_relay_publish(relay, &tag) == FLV_OK);
+}
+
+static flv_relay_t *relay_start(const flv_relay_config_t *config, test_client_t *clients,
+                                size_t count, int slow_index) {
+    flv_relay_t *relay = flv_relay_create(config);
+    int port = 0;
+
+    CHECK(relay != NULL);
+    CHECK(flv_relay_listen(relay, "127.0.0.1", 0) == FLV_OK);
+    port = flv_relay_port(relay);
+    CHECK(port > 0);
+    for (size_t i = 0; i < count; ++i)
+        client_connect(&clients[i], port, (int) i == slow_index ? 4096 : 0);
+    // Accept everyone and read the requests before the stream starts
+    for (int i = 0; i < 100 && flv_relay_poll(relay, 10) < (int) count; ++i)
+        ;
+    for (int i = 0; i < 5; ++i)
+        flv_relay_poll(relay, 10);
+    CHECK(flv_relay_poll(relay, 0) == (int) count);
+    return relay;
+}
+
+/*
+ * Three clients keep up and must see every frame; a fourth stops reading
+ * for half the stream, so its queue fills and it loses frames, and must
+ * resume at a keyframe.
+ */
+static void test_fan_out(void) {
+    flv_relay_config_t config = {256 * 1024, 64 << 20, 0, 0};
+    flv_header_t header = {{'F', 'L', 'V'}, 1, 1 << FLV_HEADER_VIDEO_BIT, FLV_HEADER_SIZE};
+    uint8_t config_body[] = {0x17, 0, 0, 0, 0, 1, 0x64, 0, 0x1F, 0xFF};
+    test_client_t clients[4];
+    static uint32_t frames[4][FRAMES];
+    static uint8_t frame_types[4][FRAMES];
+    size_t counts[4];
+    const int slow = 3;
+    uint8_t *body = malloc(FRAME_SIZE);
+    flv_relay_stats_t stats;
+    flv_relay_t *relay = NULL;
+
+    CHECK(body != NULL);
+    memset(body, 0xAB, FRAME_SIZE);
+    relay = relay_start(&config, clients, 4, slow);
+    CHECK(flv_relay_set_header(relay, &header) == FLV_OK);
+    publish_video(relay, config_body, sizeof(config_body), 0, 1, FLV_AVC_SEQUENCE_HEADER);
+    for (uint32_t frame = 0; frame < FRAMES; ++frame) {
+        publish_video(relay, body, FRAME_SIZE, frame * 40, frame % GOP_FRAMES == 0, FLV_AVC_NALU);
+        flv_relay_poll(relay, 0);
+        for (int i = 0; i < 4; ++i) {
+            if (i != slow || frame >= SLOW_RESUME)
+                client_read(&clients[i]);
+        }
+    }
+    for (int i = 0; i < 1000 && flv_relay_pending(relay) > 0; ++i) {
+        flv_relay_poll(relay, 10);
+        for (int k = 0; k < 4; ++k)
+            client_read(&clients[k]);
+    }
+    CHECK(flv_relay_pending(relay) == 0);
+    for (int k = 0; k < 4; ++k)
+        client_read(&clients[k]);
+
+    flv_relay_get_stats(relay, &stats);
+    CHECK(stats.subscribers == 4 && stats.disconnects == 0);
+    CHECK(stats.tags_published == FRAMES + 1);
+    CHECK(stats.tags_dropped > 0);
+
+    for (int i = 0; i < 4; ++i)
+        counts[i] = client_frames(&clients[i], frames[i], frame_types[i]);
+    // One copy fanned out: the clients that kept up got identical streams
+    for (int i = 1; i < slow; ++i) {
+        CHECK(clients[i].received.size == clients[0].received.size);
+        CHECK(memcmp(clients[i].received.data, clients[0].received.data, clients[0].received.size) == 0);
+    }
+    CHECK(counts[0] == FRAMES);
+    for (size_t k = 0; k < FRAMES; ++k)
+        CHECK(frames[0][k] == k);
+
+    CHECK(counts[slow] < FRAMES && counts[slow] > 0);
+    CHECK(frames[slow][counts[slow] - 1] == FRAMES - 1);
+    for (size_t k = 0; k < counts[slow]; ++k) {
+        int gap = k == 0 ? frames[slow][k] != 0 : frames[slow][k] != frames[slow][k - 1] + 1;
+
+        CHECK(k == 0 || frames[slow][k] > frames[slow][k - 1]);
+        if (gap)
+            CHECK(frame_types[slow][k] == FLV_FRAME_TYPE_KEY);
+    }
+
+    flv_relay_destroy(relay);
+    for (int i = 0; i < 4; ++i)
+        client_close(&clients[i]);
+    free(body);
+}
+
+/*
+ * Script tags are never dropped, so a client that stops reading while they
+ * keep coming must be disconnected once its backlog passes the limit.
+ */
+static void test_backlog_disconnect(void) {
+    flv_relay_config_t config = {64 * 1024, 256 * 1024, 0, 0};
+    flv_header_t header = {{'F', 'L', 'V'}, 1, 1 << FLV_HEADER_VIDEO_BIT, FLV_HEADER_SIZE};
+    test_client_t client;
+    uint8_t *body = calloc(1, FRAME_SIZE);
+    flv_relay_stats_t stats;
+    flv_relay_t *relay = NULL;
+    flv_tag_info_t tag;
+
+    CHECK(body != NULL);
+    relay = relay_start(&config, &client, 1, 0);
+    CHECK(flv_relay_set_header(relay, &header) == FLV_OK);
+    memset(&stats, 0, sizeof(stats));
+    for (uint32_t i = 0; i < 1000 && stats.disconnects == 0; ++i) {
+        memset(&tag, 0, sizeof(tag));
+        tag.tag_type = TAGTYPE_SCRIPTDATAOBJECT;
+        tag.data_size = FRAME_SIZE;
+        tag.timestamp = i;
+        CHECK(flv_decode_tag_body(&tag, body, FRAME_SIZE) == FLV_OK);
+        CHECK(flv_relay_publish(relay, &tag) == FLV_OK);
+        flv_relay_poll(relay, 0);
+        flv_relay_get_stats(relay, &stats);
+    }
+    CHECK(stats.disconnects == 1);
+    CHECK(stats.subscribers == 0 && flv_relay_pending(relay) == 0);
+
+    // The client sees the connection end once it reads what was sent
+    for (int i = 0; i < 1000 && !client.closed; ++i) {
+        client_read(&client);
+        if (!client.closed)
+            usleep(1000);
+    }
+    CHECK(client.closed);
+
+    flv_relay_destroy(relay);
+    client_close(&client);
+    free(body);
+}
+
+/*
+ * A client that stops reading plain video never reaches the backlog limit,
+ * since everything but the config is dropped while it waits for room at a
+ * keyframe. It must be disconnected once it has missed keyframes for
+ * max_stall_ms of stream time, and not before.
+ */
+static void test_stall_disconnect(void) {
+    flv_relay_config_t config = {64 * 1024, 256 * 1024, 0, 2000};
+    flv_header_t header = {{'F', 'L', 'V'}, 1, 1 << FLV_HEADER_VIDEO_BIT, FLV_HEADER_SIZE};
+    uint8_t config_body[] = {0x17, 0, 0, 0, 0, 1, 0x64, 0, 0x1F, 0xFF};
+    test_client_t client;
+    uint8_t *body = calloc(1, FRAME_SIZE);
+    flv_relay_stats_t stats;
+    flv_relay_t *relay = NULL;
+    uint32_t first_missed = 0;
+    uint32_t frame = 0;
+
+    CHECK(body != NULL);
+    relay = relay_start(&config, &client, 1, 0);
+    CHECK(flv_relay_set_header(relay, &header) == FLV_OK);
+    publish_video(relay, config_body, sizeof(config_body), 0, 1, FLV_AVC_SEQUENCE_HEADER);
+    memset(&stats, 0, sizeof(stats));
+    for (; frame < 100 * GOP_FRAMES && stats.disconnects == 0; ++frame) {
+        int key = frame % GOP_FRAMES == 0;
+        uint64_t dropped = stats.tags_dropped;
+
+        publish_video(relay, body, FRAME_SIZE, frame * 40, key, FLV_AVC_NALU);
+        flv_relay_poll(relay, 0);
+        flv_relay_get_stats(relay, &stats);
+        if (key && stats.tags_dropped > dropped && !first_missed)
+            first_missed = frame;
+    }
+    CHECK(stats.disconnects == 1 && stats.subscribers == 0);
+    CHECK(first_missed > 0);
+    // Cut off at the first keyframe at least max_stall_ms after the first miss
+    CHECK((frame - 1 - first_missed) * 40 >= config.max_stall_ms);
+    CHECK((frame - 1 - first_missed) * 40 < config.max_stall_ms + GOP_FRAMES * 40);
+
+    flv_relay_destroy(relay);
+    client_close(&client);
+    free(body);
+}
+
+int main(void) {
+    test_fan_out();
+    test_backlog_disconnect();
+    test_stall_disconnect();
+    return 0;
+}
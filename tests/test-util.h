@@ -0,0 +1,101 @@
+#ifndef FLV_TEST_UTIL_H_
+#define FLV_TEST_UTIL_H_
+
+/*
+ * Helpers shared by the unit tests: a failing check exits the test, and
+ * small FLV streams are assembled in memory tag by tag.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "flv-core.h"
+
+#define CHECK(cond)                                                                   \
+    do {                                                                              \
+        if (!(cond)) {                                                                \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(1);                                                                  \
+        }                                                                             \
+    } while (0)
+
+typedef struct test_flv {
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+} test_flv_t;
+
+static inline void test_flv_append(test_flv_t *flv, const void *p, size_t len) {
+    if (flv->size + len > flv->capacity) {
+        flv->capacity = (flv->size + len) * 2;
+        flv->data = realloc(flv->data, flv->capacity);
+        CHECK(flv->data != NULL);
+    }
+    if (len)
+        memcpy(flv->data + flv->size, p, len);
+    flv->size += len;
+}
+
+/*
+ * @brief start a stream: the file header, `data_offset` - 9 padding bytes
+ * and PreviousTagSize0
+ */
+static inline void test_flv_begin(test_flv_t *flv, uint8_t type_flags, uint32_t data_offset) {
+    uint8_t header[FLV_HEADER_SIZE] = {'F', 'L', 'V', 1, type_flags};
+    uint8_t zero[FLV_PREV_TAG_SIZE_SIZE] = {0};
+
+    memset(flv, 0, sizeof(*flv));
+    flv_put_ui32(header + 5, data_offset);
+    test_flv_append(flv, header, sizeof(header));
+    for (uint32_t i = FLV_HEADER_SIZE; i < data_offset; ++i)
+        test_flv_append(flv, zero, 1);
+    test_flv_append(flv, zero, sizeof(zero));
+}
+
+/*
+ * @brief append one tag and its PreviousTagSize
+ */
+static inline void test_flv_tag(test_flv_t *flv, uint8_t tag_type, uint32_t timestamp,
+                                const void *body, uint32_t size) {
+    flv_tag_info_t tag;
+    uint8_t header[FLV_TAG_HEADER_SIZE];
+    uint8_t prev[FLV_PREV_TAG_SIZE_SIZE];
+
+    memset(&tag, 0, sizeof(tag));
+    tag.tag_type = tag_type;
+    tag.data_size = size;
+    tag.timestamp = timestamp & 0xFFFFFF;
+    tag.timestamp_ext = (uint8_t) (timestamp >> 24);
+    flv_encode_tag_header(header, &tag);
+    test_flv_append(flv, header, sizeof(header));
+    test_flv_append(flv, body, size);
+    flv_put_ui32(prev, FLV_TAG_HEADER_SIZE + size);
+    test_flv_append(flv, prev, sizeof(prev));
+}
+
+static inline void test_flv_free(test_flv_t *flv) {
+    free(flv->data);
+    memset(flv, 0, sizeof(*flv));
+}
+
+/*
+ * @brief flv_read_fn over a memory buffer, to exercise the buffered reader
+ * paths rather than the zero-copy memory source
+ */
+typedef struct test_source {
+    const uint8_t *data;
+    size_t size;
+    size_t pos;
+} test_source_t;
+
+static inline long test_source_read(void *opaque, void *buf, size_t size) {
+    test_source_t *source = (test_source_t *) opaque;
+    size_t count = source->size - source->pos < size ? source->size - source->pos : size;
+
+    memcpy(buf, source->data + source->pos, count);
+    source->pos += count;
+    return (long) count;
+}
+
+#endif // FLV_TEST_UTIL_H_
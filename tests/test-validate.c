@@ -0,0 +1,167 @@
+#include <unistd.h>
+#include "flv-validate.h"
+#include "test-util.h"
+
+#define MAX_ISSUES (32)
+
+typedef struct issue_list {
+    flv_issue_t issues[MAX_ISSUES];
+    size_t count;
+} issue_list_t;
+
+static int collect(void *opaque, const flv_issue_t *issue) {
+    issue_list_t *list = (issue_list_t *) opaque;
+
+    CHECK(list->count < MAX_ISSUES);
+    list->issues[list->count++] = *issue;
+    return 0;
+}
+
+static void check_issue(const issue_list_t *list, size_t i, int code, uint64_t offset, uint32_t tag_index) {
+    CHECK(i < list->count);
+    if (list->issues[i].code != code || list->issues[i].offset != offset ||
+        list->issues[i].tag_index != tag_index) {
+        fprintf(stderr, "issue %zu: got %s at %llu (tag %u), expected %s at %llu (tag %u)\n", i,
+                flv_issue_name(list->issues[i].code), (unsigned long long) list->issues[i].offset,
+                list->issues[i].tag_index, flv_issue_name(code), (unsigned long long) offset, tag_index);
+        exit(1);
+    }
+}
+
+static void check_same(const issue_list_t *a, const issue_list_t *b) {
+    CHECK(a->count == b->count);
+    for (size_t i = 0; i < a->count; ++i) {
+        CHECK(a->issues[i].code == b->issues[i].code && a->issues[i].offset == b->issues[i].offset);
+        CHECK(a->issues[i].tag_index == b->issues[i].tag_index);
+        CHECK(a->issues[i].expected == b->issues[i].expected && a->issues[i].actual == b->issues[i].actual);
+    }
+}
+
+/*
+ * @brief validate `data` both in memory and from a file, which must agree
+ */
+static void validate_both(const uint8_t *data, size_t size, issue_list_t *list, flv_validate_stats_t *stats) {
+    char path[] = "/tmp/test-validate-XXXXXX";
+    issue_list_t file_list;
+    flv_validate_stats_t file_stats;
+    int fd = mkstemp(path);
+
+    CHECK(fd >= 0);
+    CHECK(write(fd, data, size) == (ssize_t) size);
+    close(fd);
+
+    memset(list, 0, sizeof(*list));
+    memset(&file_list, 0, sizeof(file_list));
+    CHECK(flv_validate_memory(data, size, collect, list, stats) == FLV_OK);
+    CHECK(flv_validate_file(path, collect, &file_list, &file_stats) == FLV_OK);
+    unlink(path);
+
+    check_same(&file_list, list);
+    CHECK(memcmp(&file_stats, stats, sizeof(*stats)) == 0);
+}
+
+/*
+ * A clean stream with a body much larger than the read window.
+ */
+static void test_clean(void) {
+    static const uint8_t audio[] = {0x2F, 1, 2, 3};
+    size_t big_size = 5 * FLV_VALIDATE_WINDOW;
+    uint8_t *big = calloc(1, big_size);
+    flv_validate_stats_t stats;
+    issue_list_t list;
+    test_flv_t flv;
+
+    CHECK(big != NULL);
+    big[0] = 0x17;
+    big[1] = 1;
+    test_flv_begin(&flv, 5, FLV_HEADER_SIZE);
+    test_flv_tag(&flv, TAGTYPE_AUDIODATA, 0, audio, sizeof(audio));
+    test_flv_tag(&flv, TAGTYPE_VIDEODATA, 0, big, (uint32_t) big_size);
+    test_flv_tag(&flv, TAGTYPE_AUDIODATA, 23, audio, sizeof(audio));
+    validate_both(flv.data, flv.size, &list, &stats);
+    CHECK(list.count == 0 && stats.issues == 0);
+    CHECK(stats.tags == 3 && stats.audio_tags == 2 && stats.video_tags == 1);
+    CHECK(stats.bytes == flv.size);
+    test_flv_free(&flv);
+    free(big);
+}
+
+/*
+ * Each kind of damage is reported at the offending field and the walk
+ * goes on to the end.
+ */
+static void test_issues(void) {
+    static const uint8_t audio[] = {0x2F, 1, 2, 3};
+    static const uint8_t video[] = {0x17, 1, 0, 0, 0, 9};
+    flv_validate_stats_t stats;
+    issue_list_t list;
+    test_flv_t flv;
+    size_t tag2 = 0;
+    size_t tag3 = 0;
+    size_t tag4 = 0;
+    size_t tag5 = 0;
+
+    // Only the audio flag set, though there is video
+    test_flv_begin(&flv, 4, FLV_HEADER_SIZE);
+    test_flv_tag(&flv, TAGTYPE_AUDIODATA, 100, audio, sizeof(audio));
+    tag2 = flv.size;
+    test_flv_tag(&flv, TAGTYPE_VIDEODATA, 100, video, sizeof(video));
+    tag3 = flv.size;
+    test_flv_tag(&flv, TAGTYPE_AUDIODATA, 50, audio, sizeof(audio));
+    tag4 = flv.size;
+    test_flv_tag(&flv, TAGTYPE_AUDIODATA, 150, audio, sizeof(audio));
+    tag5 = flv.size;
+    test_flv_tag(&flv, TAGTYPE_VIDEODATA, 200, video, sizeof(video));
+
+    flv_put_ui32(flv.data + tag3 - FLV_PREV_TAG_SIZE_SIZE, 99);
+    flv.data[tag4 + 10] = 1;   // StreamID
+    flv.size -= FLV_PREV_TAG_SIZE_SIZE + 2;
+
+    validate_both(flv.data, flv.size, &list, &stats);
+    CHECK(list.count == 5 && stats.issues == 5 && stats.tags == 5);
+    check_issue(&list, 0, FLV_ISSUE_PREV_TAG_SIZE, tag3 - FLV_PREV_TAG_SIZE_SIZE, 2);
+    check_issue(&list, 1, FLV_ISSUE_TIMESTAMP, tag3 + 4, 3);
+    check_issue(&list, 2, FLV_ISSUE_STREAM_ID, tag4 + 8, 4);
+    check_issue(&list, 3, FLV_ISSUE_TRUNCATED, tag5 + FLV_TAG_HEADER_SIZE, 5);
+    check_issue(&list, 4, FLV_ISSUE_VIDEO_FLAG, tag2, 2);
+    CHECK(list.issues[3].expected == sizeof(video) && list.issues[3].actual == sizeof(video) - 2);
+    test_flv_free(&flv);
+}
+
+/*
+ * Reading a real file a window at a time must find what the in-memory
+ * walk finds.
+ */
+static void test_sample(const char *path) {
+    issue_list_t list;
+    issue_list_t file_list;
+    flv_validate_stats_t stats;
+    flv_validate_stats_t file_stats;
+    test_flv_t flv;
+    uint8_t chunk[4096];
+    size_t count = 0;
+    FILE *file = fopen(path, "rb");
+
+    CHECK(file != NULL);
+    memset(&flv, 0, sizeof(flv));
+    while ((count = fread(chunk, 1, sizeof(chunk), file)) > 0)
+        test_flv_append(&flv, chunk, count);
+    fclose(file);
+
+    memset(&list, 0, sizeof(list));
+    memset(&file_list, 0, sizeof(file_list));
+    CHECK(flv_validate_memory(flv.data, flv.size, collect, &list, &stats) == FLV_OK);
+    CHECK(flv_validate_file(path, collect, &file_list, &file_stats) == FLV_OK);
+    CHECK(stats.tags > 0 && stats.bytes == flv.size);
+    check_same(&file_list, &list);
+    CHECK(memcmp(&file_stats, &stats, sizeof(stats)) == 0);
+    test_flv_free(&flv);
+}
+
+int main(int argc, char **argv) {
+    test_clean();
+    test_issues();
+    for (int i = 1; i < argc; ++i)
+        test_sample(argv[i]);
+    return 0;
+}